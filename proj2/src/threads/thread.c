@@ -37,8 +37,6 @@ static struct thread *initial_thread;
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
-static struct lock filesys_lock;
-
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
   {
@@ -94,8 +92,6 @@ void thread_init (void)
   list_init (&ready_list);
   list_init (&all_list);
 
-  lock_init(&filesys_lock);
-
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
   init_thread (initial_thread, "main", PRI_DEFAULT);
@@ -582,16 +578,6 @@ schedule (void)
   thread_schedule_tail (prev);
 }
 
-void acquire_filesys_lock()
-{
-  lock_acquire(&filesys_lock);
-}
-
-void release_filesys_lock()
-{
-  lock_release(&filesys_lock);
-}
-
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void) 
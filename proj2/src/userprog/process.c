@@ -249,7 +249,6 @@ bool load (const char *file_name, void (**eip) (void), void **esp)
   bool success = false;
   int i;
 
-  acquire_filesys_lock();
   /* Allocate and activate page directory. */
   t->pagedir = pagedir_create ();
   if (t->pagedir == NULL)
@@ -360,7 +359,6 @@ bool load (const char *file_name, void (**eip) (void), void **esp)
   
  done:
     t->self = file;
-    release_filesys_lock();
     return success;
 }
 
@@ -75,10 +75,7 @@ static void syscall_handler (struct intr_frame *f UNUSED)
             confirm_user_address(*(p+1));
             struct thread* curr = thread_current();
 
-            // TODO: we need lock here
-            acquire_filesys_lock();
             struct file* fptr = filesys_open (*(p+1));
-            release_filesys_lock();
             if(fptr==NULL) f->eax = -1;
             else {
                 struct file_info *pfile = (struct file_info*)malloc(sizeof(*pfile));
@@ -194,8 +191,6 @@ void* confirm_user_address(const void *user_address)
 int exec_proc(char *f_name)
 {
     int eax;
-    // we need lock here
-    acquire_filesys_lock();
     char * fn_cp = malloc (strlen(f_name)+1);
     char * save_ptr;
     strlcpy(fn_cp, f_name, strlen(f_name)+1);
@@ -206,13 +201,11 @@ int exec_proc(char *f_name)
     // if program cannot load the file
     if(!currFile)
     {
-        release_filesys_lock();
         eax =  -1;
     }
     else
     {
         file_close(currFile);
-        release_filesys_lock();
         eax = process_execute(f_name);
     }
     return eax;
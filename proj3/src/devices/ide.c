@@ -9,9 +9,23 @@
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef USERPROG
+#include "userprog/pagedir.h"
+#endif
 
 /* The code in this file is an interface to an ATA (IDE)
-   controller.  It attempts to comply to [ATA-3]. */
+   controller.  It attempts to comply to [ATA-3].
+
+   If the PCI bus has an IDE controller in legacy mode that can
+   act as a bus master, such as the PIIX that QEMU emulates, and
+   a disk supports DMA, sectors move between the disk and memory
+   by DMA: the controller follows a table of physical regions,
+   called a PRD table, while the thread that asked for the
+   transfer sleeps until the completion interrupt, leaving the
+   CPU to other threads.  Otherwise, and for IDENTIFY DEVICE,
+   the CPU moves each sector itself with programmed I/O (PIO). */
 
 /* ATA command block port addresses. */
 #define reg_data(CHANNEL) ((CHANNEL)->reg_base + 0)     /* Data. */
@@ -33,7 +47,9 @@
 /* Alternate Status Register bits. */
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
+#define STA_DF 0x20             /* Device Fault. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -49,6 +65,38 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* Bus master port addresses, relative to the channel's bus
+   master base. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)  /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)    /* PRD table. */
+
+/* Bus master Command Register bits. */
+#define BM_CMD_START 0x01       /* Start transfer. */
+#define BM_CMD_READ 0x08        /* Transfer from disk to memory. */
+
+/* Bus master Status Register bits. */
+#define BM_STA_ERR 0x02         /* Error (write 1 to clear). */
+#define BM_STA_INTR 0x04        /* Interrupt (write 1 to clear). */
+
+/* A physical region descriptor: one physically contiguous piece
+   of a DMA buffer, which may not cross a 64 kB boundary. */
+struct prd
+  {
+    uint32_t addr;              /* Physical address. */
+    uint16_t size;              /* Size in bytes. */
+    uint16_t flags;             /* PRD_EOT in the last entry. */
+  };
+
+/* Marks the last entry in a PRD table. */
+#define PRD_EOT 0x8000
+
+/* Number of PRD table entries per channel.  A sector-sized
+   buffer that does not fit in one page spans two. */
+#define PRD_CNT 2
 
 /* An ATA device. */
 struct ata_disk
@@ -57,6 +105,7 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+    bool dma;                   /* Transfer sectors by DMA? */
   };
 
 /* An ATA channel (aka controller).
@@ -72,6 +121,9 @@ struct channel
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
+    uint16_t bm_base;           /* Bus master base I/O port, or 0. */
+    struct prd *prdt;           /* PRD table, if bm_base is nonzero. */
+
     struct ata_disk devices[2];     /* The devices on this channel. */
   };
 
@@ -79,8 +131,13 @@ struct channel
 #define CHANNEL_CNT 2
 static struct channel channels[CHANNEL_CNT];
 
+/* PRD tables, one per channel.  The alignment keeps each table
+   from crossing a 64 kB boundary. */
+static struct prd prdts[CHANNEL_CNT][PRD_CNT] __attribute__ ((aligned (16)));
+
 static struct block_operations ide_operations;
 
+static uint16_t find_bus_master (void);
 static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
@@ -89,6 +146,9 @@ static void select_sector (struct ata_disk *, block_sector_t);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
+static void mark_user_written (const void *);
+static bool dma_transfer (struct ata_disk *, block_sector_t, void *,
+                          bool write);
 
 static void wait_until_idle (const struct ata_disk *);
 static bool wait_while_busy (const struct ata_disk *);
@@ -101,8 +161,11 @@ static void interrupt_handler (struct intr_frame *);
 void
 ide_init (void) 
 {
+  uint16_t bm_base = find_bus_master ();
   size_t chan_no;
 
+  if (bm_base != 0)
+    printf ("ide: bus master at port 0x%"PRIx16", using DMA\n", bm_base);
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
     {
       struct channel *c = &channels[chan_no];
@@ -126,6 +189,8 @@ ide_init (void)
       lock_init (&c->lock);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
+      c->bm_base = bm_base != 0 ? bm_base + chan_no * 8 : 0;
+      c->prdt = prdts[chan_no];
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -136,6 +201,7 @@ ide_init (void)
           d->channel = c;
           d->dev_no = dev_no;
           d->is_ata = false;
+          d->dma = false;
         }
 
       /* Register interrupt handler. */
@@ -159,6 +225,81 @@ ide_init (void)
 
 static char *descramble_ata_string (char *, int size);
 
+/* PCI configuration space ports. */
+#define PCI_CONFIG_ADDR 0xcf8
+#define PCI_CONFIG_DATA 0xcfc
+
+/* PCI configuration registers. */
+#define PCI_REG_ID 0x00                 /* Device and vendor ID. */
+#define PCI_REG_COMMAND 0x04            /* Command. */
+#define PCI_REG_CLASS 0x08              /* Class code and revision. */
+#define PCI_REG_HEADER 0x0c             /* Header type, among others. */
+#define PCI_REG_BAR4 0x20               /* Base address register 4. */
+
+/* PCI Command Register bits. */
+#define PCI_CMD_IO 0x0001               /* Respond to I/O ports. */
+#define PCI_CMD_MASTER 0x0004           /* May act as bus master. */
+
+/* Returns PCI configuration register REG of function FUNC of
+   device DEV on bus 0. */
+static uint32_t
+pci_read (int dev, int func, int reg)
+{
+  outl (PCI_CONFIG_ADDR, 0x80000000 | (dev << 11) | (func << 8) | reg);
+  return inl (PCI_CONFIG_DATA);
+}
+
+/* Writes VALUE to PCI configuration register REG of function
+   FUNC of device DEV on bus 0. */
+static void
+pci_write (int dev, int func, int reg, uint32_t value)
+{
+  outl (PCI_CONFIG_ADDR, 0x80000000 | (dev << 11) | (func << 8) | reg);
+  outl (PCI_CONFIG_DATA, value);
+}
+
+/* Searches PCI bus 0 for an IDE controller whose channels are at
+   the legacy ports and that can act as a bus master.  If one is
+   found, lets it master the bus and returns its bus master base
+   port.  Otherwise, returns 0. */
+static uint16_t
+find_bus_master (void)
+{
+  int dev, func;
+
+  for (dev = 0; dev < 32; dev++)
+    for (func = 0; func < 8; func++)
+      {
+        uint32_t class, bar;
+
+        if ((pci_read (dev, func, PCI_REG_ID) & 0xffff) == 0xffff)
+          {
+            if (func == 0)
+              break;
+            continue;
+          }
+
+        /* Mass storage, IDE, with bus mastering and both channels
+           in compatibility mode. */
+        class = pci_read (dev, func, PCI_REG_CLASS);
+        bar = pci_read (dev, func, PCI_REG_BAR4);
+        if ((class >> 16) == 0x0101 && (class & 0x8500) == 0x8000
+            && (bar & 1) && (bar & 0xfffc) != 0)
+          {
+            uint32_t cmd = pci_read (dev, func, PCI_REG_COMMAND);
+            pci_write (dev, func, PCI_REG_COMMAND,
+                       cmd | PCI_CMD_IO | PCI_CMD_MASTER);
+            return bar & 0xfffc;
+          }
+
+        /* Only multi-function devices have functions past 0. */
+        if (func == 0
+            && !(pci_read (dev, func, PCI_REG_HEADER) & 0x00800000))
+          break;
+      }
+  return 0;
+}
+
 /* Resets an ATA channel and waits for any devices present on it
    to finish the reset. */
 static void
@@ -303,6 +444,9 @@ identify_ata_device (struct ata_disk *d)
       return;
     }
 
+  /* Use DMA if the controller and the disk both support it. */
+  d->dma = c->bm_base != 0 && (*(uint16_t *) &id[49 * 2] & 0x0100) != 0;
+
   /* Register. */
   block = block_register (d->name, BLOCK_RAW, extra_info, capacity,
                           &ide_operations, d);
@@ -347,12 +491,15 @@ ide_read (void *d_, block_sector_t sec_no, void *buffer)
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
+  if (!dma_transfer (d, sec_no, buffer, false))
+    {
+      select_sector (d, sec_no);
+      issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+      sema_down (&c->completion_wait);
+      if (!wait_while_busy (d))
+        PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
+      input_sector (c, buffer);
+    }
   lock_release (&c->lock);
 }
 
@@ -367,12 +514,15 @@ ide_write (void *d_, block_sector_t sec_no, const void *buffer)
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
+  if (!dma_transfer (d, sec_no, (void *) buffer, true))
+    {
+      select_sector (d, sec_no);
+      issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+      if (!wait_while_busy (d))
+        PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
+      output_sector (c, buffer);
+      sema_down (&c->completion_wait);
+    }
   lock_release (&c->lock);
 }
 
@@ -430,6 +580,123 @@ output_sector (struct channel *c, const void *sector)
   outsw (reg_data (c), sector, BLOCK_SECTOR_SIZE / 2);
 }
 
+/* Returns the physical address of BUFFER, which may be a kernel
+   address or, while a user process runs, a user address whose
+   page is present and cannot be evicted.  Returns 0 if BUFFER is
+   a user address that is not mapped. */
+static uintptr_t
+buffer_to_phys (const void *buffer)
+{
+  const uint8_t *kaddr = buffer;
+
+  if (!is_kernel_vaddr (buffer))
+    {
+#ifdef USERPROG
+      uint32_t *pd = thread_current ()->pagedir;
+      uint8_t *kpage = pd != NULL ? pagedir_get_page (pd, buffer) : NULL;
+      if (kpage == NULL)
+        return 0;
+      kaddr = kpage + pg_ofs (buffer);
+#else
+      return 0;
+#endif
+    }
+  return vtop (kaddr);
+}
+
+/* Fills in C's PRD table to describe the BLOCK_SECTOR_SIZE
+   bytes at BUFFER, one entry per page that they touch.  Returns
+   false if part of BUFFER has no physical address. */
+static bool
+build_prdt (struct channel *c, const void *buffer)
+{
+  const uint8_t *p = buffer;
+  size_t left = BLOCK_SECTOR_SIZE;
+  size_t i;
+
+  for (i = 0; left > 0; i++)
+    {
+      size_t page_left = PGSIZE - pg_ofs (p);
+      size_t size = left < page_left ? left : page_left;
+      uintptr_t phys = buffer_to_phys (p);
+
+      ASSERT (i < PRD_CNT);
+      if (phys == 0)
+        return false;
+      c->prdt[i].addr = phys;
+      c->prdt[i].size = size;
+      c->prdt[i].flags = size == left ? PRD_EOT : 0;
+      p += size;
+      left -= size;
+    }
+  return true;
+}
+
+/* The CPU never touches a user buffer that DMA reads into, so
+   the processor does not set its pages' dirty and accessed bits
+   the way input_sector()'s stores would.  Sets them by hand for
+   the BLOCK_SECTOR_SIZE bytes at BUFFER, if it is a user
+   address, so that eviction does not discard the new data. */
+static void
+mark_user_written (const void *buffer)
+{
+#ifdef USERPROG
+  const uint8_t *p = pg_round_down (buffer);
+  const uint8_t *end = (const uint8_t *) buffer + BLOCK_SECTOR_SIZE;
+  uint32_t *pd = thread_current ()->pagedir;
+
+  if (is_kernel_vaddr (buffer) || pd == NULL)
+    return;
+  for (; p < end; p += PGSIZE)
+    {
+      pagedir_set_accessed (pd, p, true);
+      pagedir_set_dirty (pd, p, true);
+    }
+#else
+  (void) buffer;
+#endif
+}
+
+/* Transfers sector SEC_NO between disk D and BUFFER by DMA,
+   writing to the disk if WRITE is true, otherwise reading from
+   it.  The channel's lock must be held.  Returns false, without
+   doing anything, if D does not use DMA or BUFFER cannot be
+   reached by DMA, in which case the caller should use PIO. */
+static bool
+dma_transfer (struct ata_disk *d, block_sector_t sec_no, void *buffer,
+              bool write)
+{
+  struct channel *c = d->channel;
+  uint8_t bm_status, status;
+
+  if (!d->dma || !build_prdt (c, buffer))
+    return false;
+
+  /* Set up the bus master, clearing any old error and interrupt,
+     then start the command and the transfer. */
+  outl (reg_bm_prdt (c), vtop (c->prdt));
+  outb (reg_bm_command (c), write ? 0 : BM_CMD_READ);
+  outb (reg_bm_status (c),
+        inb (reg_bm_status (c)) | BM_STA_ERR | BM_STA_INTR);
+  select_sector (d, sec_no);
+  issue_pio_command (c, write ? CMD_WRITE_DMA : CMD_READ_DMA);
+  outb (reg_bm_command (c), (write ? 0 : BM_CMD_READ) | BM_CMD_START);
+
+  /* Sleep until the disk interrupts, then stop the bus master. */
+  sema_down (&c->completion_wait);
+  outb (reg_bm_command (c), write ? 0 : BM_CMD_READ);
+  bm_status = inb (reg_bm_status (c));
+  outb (reg_bm_status (c), bm_status | BM_STA_ERR | BM_STA_INTR);
+  status = inb (reg_alt_status (c));
+
+  if ((bm_status & BM_STA_ERR) || (status & (STA_ERR | STA_DF)))
+    PANIC ("%s: disk %s failed, sector=%"PRDSNu,
+           d->name, write ? "write" : "read", sec_no);
+  if (!write)
+    mark_user_written (buffer);
+  return true;
+}
+
 /* Low-level ATA primitives. */
 
 /* Wait up to 10 seconds for the controller to become idle, that
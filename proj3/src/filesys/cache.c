@@ -0,0 +1,731 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <ohash.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Buffer cache for file system sectors.
+
+   Every access to the file system device goes through a fixed
+   set of sector-sized buffers, so that repeated accesses to
+   inodes, directories, and the free map, and partial-sector
+   reads and writes, do not each cost a disk operation.
+
+   Writes only dirty the buffer.  A "write-behind" thread writes
+   back buffers that have been dirty for DIRTY_AGE ticks
+   periodically, cache_flush() writes all of them at file system
+   shutdown and on sync(), and cache_flush_range() writes those
+   of a file on fsync().  Dirty buffers are always written in
+   order of sector number, so that the disk head sweeps across
+   the disk once instead of seeking back and forth.  A
+   "read-ahead" thread reads sectors that callers expect to need
+   soon, so that sequential reads find their data already in the
+   cache.
+
+   Direct I/O, with cache_read_direct() and cache_write_direct(),
+   transfers whole sectors between the disk and the caller's
+   buffer without taking a buffer, so that streaming through a
+   large file neither evicts everything else nor costs a copy.
+   Only a sector that happens to be cached already is read from
+   or written through its buffer, to keep the two coherent, and a
+   direct write checks again for a buffer once it is done, in
+   case the sector was read in while it was being written.
+
+   Buffers are found by sector through a hash table and evicted
+   with the clock algorithm.  A buffer's mapping, pin count, and
+   accessed bit are protected by the global cache_lock; its
+   contents, valid bit, and dirty bit are protected by its own
+   lock, which may only be acquired while the buffer is pinned.
+   Thus an unpinned buffer's lock is never held, and disk I/O is
+   never done while holding cache_lock.
+
+   Metadata is written with cache_write_meta() instead, which
+   marks the buffer "logged" until the journal commits it (see
+   journal.c).  A logged buffer holds an extra pin, so it is not
+   evicted, and is not written back, until then.  To commit, the
+   journal locks every logged buffer with cache_freeze(), writes
+   them to the log, and releases them with cache_thaw(). */
+
+/* Number of buffers in the cache. */
+#define CACHE_CNT 64
+
+/* Time between write-behind passes, the number of passes
+   between those that also flush delayed data and checkpoint the
+   journal, and how long a buffer stays dirty before a pass
+   writes it back. */
+#define WRITE_BEHIND_TICKS TIMER_FREQ
+#define CHECKPOINT_PASSES 5
+#define DIRTY_AGE (TIMER_FREQ * 3)
+
+/* Maximum number of queued read-ahead requests. */
+#define READAHEAD_CNT 16
+
+/* Numbers of logged buffers at which to ask the journal to
+   commit, and at which to make it commit right away. */
+#define LOGGED_SOFT (CACHE_CNT / 4)
+#define LOGGED_HARD (CACHE_CNT / 2)
+
+/* A cached sector. */
+struct cache_entry
+  {
+    struct ohash_elem hash_elem;        /* cache_map element, keyed by sector. */
+    bool mapped;                        /* In cache_map? */
+    int pin_cnt;                        /* Users that may not see it evicted. */
+    bool accessed;                      /* Recently used? */
+
+    struct lock lock;                   /* Protects the following. */
+    bool valid;                         /* Does data hold the sector's contents? */
+    bool dirty;                         /* Does data need to be written back? */
+    int64_t dirtied;                    /* When dirty became true. */
+    bool logged;                        /* Not yet committed by the journal? */
+    uint8_t data[BLOCK_SECTOR_SIZE];    /* Sector contents. */
+  };
+
+static struct cache_entry cache[CACHE_CNT];
+static struct lock cache_lock;          /* Protects cache mappings. */
+static struct ohash cache_map;          /* Sector to mapped cache_entry. */
+static struct condition cache_unpinned; /* Signaled when an entry is unpinned. */
+static size_t clock_hand;               /* Next eviction candidate. */
+static size_t logged_cnt;               /* Number of logged entries. */
+
+/* Entries locked by cache_freeze(). */
+static struct cache_entry *frozen[CACHE_CNT];
+static size_t frozen_cnt;
+
+/* Read-ahead queue, protected by cache_lock. */
+static block_sector_t readahead_queue[READAHEAD_CNT];
+static size_t readahead_head, readahead_cnt;
+static struct condition readahead_cond;
+
+/* Statistics. */
+static long long hit_cnt;               /* Lookups that found the sector. */
+static long long miss_cnt;              /* Lookups that did not. */
+static long long readahead_read_cnt;    /* Sectors read ahead. */
+static long long writeback_cnt;         /* Dirty sectors written. */
+static long long direct_cnt;            /* Sectors transferred directly. */
+
+static thread_func write_behind_thread;
+static thread_func readahead_thread;
+
+/* Initializes the buffer cache and starts its helper threads. */
+void
+cache_init (void)
+{
+  size_t i;
+
+  lock_init (&cache_lock);
+  cond_init (&cache_unpinned);
+  cond_init (&readahead_cond);
+  if (!ohash_init (&cache_map, NULL)
+      || !ohash_reserve (&cache_map, CACHE_CNT))
+    PANIC ("buffer cache initialization failed");
+  for (i = 0; i < CACHE_CNT; i++)
+    lock_init (&cache[i].lock);
+
+  thread_create ("write-behind", PRI_DEFAULT, write_behind_thread, NULL);
+  thread_create ("read-ahead", PRI_DEFAULT, readahead_thread, NULL);
+}
+
+/* Writes E's data back to disk if it is dirty and not logged.
+   E must be pinned and locked. */
+static void
+entry_write_back (struct cache_entry *e)
+{
+  ASSERT (lock_held_by_current_thread (&e->lock));
+
+  if (e->valid && e->dirty && !e->logged)
+    {
+      block_write (fs_device, e->hash_elem.key, e->data);
+      e->dirty = false;
+      writeback_cnt++;
+    }
+}
+
+/* Marks E, which must be locked, dirty. */
+static void
+entry_dirty (struct cache_entry *e)
+{
+  if (!e->dirty)
+    {
+      e->dirty = true;
+      e->dirtied = timer_ticks ();
+    }
+}
+
+/* Chooses an unpinned cache entry to evict, using the clock
+   algorithm, and returns it, or returns a null pointer if every
+   entry is pinned.  Must be called with cache_lock held. */
+static struct cache_entry *
+choose_victim (void)
+{
+  size_t i;
+
+  for (i = 0; i < 2 * CACHE_CNT; i++)
+    {
+      struct cache_entry *e = &cache[clock_hand];
+      clock_hand = (clock_hand + 1) % CACHE_CNT;
+
+      if (e->pin_cnt > 0)
+        continue;
+      else if (e->accessed && e->mapped)
+        e->accessed = false;
+      else
+        return e;
+    }
+  return NULL;
+}
+
+/* Returns the cache entry for SECTOR, pinned, evicting another
+   sector to make room if necessary.  The entry's data is not
+   necessarily valid.  Counts a hit or a miss if COUNT is true. */
+static struct cache_entry *
+entry_get (block_sector_t sector, bool count)
+{
+  struct cache_entry *e;
+
+  lock_acquire (&cache_lock);
+  for (;;)
+    {
+      struct ohash_elem *found = ohash_find (&cache_map, sector);
+
+      if (found != NULL)
+        {
+          e = ohash_entry (found, struct cache_entry, hash_elem);
+          e->pin_cnt++;
+          e->accessed = true;
+          if (count)
+            hit_cnt++;
+          break;
+        }
+
+      e = choose_victim ();
+      if (e == NULL)
+        {
+          cond_wait (&cache_unpinned, &cache_lock);
+          continue;
+        }
+
+      if (e->dirty)
+        {
+          /* Write back the victim without holding cache_lock, then
+             start over, since SECTOR may have been brought in by
+             someone else in the meantime. */
+          e->pin_cnt++;
+          lock_release (&cache_lock);
+          lock_acquire (&e->lock);
+          entry_write_back (e);
+          lock_release (&e->lock);
+          lock_acquire (&cache_lock);
+          if (--e->pin_cnt == 0)
+            cond_signal (&cache_unpinned, &cache_lock);
+          continue;
+        }
+
+      /* E is clean and unpinned, so nobody holds its lock. */
+      if (e->mapped)
+        ohash_delete (&cache_map, e->hash_elem.key);
+      e->hash_elem.key = sector;
+      found = ohash_insert (&cache_map, &e->hash_elem);
+      ASSERT (found == NULL);
+      e->mapped = true;
+      e->valid = false;
+      e->pin_cnt = 1;
+      e->accessed = true;
+      if (count)
+        miss_cnt++;
+      break;
+    }
+  lock_release (&cache_lock);
+
+  return e;
+}
+
+/* Unpins E. */
+static void
+entry_put (struct cache_entry *e)
+{
+  lock_acquire (&cache_lock);
+  ASSERT (e->pin_cnt > 0);
+  if (--e->pin_cnt == 0)
+    cond_signal (&cache_unpinned, &cache_lock);
+  lock_release (&cache_lock);
+}
+
+/* Locks E, which must be pinned, and reads its sector from disk
+   if its data is not yet valid. */
+static void
+entry_lock_valid (struct cache_entry *e)
+{
+  lock_acquire (&e->lock);
+  if (!e->valid)
+    {
+      block_read (fs_device, e->hash_elem.key, e->data);
+      e->valid = true;
+    }
+}
+
+/* Reads SIZE bytes from SECTOR, starting at byte offset OFS,
+   into BUFFER. */
+void
+cache_read_at (block_sector_t sector, void *buffer, int ofs, int size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = entry_get (sector, true);
+  entry_lock_valid (e);
+  memcpy (buffer, e->data + ofs, size);
+  lock_release (&e->lock);
+  entry_put (e);
+}
+
+/* Reads all of SECTOR into BUFFER, which must have room for
+   BLOCK_SECTOR_SIZE bytes. */
+void
+cache_read (block_sector_t sector, void *buffer)
+{
+  cache_read_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Writes SIZE bytes from BUFFER into SECTOR, starting at byte
+   offset OFS.  The data reaches disk later, at the next
+   write-behind pass, eviction, or cache_flush(). */
+void
+cache_write_at (block_sector_t sector, const void *buffer, int ofs, int size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = entry_get (sector, true);
+  if (size == BLOCK_SECTOR_SIZE)
+    {
+      /* Overwriting the whole sector, so no need to read it. */
+      lock_acquire (&e->lock);
+      e->valid = true;
+    }
+  else
+    entry_lock_valid (e);
+  memcpy (e->data + ofs, buffer, size);
+  entry_dirty (e);
+  lock_release (&e->lock);
+  entry_put (e);
+}
+
+/* Writes all of SECTOR from BUFFER, which must contain
+   BLOCK_SECTOR_SIZE bytes. */
+void
+cache_write (block_sector_t sector, const void *buffer)
+{
+  cache_write_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Returns the cache entry for SECTOR, pinned, if SECTOR is
+   cached, or a null pointer otherwise.  Unlike entry_get(), does
+   not count as a use. */
+static struct cache_entry *
+entry_find (block_sector_t sector)
+{
+  struct ohash_elem *found;
+  struct cache_entry *e = NULL;
+
+  lock_acquire (&cache_lock);
+  found = ohash_find (&cache_map, sector);
+  if (found != NULL)
+    {
+      e = ohash_entry (found, struct cache_entry, hash_elem);
+      e->pin_cnt++;
+    }
+  lock_release (&cache_lock);
+
+  return e;
+}
+
+/* Reads all of SECTOR into BUFFER, which must have room for
+   BLOCK_SECTOR_SIZE bytes, straight from disk unless the sector
+   is cached. */
+void
+cache_read_direct (block_sector_t sector, void *buffer)
+{
+  struct cache_entry *e = entry_find (sector);
+
+  if (e != NULL)
+    {
+      lock_acquire (&e->lock);
+      if (e->valid)
+        memcpy (buffer, e->data, BLOCK_SECTOR_SIZE);
+      else
+        block_read (fs_device, sector, buffer);
+      lock_release (&e->lock);
+      entry_put (e);
+    }
+  else
+    block_read (fs_device, sector, buffer);
+  direct_cnt++;
+}
+
+/* Writes all of SECTOR from BUFFER, which must contain
+   BLOCK_SECTOR_SIZE bytes, straight to disk.  If the sector is
+   cached, its buffer is updated too, and if the buffer is logged,
+   only the buffer, since the sector may not reach its home
+   location before the journal commits it. */
+void
+cache_write_direct (block_sector_t sector, const void *buffer)
+{
+  struct cache_entry *e = entry_find (sector);
+  bool written = false;
+
+  if (e == NULL)
+    {
+      block_write (fs_device, sector, buffer);
+      written = true;
+
+      /* Another thread, such as the read-ahead thread, may have
+         read the sector into a buffer while we were writing it,
+         perhaps before the write reached the disk.  Its loader
+         holds the buffer's lock until it is valid, so updating
+         the buffer below replaces any old data it read. */
+      e = entry_find (sector);
+    }
+  if (e != NULL)
+    {
+      lock_acquire (&e->lock);
+      memcpy (e->data, buffer, BLOCK_SECTOR_SIZE);
+      e->valid = true;
+      if (e->logged)
+        entry_dirty (e);
+      else
+        {
+          if (!written)
+            block_write (fs_device, sector, buffer);
+          e->dirty = false;
+        }
+      lock_release (&e->lock);
+      entry_put (e);
+    }
+  direct_cnt++;
+}
+
+/* Copies SIZE bytes from SRC_SECTOR, starting at byte offset
+   SRC_OFS, into DST_SECTOR, starting at byte offset DST_OFS,
+   straight from one buffer to the other.  DST_SECTOR is written
+   as by cache_write_at().  The sectors must differ. */
+void
+cache_copy_at (block_sector_t dst_sector, int dst_ofs,
+               block_sector_t src_sector, int src_ofs, int size)
+{
+  struct cache_entry *dst, *src;
+
+  ASSERT (dst_sector != src_sector);
+  ASSERT (dst_ofs >= 0 && size >= 0 && dst_ofs + size <= BLOCK_SECTOR_SIZE);
+  ASSERT (src_ofs >= 0 && src_ofs + size <= BLOCK_SECTOR_SIZE);
+
+  /* Pin both buffers first, so that neither is evicted to make
+     room for the other, then lock them in order of sector
+     number, so that copies in opposite directions cannot
+     deadlock. */
+  src = entry_get (src_sector, true);
+  dst = entry_get (dst_sector, true);
+  if (src_sector < dst_sector)
+    entry_lock_valid (src);
+  if (size == BLOCK_SECTOR_SIZE)
+    {
+      lock_acquire (&dst->lock);
+      dst->valid = true;
+    }
+  else
+    entry_lock_valid (dst);
+  if (src_sector > dst_sector)
+    entry_lock_valid (src);
+
+  memcpy (dst->data + dst_ofs, src->data + src_ofs, size);
+  entry_dirty (dst);
+
+  lock_release (&dst->lock);
+  lock_release (&src->lock);
+  entry_put (dst);
+  entry_put (src);
+}
+
+/* Writes SIZE bytes of metadata from BUFFER into SECTOR,
+   starting at byte offset OFS.  If the journal is enabled, the
+   data reaches SECTOR only after the journal commits it, and a
+   commit is requested once enough such data has built up. */
+void
+cache_write_meta_at (block_sector_t sector, const void *buffer,
+                     int ofs, int size)
+{
+  struct cache_entry *e;
+  bool newly_logged = false;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  if (!journal_enabled ())
+    {
+      cache_write_at (sector, buffer, ofs, size);
+      return;
+    }
+
+  e = entry_get (sector, true);
+  lock_acquire (&e->lock);
+  if (!e->logged)
+    {
+      /* Any change already in the buffer was committed, and must
+         reach disk before the log can be checkpointed. */
+      entry_write_back (e);
+      e->logged = true;
+      newly_logged = true;
+      lock_acquire (&cache_lock);
+      e->pin_cnt++;
+      logged_cnt++;
+      lock_release (&cache_lock);
+    }
+  if (!e->valid && size < BLOCK_SECTOR_SIZE)
+    block_read (fs_device, sector, e->data);
+  e->valid = true;
+  memcpy (e->data + ofs, buffer, size);
+  entry_dirty (e);
+  lock_release (&e->lock);
+  entry_put (e);
+
+  if (newly_logged)
+    {
+      if (logged_cnt >= LOGGED_HARD)
+        journal_force ();
+      else if (logged_cnt >= LOGGED_SOFT)
+        journal_commit ();
+    }
+}
+
+/* Writes all of SECTOR, as metadata, from BUFFER, which must
+   contain BLOCK_SECTOR_SIZE bytes. */
+void
+cache_write_meta (block_sector_t sector, const void *buffer)
+{
+  cache_write_meta_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Locks every logged entry, so that it cannot change, and stores
+   its sector and a pointer to its data in SECTORS and DATA,
+   which must have room for MAX entries.  Returns the number of
+   entries.  The caller must call cache_thaw() afterward. */
+size_t
+cache_freeze (block_sector_t sectors[], const void *data[], size_t max)
+{
+  size_t i;
+
+  ASSERT (frozen_cnt == 0);
+
+  for (i = 0; i < CACHE_CNT; i++)
+    {
+      struct cache_entry *e = &cache[i];
+
+      lock_acquire (&cache_lock);
+      if (!e->mapped)
+        {
+          lock_release (&cache_lock);
+          continue;
+        }
+      e->pin_cnt++;
+      lock_release (&cache_lock);
+
+      lock_acquire (&e->lock);
+      if (e->logged)
+        {
+          ASSERT (frozen_cnt < max);
+          sectors[frozen_cnt] = e->hash_elem.key;
+          data[frozen_cnt] = e->data;
+          frozen[frozen_cnt++] = e;
+        }
+      else
+        {
+          lock_release (&e->lock);
+          entry_put (e);
+        }
+    }
+  return frozen_cnt;
+}
+
+/* Unlocks the entries locked by cache_freeze(), which are no
+   longer logged, since the journal has committed them. */
+void
+cache_thaw (void)
+{
+  while (frozen_cnt > 0)
+    {
+      struct cache_entry *e = frozen[--frozen_cnt];
+
+      e->logged = false;
+      lock_release (&e->lock);
+      lock_acquire (&cache_lock);
+      e->pin_cnt--;
+      logged_cnt--;
+      lock_release (&cache_lock);
+      entry_put (e);
+    }
+}
+
+/* Asks for SECTOR to be read into the cache in the background,
+   because it is likely to be read soon.  Does nothing if SECTOR
+   is already cached or too many requests are already queued. */
+void
+cache_readahead (block_sector_t sector)
+{
+  lock_acquire (&cache_lock);
+  if (ohash_find (&cache_map, sector) == NULL
+      && readahead_cnt < READAHEAD_CNT)
+    {
+      readahead_queue[(readahead_head + readahead_cnt++) % READAHEAD_CNT]
+        = sector;
+      cond_signal (&readahead_cond, &cache_lock);
+    }
+  lock_release (&cache_lock);
+}
+
+/* Writes back every dirty entry for a sector from FIRST
+   through FIRST + CNT - 1 that has been dirty since tick
+   DIRTIED_BY or earlier, except those that the journal has yet
+   to commit, in order of sector number. */
+static void
+write_back_sorted (block_sector_t first, block_sector_t cnt,
+                   int64_t dirtied_by)
+{
+  struct cache_entry *batch[CACHE_CNT];
+  size_t batch_cnt = 0;
+  size_t i;
+
+  /* Pin the candidates.  An entry's dirty bit and age are only
+     hints until it is locked. */
+  lock_acquire (&cache_lock);
+  for (i = 0; i < CACHE_CNT; i++)
+    {
+      struct cache_entry *e = &cache[i];
+
+      if (e->mapped && e->dirty && !e->logged
+          && e->hash_elem.key - first < cnt && e->dirtied <= dirtied_by)
+        {
+          e->pin_cnt++;
+          batch[batch_cnt++] = e;
+        }
+    }
+  lock_release (&cache_lock);
+
+  /* Sort them by sector. */
+  for (i = 1; i < batch_cnt; i++)
+    {
+      struct cache_entry *e = batch[i];
+      size_t j;
+
+      for (j = i; j > 0 && batch[j - 1]->hash_elem.key > e->hash_elem.key;
+           j--)
+        batch[j] = batch[j - 1];
+      batch[j] = e;
+    }
+
+  for (i = 0; i < batch_cnt; i++)
+    {
+      struct cache_entry *e = batch[i];
+
+      lock_acquire (&e->lock);
+      if (e->dirtied <= dirtied_by)
+        entry_write_back (e);
+      lock_release (&e->lock);
+      entry_put (e);
+    }
+}
+
+/* Writes every dirty sector in the cache to disk, except those
+   that the journal has yet to commit. */
+void
+cache_flush (void)
+{
+  write_back_sorted (0, (block_sector_t) -1, INT64_MAX);
+}
+
+/* Writes the dirty sectors from FIRST through FIRST + CNT - 1
+   in the cache to disk, except those that the journal has yet
+   to commit. */
+void
+cache_flush_range (block_sector_t first, block_sector_t cnt)
+{
+  write_back_sorted (first, cnt, INT64_MAX);
+}
+
+/* Prints buffer cache statistics. */
+void
+cache_print_stats (void)
+{
+  long long lookup_cnt = hit_cnt + miss_cnt;
+
+  printf ("Buffer cache: %lld hits, %lld misses (%lld%% hit rate), "
+          "%lld read ahead, %lld written back, %lld direct\n",
+          hit_cnt, miss_cnt,
+          lookup_cnt > 0 ? hit_cnt * 100 / lookup_cnt : 0,
+          readahead_read_cnt, writeback_cnt, direct_cnt);
+}
+
+/* Every WRITE_BEHIND_TICKS timer ticks, asks the journal to
+   commit and writes back sectors that have been dirty for
+   DIRTY_AGE ticks or longer.  Every CHECKPOINT_PASSES passes,
+   instead flushes data held back for delayed allocation into the
+   cache first, and then writes all dirty sectors back by
+   checkpointing the journal. */
+static void
+write_behind_thread (void *aux UNUSED)
+{
+  unsigned pass;
+
+  for (pass = 1; ; pass++)
+    {
+      timer_sleep (WRITE_BEHIND_TICKS);
+      if (pass % CHECKPOINT_PASSES == 0)
+        {
+          inode_flush_delayed ();
+          journal_commit ();
+          journal_checkpoint ();
+        }
+      else
+        {
+          journal_commit ();
+          write_back_sorted (0, (block_sector_t) -1,
+                             timer_ticks () - DIRTY_AGE);
+        }
+    }
+}
+
+/* Reads sectors queued by cache_readahead() into the cache. */
+static void
+readahead_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      struct cache_entry *e;
+      block_sector_t sector;
+
+      lock_acquire (&cache_lock);
+      while (readahead_cnt == 0)
+        cond_wait (&readahead_cond, &cache_lock);
+      sector = readahead_queue[readahead_head];
+      readahead_head = (readahead_head + 1) % READAHEAD_CNT;
+      readahead_cnt--;
+      lock_release (&cache_lock);
+
+      e = entry_get (sector, false);
+      lock_acquire (&e->lock);
+      if (!e->valid)
+        {
+          block_read (fs_device, sector, e->data);
+          e->valid = true;
+          readahead_read_cnt++;
+        }
+      lock_release (&e->lock);
+      entry_put (e);
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stddef.h>
+#include "devices/block.h"
+
+void cache_init (void);
+void cache_flush (void);
+void cache_flush_range (block_sector_t first, block_sector_t cnt);
+void cache_print_stats (void);
+
+void cache_read (block_sector_t, void *);
+void cache_read_at (block_sector_t, void *, int ofs, int size);
+void cache_write (block_sector_t, const void *);
+void cache_write_at (block_sector_t, const void *, int ofs, int size);
+void cache_read_direct (block_sector_t, void *);
+void cache_write_direct (block_sector_t, const void *);
+void cache_copy_at (block_sector_t dst, int dst_ofs,
+                    block_sector_t src, int src_ofs, int size);
+void cache_write_meta (block_sector_t, const void *);
+void cache_write_meta_at (block_sector_t, const void *, int ofs, int size);
+void cache_readahead (block_sector_t);
+
+size_t cache_freeze (block_sector_t sectors[], const void *data[], size_t max);
+void cache_thaw (void);
+
+#endif /* filesys/cache.h */
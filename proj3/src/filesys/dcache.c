@@ -0,0 +1,181 @@
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <ihash.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+
+/* Directory entry cache.
+
+   Remembers the results of recent name lookups, keyed by the
+   sector of the directory's inode and the name, so that opening
+   the same file again does not search the directory at all.
+   A lookup that failed is remembered too, as a "negative" entry
+   mapping the name to DCACHE_NEGATIVE, because creating a file
+   always starts by checking that the name is not yet in use.
+
+   The directory code keeps the cache coherent by calling
+   dcache_insert() whenever it adds or removes a name.  The
+   cache holds at most DCACHE_CNT entries and evicts the least
+   recently used one to make room for another. */
+
+/* Maximum number of cached entries. */
+#define DCACHE_CNT 512
+
+/* A cached name lookup. */
+struct dentry
+  {
+    struct hash_elem hash_elem;         /* Element in dcache_map. */
+    struct list_elem lru_elem;          /* Element in dcache_lru. */
+    block_sector_t dir_sector;          /* Containing directory's inode. */
+    block_sector_t inode_sector;        /* Named inode or DCACHE_NEGATIVE. */
+    char name[NAME_MAX + 1];            /* Null terminated file name. */
+  };
+
+static struct lock dcache_lock;         /* Protects all of the following. */
+static struct ihash dcache_map;         /* All cached entries. */
+static struct list dcache_lru;          /* Most recently used first. */
+static size_t dcache_cnt;               /* Number of cached entries. */
+static struct slab_cache dentry_cache;  /* Allocates dentries. */
+
+/* Statistics. */
+static long long hit_cnt;               /* Found, positive. */
+static long long negative_hit_cnt;      /* Found, negative. */
+static long long miss_cnt;              /* Not found. */
+
+static hash_hash_func dentry_hash;
+static hash_less_func dentry_less;
+
+/* Initializes the directory entry cache. */
+void
+dcache_init (void)
+{
+  lock_init (&dcache_lock);
+  if (!ihash_init (&dcache_map, dentry_hash, dentry_less, NULL))
+    PANIC ("dentry cache initialization failed");
+  list_init (&dcache_lru);
+  dcache_cnt = 0;
+  slab_cache_init (&dentry_cache, "dentry", sizeof (struct dentry), NULL);
+}
+
+/* Returns the cached entry for NAME in the directory whose inode
+   is in DIR_SECTOR, or a null pointer if there is none.
+   Must be called with dcache_lock held. */
+static struct dentry *
+find_dentry (block_sector_t dir_sector, const char *name)
+{
+  struct dentry key;
+  struct hash_elem *e;
+
+  key.dir_sector = dir_sector;
+  strlcpy (key.name, name, sizeof key.name);
+  e = ihash_find (&dcache_map, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct dentry, hash_elem) : NULL;
+}
+
+/* Looks up NAME in the directory whose inode is in DIR_SECTOR.
+   If the cache knows the answer, returns true and stores the
+   named inode's sector, or DCACHE_NEGATIVE if there is no such
+   name, in *INODE_SECTOR.  Otherwise returns false. */
+bool
+dcache_lookup (block_sector_t dir_sector, const char *name,
+               block_sector_t *inode_sector)
+{
+  struct dentry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return false;
+
+  lock_acquire (&dcache_lock);
+  d = find_dentry (dir_sector, name);
+  if (d != NULL)
+    {
+      list_remove (&d->lru_elem);
+      list_push_front (&dcache_lru, &d->lru_elem);
+      *inode_sector = d->inode_sector;
+      if (d->inode_sector != DCACHE_NEGATIVE)
+        hit_cnt++;
+      else
+        negative_hit_cnt++;
+    }
+  else
+    miss_cnt++;
+  lock_release (&dcache_lock);
+
+  return d != NULL;
+}
+
+/* Records that NAME in the directory whose inode is in
+   DIR_SECTOR refers to the inode in INODE_SECTOR, or, if
+   INODE_SECTOR is DCACHE_NEGATIVE, that there is no such name. */
+void
+dcache_insert (block_sector_t dir_sector, const char *name,
+               block_sector_t inode_sector)
+{
+  struct dentry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return;
+
+  lock_acquire (&dcache_lock);
+  d = find_dentry (dir_sector, name);
+  if (d != NULL)
+    list_remove (&d->lru_elem);
+  else
+    {
+      if (dcache_cnt >= DCACHE_CNT)
+        {
+          /* Recycle the least recently used entry. */
+          d = list_entry (list_pop_back (&dcache_lru), struct dentry, lru_elem);
+          ihash_delete (&dcache_map, &d->hash_elem);
+        }
+      else
+        {
+          d = slab_alloc (&dentry_cache);
+          if (d == NULL)
+            {
+              lock_release (&dcache_lock);
+              return;
+            }
+          dcache_cnt++;
+        }
+      d->dir_sector = dir_sector;
+      strlcpy (d->name, name, sizeof d->name);
+      ihash_insert (&dcache_map, &d->hash_elem);
+    }
+  d->inode_sector = inode_sector;
+  list_push_front (&dcache_lru, &d->lru_elem);
+  lock_release (&dcache_lock);
+}
+
+/* Prints directory entry cache statistics. */
+void
+dcache_print_stats (void)
+{
+  printf ("Dentry cache: %lld hits, %lld negative hits, %lld misses\n",
+          hit_cnt, negative_hit_cnt, miss_cnt);
+}
+
+/* Returns a hash of dentry E's directory and name. */
+static unsigned
+dentry_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct dentry *d = hash_entry (e, struct dentry, hash_elem);
+  return hash_string (d->name) ^ hash_int (d->dir_sector);
+}
+
+/* Returns true if dentry A precedes dentry B. */
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct dentry *a = hash_entry (a_, struct dentry, hash_elem);
+  const struct dentry *b = hash_entry (b_, struct dentry, hash_elem);
+
+  if (a->dir_sector != b->dir_sector)
+    return a->dir_sector < b->dir_sector;
+  return strcmp (a->name, b->name) < 0;
+}
@@ -0,0 +1,17 @@
+#ifndef FILESYS_DCACHE_H
+#define FILESYS_DCACHE_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+
+/* Inode sector recorded for a name known not to exist. */
+#define DCACHE_NEGATIVE ((block_sector_t) -1)
+
+void dcache_init (void);
+bool dcache_lookup (block_sector_t dir_sector, const char *name,
+                    block_sector_t *inode_sector);
+void dcache_insert (block_sector_t dir_sector, const char *name,
+                    block_sector_t inode_sector);
+void dcache_print_stats (void);
+
+#endif /* filesys/dcache.h */
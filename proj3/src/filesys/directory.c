@@ -1,11 +1,45 @@
 #include "filesys/directory.h"
+#include <dirent.h>
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
 
+/* A directory is a hash table of directory entries.  Block 0
+   of a directory's inode holds a `struct dir_header'.  Each
+   following block holds one bucket of ENTRIES_PER_BUCKET
+   entries, and a name is stored in the bucket selected by the
+   low bits of its hash, so that finding a name reads only the
+   header and one bucket, however large the directory is.
+
+   When a name's bucket is full, the directory doubles its
+   number of buckets: each old bucket I splits into buckets I and
+   I + BUCKET_CNT, by copying the entries that now belong in the
+   new bucket there.  The copies left behind in the old bucket
+   are not erased, but ignored, because an entry only counts if
+   it is in the bucket its name hashes to.  This makes a split a
+   single pass that reads each old bucket and writes each new
+   one once, and a split cut short leaves a consistent
+   directory. */
+
+/* Identifies a directory header. */
+#define DIR_MAGIC 0x44495248
+
+/* Header at the start of a directory. */
+struct dir_header
+  {
+    unsigned magic;                     /* DIR_MAGIC. */
+    uint32_t bucket_cnt;                /* Number of buckets, a power of 2. */
+    uint32_t entry_cnt;                 /* Number of names in use. */
+  };
+
+/* Limit on the number of buckets. */
+#define MAX_BUCKETS 4096
+
 /* A directory. */
 struct dir 
   {
@@ -21,12 +55,76 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* Number of entries in a bucket. */
+#define ENTRIES_PER_BUCKET (BLOCK_SECTOR_SIZE / sizeof (struct dir_entry))
+
+/* Returns the byte offset within a directory of entry IDX of
+   BUCKET. */
+static off_t
+entry_ofs (size_t bucket, size_t idx)
+{
+  return (bucket + 1) * BLOCK_SECTOR_SIZE + idx * sizeof (struct dir_entry);
+}
+
+/* Returns the bucket for NAME in a directory with BUCKET_CNT
+   buckets. */
+static size_t
+name_bucket (const char *name, size_t bucket_cnt)
+{
+  return hash_string (name) & (bucket_cnt - 1);
+}
+
+/* Returns true if E, found in BUCKET of a directory with header
+   H, is in use and in the bucket it belongs in. */
+static bool
+entry_live (const struct dir_entry *e, size_t bucket,
+            const struct dir_header *h)
+{
+  return e->in_use && name_bucket (e->name, h->bucket_cnt) == bucket;
+}
+
+/* Reads DIR's header into *H.  Returns true if successful. */
+static bool
+read_header (const struct dir *dir, struct dir_header *h)
+{
+  return (inode_read_at (dir->inode, h, sizeof *h, 0) == sizeof *h
+          && h->magic == DIR_MAGIC);
+}
+
+/* Writes *H as DIR's header.  Returns true if successful. */
+static bool
+write_header (struct dir *dir, const struct dir_header *h)
+{
+  return inode_write_at (dir->inode, h, sizeof *h, 0) == sizeof *h;
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool
 dir_create (block_sector_t sector, size_t entry_cnt)
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  struct dir_header h;
+  struct dir *dir;
+  bool success;
+
+  /* Leave buckets half empty, so names spread out evenly before
+     the first split. */
+  h.magic = DIR_MAGIC;
+  h.bucket_cnt = 1;
+  h.entry_cnt = 0;
+  while (h.bucket_cnt * ENTRIES_PER_BUCKET / 2 < entry_cnt
+         && h.bucket_cnt < MAX_BUCKETS)
+    h.bucket_cnt *= 2;
+
+  if (!inode_create (sector, (h.bucket_cnt + 1) * BLOCK_SECTOR_SIZE))
+    return false;
+  dir = dir_open (inode_open (sector));
+  if (dir == NULL)
+    return false;
+  inode_set_dir (dir_get_inode (dir));
+  success = write_header (dir, &h);
+  dir_close (dir);
+  return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -39,6 +137,7 @@ dir_open (struct inode *inode)
     {
       dir->inode = inode;
       dir->pos = 0;
+      inode_set_metadata (inode);
       return dir;
     }
   else
@@ -92,22 +191,56 @@ static bool
 lookup (const struct dir *dir, const char *name,
         struct dir_entry *ep, off_t *ofsp) 
 {
+  struct dir_header h;
   struct dir_entry e;
-  size_t ofs;
+  size_t bucket, idx;
   
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (e.in_use && !strcmp (name, e.name)) 
-      {
-        if (ep != NULL)
-          *ep = e;
-        if (ofsp != NULL)
-          *ofsp = ofs;
-        return true;
-      }
+  if (!read_header (dir, &h))
+    return false;
+
+  bucket = name_bucket (name, h.bucket_cnt);
+  for (idx = 0; idx < ENTRIES_PER_BUCKET; idx++)
+    {
+      off_t ofs = entry_ofs (bucket, idx);
+      if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
+        break;
+      if (e.in_use && !strcmp (name, e.name)) 
+        {
+          if (ep != NULL)
+            *ep = e;
+          if (ofsp != NULL)
+            *ofsp = ofs;
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Searches DIR for a file with the given NAME, first in the
+   directory entry cache and then on disk, recording what is
+   found on disk in the cache.  Returns true and sets
+   *INODE_SECTOR to the file's inode sector if found, otherwise
+   returns false. */
+static bool
+lookup_sector (const struct dir *dir, const char *name,
+               block_sector_t *inode_sector)
+{
+  block_sector_t dir_sector = inode_get_inumber (dir->inode);
+  struct dir_entry e;
+
+  if (dcache_lookup (dir_sector, name, inode_sector))
+    return *inode_sector != DCACHE_NEGATIVE;
+
+  if (lookup (dir, name, &e, NULL))
+    {
+      dcache_insert (dir_sector, name, e.inode_sector);
+      *inode_sector = e.inode_sector;
+      return true;
+    }
+  dcache_insert (dir_sector, name, DCACHE_NEGATIVE);
   return false;
 }
 
@@ -119,19 +252,74 @@ bool
 dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
-  struct dir_entry e;
+  block_sector_t inode_sector;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
+  inode_lock (dir->inode);
+  if (lookup_sector (dir, name, &inode_sector))
+    *inode = inode_open (inode_sector);
   else
     *inode = NULL;
+  inode_unlock (dir->inode);
 
   return *inode != NULL;
 }
 
+/* Doubles the number of buckets in DIR, whose header is *H,
+   splitting each bucket in two.  Returns true if successful,
+   false if a disk or memory error occurs. */
+static bool
+split_buckets (struct dir *dir, struct dir_header *h)
+{
+  struct dir_entry *old, *new;
+  size_t old_cnt = h->bucket_cnt;
+  size_t bucket, idx;
+  bool success = false;
+
+  if (old_cnt >= MAX_BUCKETS)
+    return false;
+
+  old = malloc (ENTRIES_PER_BUCKET * sizeof *old);
+  new = malloc (ENTRIES_PER_BUCKET * sizeof *new);
+  if (old == NULL || new == NULL)
+    goto done;
+
+  /* Copy each entry that moves into its new bucket.  The new
+     buckets are written in order at the end of the directory, so
+     the directory grows sequentially. */
+  for (bucket = 0; bucket < old_cnt; bucket++)
+    {
+      off_t size = ENTRIES_PER_BUCKET * sizeof *old;
+
+      if (inode_read_at (dir->inode, old, size, entry_ofs (bucket, 0)) != size)
+        goto done;
+      memset (new, 0, size);
+      for (idx = 0; idx < ENTRIES_PER_BUCKET; idx++)
+        if (entry_live (&old[idx], bucket, h)
+            && name_bucket (old[idx].name, old_cnt * 2) != bucket)
+          new[idx] = old[idx];
+      if (inode_write_at (dir->inode, new, size,
+                          entry_ofs (bucket + old_cnt, 0)) != size)
+        goto done;
+    }
+
+  /* Switch to the new buckets. */
+  h->bucket_cnt = old_cnt * 2;
+  if (!write_header (dir, h))
+    {
+      h->bucket_cnt = old_cnt;
+      goto done;
+    }
+  success = true;
+
+ done:
+  free (old);
+  free (new);
+  return success;
+}
+
 /* Adds a file named NAME to DIR, which must not already contain a
    file by that name.  The file's inode is in sector
    INODE_SECTOR.
@@ -141,8 +329,10 @@ dir_lookup (const struct dir *dir, const char *name,
 bool
 dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 {
+  struct dir_header h;
   struct dir_entry e;
-  off_t ofs;
+  block_sector_t existing;
+  off_t ofs = 0;
   bool success = false;
 
   ASSERT (dir != NULL);
@@ -153,28 +343,47 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
     return false;
 
   /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
+  inode_lock (dir->inode);
+  if (lookup_sector (dir, name, &existing))
     goto done;
 
-  /* Set OFS to offset of free slot.
-     If there are no free slots, then it will be set to the
-     current end-of-file.
-     
-     inode_read_at() will only return a short read at end of file.
-     Otherwise, we'd need to verify that we didn't get a short
-     read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (!e.in_use)
-      break;
+  /* Set OFS to offset of a free slot in NAME's bucket, splitting
+     buckets until there is one. */
+  if (!read_header (dir, &h))
+    goto done;
+  for (;;)
+    {
+      size_t bucket = name_bucket (name, h.bucket_cnt);
+      size_t idx;
+
+      for (idx = 0; idx < ENTRIES_PER_BUCKET; idx++)
+        {
+          ofs = entry_ofs (bucket, idx);
+          if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
+            goto done;
+          if (!entry_live (&e, bucket, &h))
+            break;
+        }
+      if (idx < ENTRIES_PER_BUCKET)
+        break;
+      if (!split_buckets (dir, &h))
+        goto done;
+    }
 
   /* Write slot. */
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  if (success)
+    {
+      h.entry_cnt++;
+      write_header (dir, &h);
+      dcache_insert (inode_get_inumber (dir->inode), name, inode_sector);
+    }
 
  done:
+  inode_unlock (dir->inode);
   return success;
 }
 
@@ -184,6 +393,7 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 bool
 dir_remove (struct dir *dir, const char *name) 
 {
+  struct dir_header h;
   struct dir_entry e;
   struct inode *inode = NULL;
   bool success = false;
@@ -193,6 +403,7 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (name != NULL);
 
   /* Find directory entry. */
+  inode_lock (dir->inode);
   if (!lookup (dir, name, &e, &ofs))
     goto done;
 
@@ -205,32 +416,114 @@ dir_remove (struct dir *dir, const char *name)
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
+  dcache_insert (inode_get_inumber (dir->inode), name, DCACHE_NEGATIVE);
+  if (read_header (dir, &h))
+    {
+      h.entry_cnt--;
+      write_header (dir, &h);
+    }
 
   /* Remove inode. */
   inode_remove (inode);
   success = true;
 
  done:
+  inode_unlock (dir->inode);
   inode_close (inode);
   return success;
 }
 
 /* Reads the next directory entry in DIR and stores the name in
    NAME.  Returns true if successful, false if the directory
-   contains no more entries. */
+   contains no more entries.  DIR's position counts entries,
+   bucket by bucket. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
+  struct dir_header h;
   struct dir_entry e;
+  bool success = false;
 
-  while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+  inode_lock (dir->inode);
+  if (!read_header (dir, &h))
+    goto done;
+
+  while ((size_t) dir->pos < h.bucket_cnt * ENTRIES_PER_BUCKET)
     {
-      dir->pos += sizeof e;
-      if (e.in_use)
+      size_t bucket = dir->pos / ENTRIES_PER_BUCKET;
+      size_t idx = dir->pos % ENTRIES_PER_BUCKET;
+
+      if (inode_read_at (dir->inode, &e, sizeof e, entry_ofs (bucket, idx))
+          != sizeof e)
+        break;
+      dir->pos++;
+      if (entry_live (&e, bucket, &h))
         {
           strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
+          success = true;
+          break;
         } 
     }
-  return false;
+
+ done:
+  inode_unlock (dir->inode);
+  return success;
+}
+
+/* Reads up to MAX entries from DIR, starting at its position,
+   into ENTRIES, each with the inode number, type, and size of the
+   file it names, and advances the position past them.  Reads a
+   whole bucket at a time, so that listing a directory costs one
+   read per bucket instead of one per entry.  Returns the number
+   of entries read, which is 0 at the end of the directory. */
+size_t
+dir_getdents (struct dir *dir, struct dirent *entries, size_t max)
+{
+  struct dir_header h;
+  struct dir_entry bucket_entries[ENTRIES_PER_BUCKET];
+  size_t cnt = 0;
+
+  inode_lock (dir->inode);
+  if (!read_header (dir, &h))
+    goto done;
+
+  while (cnt < max && (size_t) dir->pos < h.bucket_cnt * ENTRIES_PER_BUCKET)
+    {
+      size_t bucket = dir->pos / ENTRIES_PER_BUCKET;
+      size_t idx = dir->pos % ENTRIES_PER_BUCKET;
+      off_t size = (ENTRIES_PER_BUCKET - idx) * sizeof (struct dir_entry);
+
+      if (inode_read_at (dir->inode, bucket_entries + idx, size,
+                         entry_ofs (bucket, idx)) != size)
+        break;
+      for (; idx < ENTRIES_PER_BUCKET && cnt < max; idx++)
+        {
+          struct dir_entry *e = &bucket_entries[idx];
+
+          dir->pos++;
+          if (entry_live (e, bucket, &h))
+            {
+              /* The entry cannot be removed while the directory is
+                 locked, so this close never deletes the file. */
+              struct inode *inode = inode_open (e->inode_sector);
+              struct dirent *d = &entries[cnt++];
+
+              d->inumber = e->inode_sector;
+              d->type = DT_REG;
+              d->size = 0;
+              if (inode != NULL)
+                {
+                  if (inode_is_dir (inode))
+                    d->type = DT_DIR;
+                  d->size = inode_length (inode);
+                  inode_close (inode);
+                }
+              strlcpy (d->name, e->name, sizeof d->name);
+            }
+        }
+    }
+
+ done:
+  inode_unlock (dir->inode);
+  return cnt;
 }
@@ -2,6 +2,9 @@
 #include <debug.h>
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#ifdef VM
+#include "vm/pagecache.h"
+#endif
 
 /* An open file. */
 struct file 
@@ -9,6 +12,7 @@ struct file
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+    bool direct;                /* Bypass the caches? */
   };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -23,6 +27,7 @@ file_open (struct inode *inode)
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->direct = false;
       return file;
     }
   else
@@ -60,6 +65,45 @@ file_get_inode (struct file *file)
   return file->inode;
 }
 
+/* Makes reads and writes of FILE bypass the page cache and,
+   for whole sectors, the buffer cache, if DIRECT is true, or go
+   through them again if it is false.  Direct reads still see
+   changes made through memory mappings that are only in memory,
+   by taking those bytes from the page cache. */
+void
+file_set_direct (struct file *file, bool direct)
+{
+  file->direct = direct;
+}
+
+/* Reads from FILE, starting at OFFSET, into the IOV_CNT buffers
+   in IOV, through the page cache if there is one, so that data
+   read by one process or mapped into memory is read from disk
+   only once, unless FILE is direct. */
+static off_t
+read_iov (struct file *file, const struct iovec *iov, size_t iov_cnt,
+          off_t offset)
+{
+  if (file->direct)
+    return inode_readv_direct (file->inode, iov, iov_cnt, offset);
+#ifdef VM
+  return pagecache_readv (file->inode, iov, iov_cnt, offset);
+#else
+  return inode_readv (file->inode, iov, iov_cnt, offset);
+#endif
+}
+
+/* Writes the IOV_CNT buffers in IOV into FILE, starting at
+   OFFSET, directly if FILE is direct. */
+static off_t
+write_iov (struct file *file, const struct iovec *iov, size_t iov_cnt,
+           off_t offset)
+{
+  if (file->direct)
+    return inode_writev_direct (file->inode, iov, iov_cnt, offset);
+  return inode_writev (file->inode, iov, iov_cnt, offset);
+}
+
 /* Reads SIZE bytes from FILE into BUFFER,
    starting at the file's current position.
    Returns the number of bytes actually read,
@@ -68,7 +112,21 @@ file_get_inode (struct file *file)
 off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
-  off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  off_t bytes_read = file_read_at (file, buffer, size, file->pos);
+  file->pos += bytes_read;
+  return bytes_read;
+}
+
+/* Reads from FILE into the IOV_CNT buffers in IOV, in turn,
+   starting at the file's current position.
+   Returns the number of bytes actually read,
+   which may be less than the buffers' total size if end of file
+   is reached.
+   Advances FILE's position by the number of bytes read. */
+off_t
+file_readv (struct file *file, const struct iovec *iov, size_t iov_cnt)
+{
+  off_t bytes_read = read_iov (file, iov, iov_cnt, file->pos);
   file->pos += bytes_read;
   return bytes_read;
 }
@@ -81,7 +139,11 @@ file_read (struct file *file, void *buffer, off_t size)
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) 
 {
-  return inode_read_at (file->inode, buffer, size, file_ofs);
+  struct iovec iov;
+
+  iov.iov_base = buffer;
+  iov.iov_len = size;
+  return read_iov (file, &iov, 1, file_ofs);
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
@@ -94,7 +156,21 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
 off_t
 file_write (struct file *file, const void *buffer, off_t size) 
 {
-  off_t bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
+  off_t bytes_written = file_write_at (file, buffer, size, file->pos);
+  file->pos += bytes_written;
+  return bytes_written;
+}
+
+/* Writes the IOV_CNT buffers in IOV, in turn, into FILE,
+   starting at the file's current position.
+   Returns the number of bytes actually written,
+   which may be less than the buffers' total size if the disk
+   fills up.
+   Advances FILE's position by the number of bytes written. */
+off_t
+file_writev (struct file *file, const struct iovec *iov, size_t iov_cnt)
+{
+  off_t bytes_written = write_iov (file, iov, iov_cnt, file->pos);
   file->pos += bytes_written;
   return bytes_written;
 }
@@ -110,7 +186,48 @@ off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
                off_t file_ofs) 
 {
-  return inode_write_at (file->inode, buffer, size, file_ofs);
+  struct iovec iov;
+
+  iov.iov_base = (void *) buffer;
+  iov.iov_len = size;
+  return write_iov (file, &iov, 1, file_ofs);
+}
+
+/* Copies up to SIZE bytes from SRC, starting at its current
+   position, into DST, starting at its current position, inside
+   the file system, without a buffer in between.
+   Returns the number of bytes actually copied,
+   which may be less than SIZE if end of SRC is reached or the
+   disk fills up, or 0 if SRC and DST are the same file and the
+   ranges overlap.
+   Advances both files' positions by the number of bytes copied. */
+off_t
+file_copy (struct file *dst, struct file *src, off_t size)
+{
+  off_t bytes_copied = inode_copy (dst->inode, dst->pos,
+                                   src->inode, src->pos, size);
+  dst->pos += bytes_copied;
+  src->pos += bytes_copied;
+  return bytes_copied;
+}
+
+/* Allocates disk space for SIZE bytes of FILE starting at
+   offset START, extending the file if necessary, so that they
+   can later be written without running out of space.  The file
+   position is unaffected.
+   Returns true if successful, false if the disk is full or
+   writes to FILE are denied. */
+bool
+file_allocate (struct file *file, off_t start, off_t size)
+{
+  return inode_allocate (file->inode, start, size);
+}
+
+/* Writes FILE's data and metadata to disk. */
+void
+file_sync (struct file *file)
+{
+  inode_sync (file->inode);
 }
 
 /* Prevents write operations on FILE's underlying inode
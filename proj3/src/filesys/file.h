@@ -1,6 +1,8 @@
 #ifndef FILESYS_FILE_H
 #define FILESYS_FILE_H
 
+#include <iovec.h>
+#include <stdbool.h>
 #include "filesys/off_t.h"
 
 struct inode;
@@ -10,12 +12,18 @@ struct file *file_open (struct inode *);
 struct file *file_reopen (struct file *);
 void file_close (struct file *);
 struct inode *file_get_inode (struct file *);
+void file_set_direct (struct file *, bool);
 
 /* Reading and writing. */
 off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
+off_t file_readv (struct file *, const struct iovec *, size_t iov_cnt);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
+off_t file_writev (struct file *, const struct iovec *, size_t iov_cnt);
+off_t file_copy (struct file *dst, struct file *src, off_t size);
+bool file_allocate (struct file *, off_t start, off_t size);
+void file_sync (struct file *);
 
 /* Preventing writes. */
 void file_deny_write (struct file *);
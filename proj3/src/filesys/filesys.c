@@ -2,10 +2,13 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
+#include "filesys/dcache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "filesys/journal.h"
 
 /* Partition that contains the file system. */
 struct block *fs_device;
@@ -21,11 +24,16 @@ filesys_init (bool format)
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
 
+  cache_init ();
   inode_init ();
+  dcache_init ();
+  journal_init ();
   free_map_init ();
 
   if (format) 
     do_format ();
+  else
+    journal_open ();
 
   free_map_open ();
 }
@@ -35,10 +43,25 @@ filesys_init (bool format)
 void
 filesys_done (void) 
 {
+  inode_flush_delayed ();
   free_map_close ();
+  journal_done ();
 }
 
+/* Writes all file system data and metadata to disk.  Metadata
+   changes are made durable by committing them to the journal,
+   which later checkpoints them. */
+void
+filesys_sync (void) 
+{
+  inode_flush_delayed ();
+  cache_flush ();
+  journal_force ();
+}
+
 /* Creates a file named NAME with the given INITIAL_SIZE.
+   The new file's inode is placed near its directory's, and its
+   data near its inode.
    Returns true if successful, false otherwise.
    Fails if a file named NAME already exists,
    or if internal memory allocation fails. */
@@ -46,14 +69,21 @@ bool
 filesys_create (const char *name, off_t initial_size) 
 {
   block_sector_t inode_sector = 0;
-  struct dir *dir = dir_open_root ();
-  bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
+  struct dir *dir;
+  bool success;
+
+  journal_begin ();
+  dir = dir_open_root ();
+  success = (dir != NULL
+                  && free_map_allocate_near (1, inode_get_inumber
+                                               (dir_get_inode (dir)),
+                                             &inode_sector, NULL)
                   && inode_create (inode_sector, initial_size)
                   && dir_add (dir, name, inode_sector));
   if (!success && inode_sector != 0) 
     free_map_release (inode_sector, 1);
   dir_close (dir);
+  journal_end ();
 
   return success;
 }
@@ -76,6 +106,18 @@ filesys_open (const char *name)
   return file_open (inode);
 }
 
+/* Opens the directory with the given NAME.  The file system
+   has only the root directory, which may be named "/" or ".".
+   Returns the new directory if successful or a null pointer
+   otherwise. */
+struct dir *
+filesys_open_dir (const char *name)
+{
+  if (strcmp (name, "/") && strcmp (name, "."))
+    return NULL;
+  return dir_open_root ();
+}
+
 /* Deletes the file named NAME.
    Returns true if successful, false on failure.
    Fails if no file named NAME exists,
@@ -83,9 +125,14 @@ filesys_open (const char *name)
 bool
 filesys_remove (const char *name) 
 {
-  struct dir *dir = dir_open_root ();
-  bool success = dir != NULL && dir_remove (dir, name);
+  struct dir *dir;
+  bool success;
+
+  journal_begin ();
+  dir = dir_open_root ();
+  success = dir != NULL && dir_remove (dir, name);
   dir_close (dir); 
+  journal_end ();
 
   return success;
 }
@@ -98,6 +145,7 @@ do_format (void)
   free_map_create ();
   if (!dir_create (ROOT_DIR_SECTOR, 16))
     PANIC ("root directory creation failed");
+  journal_create ();
   free_map_close ();
   printf ("done.\n");
 }
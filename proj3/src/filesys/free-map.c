@@ -1,76 +1,434 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <list.h>
+#include <ohash.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
+/* FREE_MAP_LOCK protects all of the free map's state.  It may be
+   acquired while holding an inode's lock, so nothing here may
+   acquire an inode lock other than the free map file's. */
+static struct lock free_map_lock;
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
+static block_sector_t next_fit;      /* Where the next search starts. */
+
+/* Each change to the free map is written to the free map file
+   right away, which only changes the file's buffers in the
+   buffer cache, so that the journal commits it along with the
+   changes to the files that took or gave up the sectors.
+
+   Sectors freed while the journal is enabled are not allocated
+   again until the transaction that freed them commits, because
+   until then the log may still hold images of them that replay
+   would write over their new contents (see journal.c).  Until
+   then they are kept on a list of pending frees instead of in
+   the free extent index below. */
+struct pending_free
+  {
+    struct list_elem elem;           /* Element in pending_frees. */
+    block_sector_t start;            /* First sector. */
+    size_t cnt;                      /* Number of sectors. */
+    uint32_t seq;                    /* Transaction that freed them. */
+  };
+
+static struct list pending_frees;    /* Oldest first. */
+static size_t pending_cnt;           /* Sectors on pending_frees. */
+
+/* Reservations.
+
+   Space for data that has been accepted but not yet given
+   sectors, such as the contents of inodes' delay buffers, is set
+   aside with free_map_reserve() so that other allocations cannot
+   use it up in the meantime.  Allocation fails rather than eat
+   into reserved space, unless the caller passes a reservation of
+   its own to draw on, and sectors whose release is still pending
+   never count as free for this purpose, since they cannot be
+   allocated until their transaction commits. */
+static size_t total_free;            /* Free sectors, counting pending. */
+static size_t reserved;              /* Sectors set aside. */
+
+/* Allocation groups.
+
+   The disk is divided into groups of GROUP_SECTORS sectors, each
+   with its own count of free sectors and its own part of the
+   free extent index below.  free_map_allocate_near() allocates
+   from the group that holds a "goal" sector when it can, and
+   otherwise from the nearest group that can, so that callers
+   can keep related sectors, such as a file's data and its inode,
+   or an inode and its directory, close together on disk and
+   save seeks.  No run of sectors longer than a group is ever
+   allocated at once. */
+#define GROUP_SECTORS 512
+
+/* Free extent index.
+
+   Alongside the bitmap, which is what goes to disk, we keep an
+   index of the runs of free sectors, so that allocating CNT
+   sectors finds a run that is long enough without scanning the
+   bitmap.  Runs are split at group boundaries.  Each run is on
+   its group's list for its size class, class K holding runs of
+   2**K to 2**(K+1) - 1 sectors, and in two hash tables, by its
+   first sector and by the sector just past its end, so that a
+   released run can be merged with its neighbors in constant
+   time.
+
+   If the index ever cannot allocate memory for a run, or a hash
+   table cannot grow to hold one, it is abandoned and allocation
+   falls back to scanning the bitmap. */
+struct free_extent
+  {
+    struct ohash_elem start_elem;    /* Key is first sector. */
+    struct ohash_elem end_elem;      /* Key is sector past the end. */
+    struct list_elem class_elem;     /* Element in size class list. */
+  };
+
+#define CLASS_CNT 10                 /* Size classes, enough for a group. */
+
+/* An allocation group. */
+struct group
+  {
+    size_t free_cnt;                 /* Number of free sectors. */
+    struct list classes[CLASS_CNT];  /* Free extents, by size class. */
+  };
+
+static struct group *groups;         /* All the groups. */
+static size_t group_cnt;             /* Number of groups. */
+
+/* Returns the first sector past the group that holds SECTOR. */
+static inline block_sector_t
+group_end (block_sector_t sector)
+{
+  return (sector / GROUP_SECTORS + 1) * GROUP_SECTORS;
+}
+
+static bool index_valid;             /* Is the index in use? */
+static struct ohash by_start;        /* Free extents by first sector. */
+static struct ohash by_end;          /* Free extents by end sector. */
+static struct slab_cache extent_cache;
+
+static void index_build (void);
+static void index_abandon (void);
+static bool index_allocate (size_t cnt, block_sector_t goal,
+                            block_sector_t *sectorp);
+static size_t index_allocate_at (block_sector_t sector, size_t cnt);
+static void index_release (block_sector_t sector, size_t cnt);
+static void release_committed (void);
+static size_t unreserved (const size_t *reserve);
+static void draw_reserve (size_t cnt, size_t *reserve);
 
 /* Initializes the free map. */
 void
-free_map_init (void) 
+free_map_init (void)
 {
+  lock_init (&free_map_lock);
   free_map = bitmap_create (block_size (fs_device));
   if (free_map == NULL)
     PANIC ("bitmap creation failed--file system device is too large");
+  bitmap_enable_summary (free_map);
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  bitmap_mark (free_map, JOURNAL_SECTOR);
+  list_init (&pending_frees);
+  pending_cnt = 0;
+  reserved = 0;
+
+  group_cnt = DIV_ROUND_UP (bitmap_size (free_map), GROUP_SECTORS);
+  groups = malloc (group_cnt * sizeof *groups);
+  if (groups == NULL)
+    PANIC ("allocation group creation failed");
+
+  slab_cache_init (&extent_cache, "free-extent",
+                   sizeof (struct free_extent), NULL);
+  index_build ();
+}
+
+/* Marks CNT sectors starting at SECTOR as allocated (if
+   ALLOCATED is true) or free, updating their groups' free
+   counts, and writes the changed bits to the free map file. */
+static void
+set_sectors (block_sector_t sector, size_t cnt, bool allocated)
+{
+  block_sector_t end = sector + cnt;
+  block_sector_t s;
+
+  ASSERT (cnt > 0);
+
+  bitmap_set_multiple (free_map, sector, cnt, allocated);
+  for (s = sector; s < end; )
+    {
+      struct group *g = &groups[s / GROUP_SECTORS];
+      size_t n = (end < group_end (s) ? end : group_end (s)) - s;
+
+      if (allocated)
+        g->free_cnt -= n;
+      else
+        g->free_cnt += n;
+      s += n;
+    }
+  if (allocated)
+    total_free -= cnt;
+  else
+    total_free += cnt;
+
+  if (free_map_file != NULL
+      && !bitmap_write_range (free_map, free_map_file, sector, cnt))
+    PANIC ("can't write free map");
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
    the first into *SECTORP.
    Returns true if successful, false if not enough consecutive
-   sectors were available or if the free_map file could not be
-   written. */
+   sectors were available. */
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  return free_map_allocate_near (cnt, next_fit, sectorp, NULL);
+}
+
+/* Allocates CNT consecutive sectors from the free map, as close
+   to sector GOAL as possible, and stores the first into
+   *SECTORP.  Sectors in GOAL's own allocation group are used if
+   any run there is long enough, and otherwise sectors in the
+   nearest group that has such a run.  If RESERVE is nonnull, it
+   points to a reservation made with free_map_reserve() that the
+   allocation may use, and which is reduced by the sectors it
+   takes.
+   Returns true if successful, false if not enough consecutive
+   unreserved sectors were available, which is always the case
+   if CNT is greater than GROUP_SECTORS. */
+bool
+free_map_allocate_near (size_t cnt, block_sector_t goal,
+                        block_sector_t *sectorp, size_t *reserve)
+{
+  block_sector_t sector;
+  bool success;
+
+  if (cnt > GROUP_SECTORS)
+    return false;
+  if (goal >= bitmap_size (free_map))
+    goal = 0;
+
+  lock_acquire (&free_map_lock);
+  release_committed ();
+  if (unreserved (reserve) < cnt)
+    success = false;
+  else if (index_valid)
+    success = index_allocate (cnt, goal, &sector);
+  else
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      sector = bitmap_scan_next_fit (free_map, goal, cnt, false);
+      success = sector != BITMAP_ERROR;
     }
-  if (sector != BITMAP_ERROR)
-    *sectorp = sector;
-  return sector != BITMAP_ERROR;
+  if (success)
+    {
+      set_sectors (sector, cnt, true);
+      draw_reserve (cnt, reserve);
+      *sectorp = sector;
+      next_fit = sector + cnt;
+    }
+  lock_release (&free_map_lock);
+
+  return success;
 }
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Allocates up to CNT free sectors starting exactly at SECTOR,
+   stopping short at the first sector already in use, so that a
+   file can grow its last run of sectors in place.  RESERVE is
+   as for free_map_allocate_near().
+   Returns the number of sectors allocated, which is 0 if SECTOR
+   itself is in use. */
+size_t
+free_map_allocate_at (block_sector_t sector, size_t cnt, size_t *reserve)
+{
+  size_t sector_cnt = bitmap_size (free_map);
+  size_t end;
+
+  if (sector >= sector_cnt)
+    return 0;
+  if (cnt > sector_cnt - sector)
+    cnt = sector_cnt - sector;
+
+  lock_acquire (&free_map_lock);
+  release_committed ();
+  if (cnt > unreserved (reserve))
+    cnt = unreserved (reserve);
+  if (cnt > 0 && index_valid)
+    cnt = index_allocate_at (sector, cnt);
+  else if (cnt > 0)
+    {
+      /* Stop at the first sector in use. */
+      end = bitmap_scan (free_map, sector, 1, true);
+      if (end == BITMAP_ERROR || end > sector + cnt)
+        end = sector + cnt;
+      cnt = end - sector;
+    }
+
+  if (cnt > 0)
+    {
+      set_sectors (sector, cnt, true);
+      draw_reserve (cnt, reserve);
+      next_fit = sector + cnt;
+    }
+  lock_release (&free_map_lock);
+
+  return cnt;
+}
+
+/* Returns the number of sectors that an allocation drawing on
+   RESERVE, which may be null, may take: those that are free,
+   not pending release, and not reserved by someone else.
+   FREE_MAP_LOCK must be held. */
+static size_t
+unreserved (const size_t *reserve)
+{
+  size_t avail = total_free - pending_cnt;
+  size_t others = reserved - (reserve != NULL ? *reserve : 0);
+
+  return avail > others ? avail - others : 0;
+}
+
+/* Charges CNT newly allocated sectors against *RESERVE, if
+   RESERVE is nonnull, as far as it goes.  FREE_MAP_LOCK must be
+   held. */
+static void
+draw_reserve (size_t cnt, size_t *reserve)
+{
+  if (reserve != NULL)
+    {
+      size_t n = cnt < *reserve ? cnt : *reserve;
+      *reserve -= n;
+      reserved -= n;
+    }
+}
+
+/* Sets aside CNT free sectors that other allocations may not
+   use, for a caller that will allocate them later by passing
+   the reservation to free_map_allocate_near() or
+   free_map_allocate_at().  Returns true if successful, false if
+   fewer than CNT unreserved sectors are free. */
+bool
+free_map_reserve (size_t cnt)
+{
+  bool success;
+
+  lock_acquire (&free_map_lock);
+  release_committed ();
+  success = unreserved (NULL) >= cnt;
+  if (success)
+    reserved += cnt;
+  lock_release (&free_map_lock);
+  return success;
+}
+
+/* Gives back CNT sectors of a reservation made with
+   free_map_reserve() that were not needed after all. */
+void
+free_map_unreserve (size_t cnt)
+{
+  lock_acquire (&free_map_lock);
+  ASSERT (cnt <= reserved);
+  reserved -= cnt;
+  lock_release (&free_map_lock);
+}
+
+/* Makes CNT sectors starting at SECTOR available for use, once
+   the transaction that frees them commits. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  struct pending_free *p = NULL;
+
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
-  bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  set_sectors (sector, cnt, false);
+  if (journal_enabled ())
+    {
+      uint32_t seq = journal_revoke (sector, cnt);
+
+      if (index_valid)
+        p = malloc (sizeof *p);
+      if (p != NULL)
+        {
+          p->start = sector;
+          p->cnt = cnt;
+          p->seq = seq;
+          list_push_back (&pending_frees, &p->elem);
+          pending_cnt += cnt;
+        }
+      else
+        {
+          /* Without the index, or memory to remember the run
+             with, the sectors could be allocated again right
+             away, so commit the transaction that frees them
+             now. */
+          journal_force ();
+        }
+    }
+  if (p == NULL && index_valid)
+    index_release (sector, cnt);
+  release_committed ();
+  lock_release (&free_map_lock);
+}
+
+/* Moves the pending frees whose transactions have committed into
+   the free extent index.  If the index has been abandoned, so
+   that allocation scans the bitmap, which already shows pending
+   frees as free, commits first so that all of them can go. */
+static void
+release_committed (void)
+{
+  while (!list_empty (&pending_frees))
+    {
+      struct pending_free *p = list_entry (list_front (&pending_frees),
+                                           struct pending_free, elem);
+
+      if (!journal_committed (p->seq))
+        {
+          if (index_valid)
+            break;
+          journal_force ();
+        }
+      list_pop_front (&pending_frees);
+      pending_cnt -= p->cnt;
+      if (index_valid)
+        index_release (p->start, p->cnt);
+      free (p);
+    }
 }
 
 /* Opens the free map file and reads it from disk. */
 void
-free_map_open (void) 
+free_map_open (void)
 {
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+  inode_set_metadata (file_get_inode (free_map_file));
+  index_build ();
 }
 
-/* Writes the free map to disk and closes the free map file. */
+/* Closes the free map file. */
 void
-free_map_close (void) 
+free_map_close (void)
 {
   file_close (free_map_file);
+  free_map_file = NULL;
 }
 
 /* Creates a new free map file on disk and writes the free map to
    it. */
 void
-free_map_create (void) 
+free_map_create (void)
 {
   /* Create inode. */
   if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
@@ -80,6 +438,313 @@ free_map_create (void)
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
+  inode_set_metadata (file_get_inode (free_map_file));
   if (!bitmap_write (free_map, free_map_file))
     PANIC ("can't write free map");
 }
+
+/* Free extent index. */
+
+/* Returns the size class for a run of CNT sectors. */
+static size_t
+size_class (size_t cnt)
+{
+  size_t class = 0;
+
+  ASSERT (cnt > 0);
+  while (cnt >>= 1)
+    class++;
+  return class;
+}
+
+/* Returns the first sector of free extent E. */
+static inline block_sector_t
+extent_start (const struct free_extent *e)
+{
+  return e->start_elem.key;
+}
+
+/* Returns the number of sectors in free extent E. */
+static inline size_t
+extent_length (const struct free_extent *e)
+{
+  return e->end_elem.key - e->start_elem.key;
+}
+
+/* Adds E, covering sectors START up to END, which must be in
+   the same group, to the index.  Returns true if successful.  If
+   a hash table cannot grow to hold E, frees E, abandons the
+   index, and returns false. */
+static bool
+extent_insert (struct free_extent *e, block_sector_t start,
+               block_sector_t end)
+{
+  struct group *g = &groups[start / GROUP_SECTORS];
+
+  ASSERT (start < end);
+  ASSERT ((end - 1) / GROUP_SECTORS == start / GROUP_SECTORS);
+
+  e->start_elem.key = start;
+  e->end_elem.key = end;
+  if (ohash_insert (&by_start, &e->start_elem) != NULL)
+    {
+      slab_free (&extent_cache, e);
+      index_abandon ();
+      return false;
+    }
+  if (ohash_insert (&by_end, &e->end_elem) != NULL)
+    {
+      ohash_delete (&by_start, start);
+      slab_free (&extent_cache, e);
+      index_abandon ();
+      return false;
+    }
+  list_push_front (&g->classes[size_class (end - start)], &e->class_elem);
+  return true;
+}
+
+/* Removes E from the index, without freeing it. */
+static void
+extent_remove (struct free_extent *e)
+{
+  ohash_delete (&by_start, e->start_elem.key);
+  ohash_delete (&by_end, e->end_elem.key);
+  list_remove (&e->class_elem);
+}
+
+/* Adds a free run from START up to END to the index, splitting
+   it at group boundaries.  If that fails for lack of memory,
+   abandons the index. */
+static void
+index_add (block_sector_t start, block_sector_t end)
+{
+  while (start < end)
+    {
+      struct free_extent *e = slab_alloc (&extent_cache);
+      block_sector_t piece_end = end < group_end (start) ? end : group_end (start);
+
+      if (e == NULL)
+        {
+          index_abandon ();
+          return;
+        }
+      if (!extent_insert (e, start, piece_end))
+        return;
+      start = piece_end;
+    }
+}
+
+/* Frees the index's extents and hash tables and stops using
+   it, so that allocation falls back to scanning the bitmap. */
+static void
+index_abandon (void)
+{
+  size_t g, i;
+
+  ASSERT (index_valid);
+
+  for (g = 0; g < group_cnt; g++)
+    for (i = 0; i < CLASS_CNT; i++)
+      while (!list_empty (&groups[g].classes[i]))
+        {
+          struct list_elem *elem = list_pop_front (&groups[g].classes[i]);
+          slab_free (&extent_cache,
+                     list_entry (elem, struct free_extent, class_elem));
+        }
+  ohash_destroy (&by_start, NULL);
+  ohash_destroy (&by_end, NULL);
+  index_valid = false;
+}
+
+/* Discards the index and rebuilds it, along with each group's
+   count of free sectors and the total, from the bitmap. */
+static void
+index_build (void)
+{
+  size_t g, i, start;
+
+  if (index_valid)
+    index_abandon ();
+
+  total_free = 0;
+  for (g = 0; g < group_cnt; g++)
+    {
+      struct group *group = &groups[g];
+      size_t first = g * GROUP_SECTORS;
+      size_t cnt = bitmap_size (free_map) - first;
+
+      if (cnt > GROUP_SECTORS)
+        cnt = GROUP_SECTORS;
+      group->free_cnt = bitmap_count (free_map, first, cnt, false);
+      total_free += group->free_cnt;
+      for (i = 0; i < CLASS_CNT; i++)
+        list_init (&group->classes[i]);
+    }
+
+  if (!ohash_init (&by_start, NULL))
+    return;
+  if (!ohash_init (&by_end, NULL))
+    {
+      ohash_destroy (&by_start, NULL);
+      return;
+    }
+  index_valid = true;
+
+  for (start = 0; index_valid; )
+    {
+      size_t end;
+
+      start = bitmap_scan (free_map, start, 1, false);
+      if (start == BITMAP_ERROR)
+        break;
+      end = bitmap_scan (free_map, start, 1, true);
+      if (end == BITMAP_ERROR)
+        end = bitmap_size (free_map);
+      index_add (start, end);
+      start = end;
+    }
+}
+
+/* Takes the first CNT sectors of free extent E, which must have
+   at least that many, and returns the first of them. */
+static block_sector_t
+extent_take (struct free_extent *e, size_t cnt)
+{
+  block_sector_t start = extent_start (e);
+  block_sector_t end = e->end_elem.key;
+
+  ASSERT (extent_length (e) >= cnt);
+
+  extent_remove (e);
+  if (start + cnt < end)
+    {
+      /* If this fails, the index is abandoned, but the caller
+         still gets its sectors from the bitmap. */
+      extent_insert (e, start + cnt, end);
+    }
+  else
+    slab_free (&extent_cache, e);
+  return start;
+}
+
+/* Finds a free extent of at least CNT sectors in group G,
+   takes CNT sectors from its start, and stores the first in
+   *SECTORP.  Returns false if there is no such extent. */
+static bool
+group_allocate (struct group *g, size_t cnt, block_sector_t *sectorp)
+{
+  struct list *classes = g->classes;
+  size_t class = size_class (cnt);
+  struct list_elem *elem;
+
+  /* Runs in CNT's own class may be too short. */
+  for (elem = list_begin (&classes[class]); elem != list_end (&classes[class]);
+       elem = list_next (elem))
+    {
+      struct free_extent *e = list_entry (elem, struct free_extent,
+                                          class_elem);
+      if (extent_length (e) >= cnt)
+        {
+          *sectorp = extent_take (e, cnt);
+          return true;
+        }
+    }
+
+  /* Any run in a larger class is long enough. */
+  for (class++; class < CLASS_CNT; class++)
+    if (!list_empty (&classes[class]))
+      {
+        elem = list_front (&classes[class]);
+        *sectorp = extent_take (list_entry (elem, struct free_extent,
+                                            class_elem), cnt);
+        return true;
+      }
+  return false;
+}
+
+/* Finds a free extent of at least CNT sectors in the index,
+   looking first in GOAL's group and then in the groups after and
+   before it in order of distance, takes CNT sectors from its
+   start, and stores the first in *SECTORP.  Returns false if
+   there is no such extent. */
+static bool
+index_allocate (size_t cnt, block_sector_t goal, block_sector_t *sectorp)
+{
+  size_t first = goal / GROUP_SECTORS;
+  size_t i;
+
+  for (i = 0; i < 2 * group_cnt; i++)
+    {
+      /* FIRST, FIRST + 1, FIRST - 1, FIRST + 2, ...  Groups off
+         either end of the disk wrap around to huge numbers. */
+      size_t g = i % 2 == 0 ? first + i / 2 : first - (i + 1) / 2;
+
+      if (g < group_cnt && groups[g].free_cnt >= cnt
+          && group_allocate (&groups[g], cnt, sectorp))
+        return true;
+    }
+  return false;
+}
+
+/* Takes up to CNT sectors from the free extent that starts at
+   SECTOR, if any.  Returns the number of sectors taken. */
+static size_t
+index_allocate_at (block_sector_t sector, size_t cnt)
+{
+  struct ohash_elem *elem = ohash_find (&by_start, sector);
+  struct free_extent *e;
+
+  if (elem == NULL)
+    return 0;
+  e = ohash_entry (elem, struct free_extent, start_elem);
+  if (cnt > extent_length (e))
+    cnt = extent_length (e);
+  extent_take (e, cnt);
+  return cnt;
+}
+
+/* Adds CNT sectors starting at SECTOR to the index, merging them
+   with the free extents just before and after in the same
+   group. */
+static void
+index_release (block_sector_t sector, size_t cnt)
+{
+  block_sector_t start = sector, end = sector + cnt;
+  struct ohash_elem *before, *after;
+  struct free_extent *e = NULL;
+
+  /* Release each group's part separately. */
+  if (end > group_end (start))
+    {
+      index_release (group_end (start), end - group_end (start));
+      if (!index_valid)
+        return;
+      end = group_end (start);
+    }
+
+  before = start % GROUP_SECTORS != 0 ? ohash_find (&by_end, start) : NULL;
+  after = end % GROUP_SECTORS != 0 ? ohash_find (&by_start, end) : NULL;
+
+  if (before != NULL)
+    {
+      e = ohash_entry (before, struct free_extent, end_elem);
+      start = extent_start (e);
+      extent_remove (e);
+    }
+  if (after != NULL)
+    {
+      struct free_extent *a = ohash_entry (after, struct free_extent,
+                                           start_elem);
+      end = a->end_elem.key;
+      extent_remove (a);
+      if (e == NULL)
+        e = a;
+      else
+        slab_free (&extent_cache, a);
+    }
+
+  if (e != NULL)
+    extent_insert (e, start, end);
+  else
+    index_add (start, end);
+}
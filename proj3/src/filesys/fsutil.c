@@ -1,5 +1,6 @@
 #include "filesys/fsutil.h"
 #include <debug.h>
+#include <round.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -66,19 +67,51 @@ fsutil_rm (char **argv)
     PANIC ("%s: delete failed\n", file_name);
 }
 
+/* Number of pages in the buffer that file data streams through
+   between the scratch device and the file system, and the number
+   of sectors that fit in it. */
+#define STREAM_PAGES 16
+#define STREAM_SECTORS (STREAM_PAGES * PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Reads CNT sectors starting at SECTOR from BLOCK into BUFFER. */
+static void
+read_run (struct block *block, block_sector_t sector, size_t cnt,
+          uint8_t *buffer)
+{
+  for (; cnt > 0; cnt--, sector++, buffer += BLOCK_SECTOR_SIZE)
+    block_read (block, sector, buffer);
+}
+
+/* Writes CNT sectors starting at SECTOR to BLOCK from BUFFER. */
+static void
+write_run (struct block *block, block_sector_t sector, size_t cnt,
+           const uint8_t *buffer)
+{
+  for (; cnt > 0; cnt--, sector++, buffer += BLOCK_SECTOR_SIZE)
+    block_write (block, sector, buffer);
+}
+
 /* Extracts a ustar-format tar archive from the scratch block
-   device into the Pintos file system. */
+   device into the Pintos file system.
+
+   Each file is created at its full size from its header, so that
+   its space is allocated all at once, and then its data streams
+   in runs of up to STREAM_SECTORS sectors, each written with a
+   single direct write that goes straight to disk, without
+   passing through, or flushing useful data out of, the file
+   system's caches. */
 void
 fsutil_extract (char **argv UNUSED) 
 {
   static block_sector_t sector = 0;
 
   struct block *src;
-  void *header, *data;
+  void *header;
+  uint8_t *data;
 
   /* Allocate buffers. */
   header = malloc (BLOCK_SECTOR_SIZE);
-  data = malloc (BLOCK_SECTOR_SIZE);
+  data = palloc_get_multiple (0, STREAM_PAGES);
   if (header == NULL || data == NULL)
     PANIC ("couldn't allocate buffers");
 
@@ -122,14 +155,21 @@ fsutil_extract (char **argv UNUSED)
           dst = filesys_open (file_name);
           if (dst == NULL)
             PANIC ("%s: open failed", file_name);
+          file_set_direct (dst, true);
 
           /* Do copy. */
           while (size > 0)
             {
-              int chunk_size = (size > BLOCK_SECTOR_SIZE
-                                ? BLOCK_SECTOR_SIZE
-                                : size);
-              block_read (src, sector++, data);
+              size_t sector_cnt = DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
+              int chunk_size;
+
+              if (sector_cnt > STREAM_SECTORS)
+                sector_cnt = STREAM_SECTORS;
+              chunk_size = sector_cnt * BLOCK_SECTOR_SIZE;
+              if (chunk_size > size)
+                chunk_size = size;
+              read_run (src, sector, sector_cnt, data);
+              sector += sector_cnt;
               if (file_write (dst, data, chunk_size) != chunk_size)
                 PANIC ("%s: write failed with %d bytes unwritten",
                        file_name, size);
@@ -150,12 +190,13 @@ fsutil_extract (char **argv UNUSED)
   block_write (src, 0, header);
   block_write (src, 1, header);
 
-  free (data);
+  palloc_free_multiple (data, STREAM_PAGES);
   free (header);
 }
 
 /* Copies file FILE_NAME from the file system to the scratch
-   device, in ustar format.
+   device, in ustar format.  The file is read with direct reads,
+   in runs of up to STREAM_SECTORS sectors.
 
    The first call to this function will write starting at the
    beginning of the scratch device.  Later calls advance across
@@ -176,7 +217,7 @@ fsutil_append (char **argv)
   printf ("Appending '%s' to ustar archive on scratch device...\n", file_name);
 
   /* Allocate buffer. */
-  buffer = malloc (BLOCK_SECTOR_SIZE);
+  buffer = palloc_get_multiple (0, STREAM_PAGES);
   if (buffer == NULL)
     PANIC ("couldn't allocate buffer");
 
@@ -184,6 +225,7 @@ fsutil_append (char **argv)
   src = filesys_open (file_name);
   if (src == NULL)
     PANIC ("%s: open failed", file_name);
+  file_set_direct (src, true);
   size = file_length (src);
 
   /* Open target block device. */
@@ -199,24 +241,32 @@ fsutil_append (char **argv)
   /* Do copy. */
   while (size > 0) 
     {
-      int chunk_size = size > BLOCK_SECTOR_SIZE ? BLOCK_SECTOR_SIZE : size;
-      if (sector >= block_size (dst))
+      size_t sector_cnt = DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
+      off_t chunk_size;
+
+      if (sector_cnt > STREAM_SECTORS)
+        sector_cnt = STREAM_SECTORS;
+      chunk_size = sector_cnt * BLOCK_SECTOR_SIZE;
+      if (chunk_size > size)
+        chunk_size = size;
+      if (sector_cnt > block_size (dst) - sector)
         PANIC ("%s: out of space on scratch device", file_name);
       if (file_read (src, buffer, chunk_size) != chunk_size)
         PANIC ("%s: read failed with %"PROTd" bytes unread", file_name, size);
-      memset (buffer + chunk_size, 0, BLOCK_SECTOR_SIZE - chunk_size);
-      block_write (dst, sector++, buffer);
+      memset (buffer + chunk_size, 0,
+              sector_cnt * BLOCK_SECTOR_SIZE - chunk_size);
+      write_run (dst, sector, sector_cnt, buffer);
+      sector += sector_cnt;
       size -= chunk_size;
     }
 
   /* Write ustar end-of-archive marker, which is two consecutive
      sectors full of zeros.  Don't advance our position past
      them, though, in case we have more files to append. */
-  memset (buffer, 0, BLOCK_SECTOR_SIZE);
-  block_write (dst, sector, buffer);
-  block_write (dst, sector, buffer + 1);
+  memset (buffer, 0, 2 * BLOCK_SECTOR_SIZE);
+  write_run (dst, sector, 2, buffer);
 
   /* Finish up. */
   file_close (src);
-  free (buffer);
+  palloc_free_multiple (buffer, STREAM_PAGES);
 }
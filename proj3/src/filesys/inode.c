@@ -1,23 +1,129 @@
 #include "filesys/inode.h"
-#include <list.h>
 #include <debug.h>
+#include <list.h>
+#include <ohash.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/pagecache.h"
+#endif
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* A file's data is stored as a sequence of extents, each a run
+   of consecutive sectors on disk, which together cover the
+   file's sectors in order.  The first DIRECT_CNT extents are
+   stored in the inode itself, the next EXTENTS_PER_BLOCK in an
+   indirect block, and the rest in extent blocks pointed to by a
+   doubly indirect block.
+
+   Newly allocated sectors are not zeroed on disk.  Instead, the
+   extents that cover them are marked "unwritten", and reads of
+   an unwritten sector return zeros without touching the disk.
+   Writing to unwritten sectors writes the data first and then
+   splits their extent so that the sectors written are covered by
+   a written extent, merging it with its written neighbors where
+   they are contiguous, so that a file written sequentially ends
+   up with as few extents as if it had been zeroed up front.  The
+   journal writes the data back before it commits the split (see
+   journal.c), so a crash cannot leave a written extent over
+   stale sectors.
+
+   A file may also have holes, ranges of sectors with no disk
+   space at all, which read as zeros too.  A hole is an unwritten
+   extent that starts at HOLE_SECTOR, which is never a data
+   sector.  Writing past the end of a file leaves a hole, and
+   sectors are allocated only as they are first written.
+
+   A file no bigger than INLINE_MAX bytes, which is most files,
+   is instead stored in the inode itself, in the space otherwise
+   used for the direct extents, so that reading it takes no disk
+   access beyond reading the inode.  Such a file moves to extents
+   once it grows past INLINE_MAX bytes.
+
+   Inodes and extent blocks are metadata, which the journal
+   commits before it goes to disk (see journal.c), and so is the
+   data of inodes marked with inode_set_metadata(), which are
+   the directories and the free map.
+
+   Data appended to a file is not given disk space right away.
+   Instead, it collects in a delay buffer of DELAY_MAX bytes
+   attached to the in-memory inode, with the file's extents
+   covering it with a hole, and sectors are allocated for all of
+   it at once when the buffer is flushed: when a write no longer
+   fits, when the file is last closed, or periodically by the
+   write-behind thread through inode_flush_delayed().  By then
+   the allocator knows how much space the data needs and can
+   place it in a single run.  Enough free space to do so is
+   reserved in the free map when the buffer is created, so a
+   write that the buffer accepts is never lost for want of space.
+   If the system crashes before the flush, the appended data
+   reads as zeros. */
+#define DIRECT_CNT 60
+#define EXTENTS_PER_BLOCK (BLOCK_SECTOR_SIZE / sizeof (struct extent))
+#define PTRS_PER_BLOCK (BLOCK_SECTOR_SIZE / sizeof (block_sector_t))
+#define MAX_EXTENTS (DIRECT_CNT + EXTENTS_PER_BLOCK                     \
+                     + PTRS_PER_BLOCK * EXTENTS_PER_BLOCK)
+
+/* Maximum size of a file stored in its inode. */
+#define INLINE_MAX (DIRECT_CNT * sizeof (struct extent))
+
+/* Delay buffers.  At most DELAY_CNT inodes have one at a time,
+   and each reserves DELAY_RESERVE sectors in the free map when
+   it is created: as many as it holds, plus the extent blocks
+   needed to record them even if free space is so fragmented that
+   each sector takes an extent of its own. */
+#define DELAY_PAGES 4
+#define DELAY_MAX (DELAY_PAGES * PGSIZE)
+#define DELAY_SECTORS (DELAY_MAX / BLOCK_SECTOR_SIZE)
+#define DELAY_RESERVE (DELAY_SECTORS                                    \
+                       + DIV_ROUND_UP (DELAY_SECTORS + 4, EXTENTS_PER_BLOCK) \
+                       + 2)
+#define DELAY_CNT 16
+
+/* Inode flags. */
+#define INODE_INLINE 0x1                /* Data is in inline_data. */
+#define INODE_DIR 0x2                   /* Is a directory. */
+
+/* Start of a hole extent.  This is the free map's inode, so it
+   is never part of a file's data. */
+#define HOLE_SECTOR FREE_MAP_SECTOR
+
+/* A run of LENGTH sectors starting at sector START. */
+struct extent
+  {
+    block_sector_t start;               /* First sector. */
+    uint32_t length : 31;               /* Number of sectors. */
+    uint32_t unwritten : 1;             /* Sectors read as zeros? */
+  };
+
 /* On-disk inode.
    Must be exactly BLOCK_SECTOR_SIZE bytes long. */
 struct inode_disk
   {
-    block_sector_t start;               /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    uint32_t extent_cnt;                /* Number of extents in use. */
+    uint32_t sector_cnt;                /* Sectors covered by extents. */
+    block_sector_t indirect;            /* Extent block, or 0. */
+    block_sector_t dbl_indirect;        /* Block of extent blocks, or 0. */
+    uint32_t flags;                     /* INODE_* flags. */
+    uint32_t unused;                    /* Not used. */
+    union
+      {
+        struct extent direct[DIRECT_CNT];   /* First extents... */
+        uint8_t inline_data[INLINE_MAX];    /* ...or INODE_INLINE data. */
+      };
   };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -28,40 +134,969 @@ bytes_to_sectors (off_t size)
   return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
 }
 
-/* In-memory inode. */
+/* In-memory inode.
+
+   RWLOCK protects REMOVED, DENY_WRITE_CNT, DATA, and the delay
+   buffer.  Reads and
+   writes within the file hold it for reading, so they proceed in
+   parallel, relying on the buffer cache to keep each sector
+   consistent; only changes to the inode itself, such as growing
+   the file, hold it for writing.  LOCK is not used by this module
+   at all, but by higher layers that need to make several inode
+   operations atomic; see inode_lock(). */
 struct inode 
   {
-    struct list_elem elem;              /* Element in inode list. */
+    struct ohash_elem elem;             /* Element in open_inodes, by sector. */
     block_sector_t sector;              /* Sector number of disk location. */
-    int open_cnt;                       /* Number of openers. */
+    int open_cnt;                       /* Number of openers (open_inodes_lock). */
+    bool closing;                       /* Being closed by last opener (ditto). */
+    struct rwlock rwlock;               /* Protects inode contents. */
+    struct lock lock;                   /* For inode_lock(). */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    bool metadata;                      /* Is the data metadata? */
+    off_t read_end;                     /* End of last read, for read-ahead. */
+    uint8_t *delay;                     /* Delay buffer, or null... */
+    off_t delay_start;                  /* ...holding data from here to EOF. */
+    size_t reserve;                     /* Its free map reservation. */
+    bool flushing;                      /* Allocating from RESERVE? */
+    struct list_elem delay_elem;        /* Element in delayed_inodes. */
+#ifdef VM
+    struct list pages;                  /* Page cache's pages (its lock). */
+#endif
+    struct lock hint_lock;              /* Protects the following. */
+    size_t hint_idx;                    /* Extent last found by lookup... */
+    size_t hint_pos;                    /* ...and its first file sector. */
     struct inode_disk data;             /* Inode content. */
   };
 
+/* Returns the free map reservation that allocations for INODE
+   may draw on: its delay buffer's while the buffer is being
+   flushed, otherwise none. */
+static inline size_t *
+inode_reserve (struct inode *inode)
+{
+  return inode->flushing ? &inode->reserve : NULL;
+}
+
+/* Returns the total size of the CNT buffers in vector IOV. */
+static off_t
+iov_size (const struct iovec *iov, size_t cnt)
+{
+  off_t size = 0;
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    size += iov[i].iov_len;
+  return size;
+}
+
+/* Copies SIZE bytes out of vector IOV, starting OFS bytes into
+   it, to DST. */
+static void
+iov_gather (void *dst_, const struct iovec *iov, size_t ofs, size_t size)
+{
+  uint8_t *dst = dst_;
+
+  for (; size > 0; iov++)
+    if (ofs >= iov->iov_len)
+      ofs -= iov->iov_len;
+    else
+      {
+        size_t n = iov->iov_len - ofs < size ? iov->iov_len - ofs : size;
+        memcpy (dst, (const uint8_t *) iov->iov_base + ofs, n);
+        dst += n;
+        size -= n;
+        ofs = 0;
+      }
+}
+
+/* Copies SIZE bytes from SRC into vector IOV, starting OFS bytes
+   into it. */
+static void
+iov_scatter (const struct iovec *iov, const void *src_, size_t ofs,
+             size_t size)
+{
+  const uint8_t *src = src_;
+
+  for (; size > 0; iov++)
+    if (ofs >= iov->iov_len)
+      ofs -= iov->iov_len;
+    else
+      {
+        size_t n = iov->iov_len - ofs < size ? iov->iov_len - ofs : size;
+        memcpy ((uint8_t *) iov->iov_base + ofs, src, n);
+        src += n;
+        size -= n;
+        ofs = 0;
+      }
+}
+
+/* Writes SIZE bytes from BUFFER into data sector SECTOR of
+   INODE, starting at byte offset OFS, as metadata if INODE's
+   data is metadata. */
+static void
+write_data (struct inode *inode, block_sector_t sector, const void *buffer,
+            int ofs, int size)
+{
+  if (inode->metadata)
+    cache_write_meta_at (sector, buffer, ofs, size);
+  else
+    cache_write_at (sector, buffer, ofs, size);
+}
+
+/* Finds where extent IDX of INODE is stored outside the inode,
+   storing the extent block's sector in *BLOCK and the extent's
+   index within it in *OFS.  If ALLOCATE is true, allocates any
+   missing extent blocks along the way.  Returns false if IDX is
+   a direct extent or if a needed block is missing and could not
+   be allocated. */
+static bool
+locate_extent (struct inode *inode, size_t idx, bool allocate,
+               block_sector_t *block, size_t *ofs)
+{
+  static const uint8_t zeros[BLOCK_SECTOR_SIZE];
+  block_sector_t *ptr;
+  block_sector_t ptr_sector = inode->sector;
+  int ptr_ofs;
+
+  ASSERT (idx >= DIRECT_CNT && idx < MAX_EXTENTS);
+  idx -= DIRECT_CNT;
+
+  if (idx < EXTENTS_PER_BLOCK)
+    {
+      /* In the indirect block. */
+      ptr = &inode->data.indirect;
+      ptr_ofs = -1;
+      *ofs = idx;
+    }
+  else
+    {
+      /* In an extent block listed in the doubly indirect block. */
+      block_sector_t l1;
+
+      idx -= EXTENTS_PER_BLOCK;
+      if (inode->data.dbl_indirect == 0)
+        {
+          if (!allocate
+              || !free_map_allocate_near (1, inode->sector,
+                                          &inode->data.dbl_indirect,
+                                          inode_reserve (inode)))
+            return false;
+          cache_write_meta (inode->data.dbl_indirect, zeros);
+        }
+      ptr_sector = inode->data.dbl_indirect;
+      ptr_ofs = idx / EXTENTS_PER_BLOCK;
+      cache_read_at (ptr_sector, &l1, ptr_ofs * sizeof l1, sizeof l1);
+      *block = l1;
+      *ofs = idx % EXTENTS_PER_BLOCK;
+      ptr = block;
+    }
+
+  if (*ptr == 0)
+    {
+      if (!allocate || !free_map_allocate_near (1, inode->sector, ptr,
+                                                inode_reserve (inode)))
+        return false;
+      cache_write_meta (*ptr, zeros);
+      if (ptr_ofs >= 0)
+        cache_write_meta_at (ptr_sector, ptr, ptr_ofs * sizeof *ptr,
+                             sizeof *ptr);
+    }
+  *block = *ptr;
+  return true;
+}
+
+/* Reads extent IDX of INODE into *E. */
+static void
+get_extent (struct inode *inode, size_t idx, struct extent *e)
+{
+  block_sector_t block;
+  size_t ofs;
+
+  ASSERT (idx < inode->data.extent_cnt);
+
+  if (idx < DIRECT_CNT)
+    *e = inode->data.direct[idx];
+  else if (locate_extent (inode, idx, false, &block, &ofs))
+    cache_read_at (block, e, ofs * sizeof *e, sizeof *e);
+  else
+    NOT_REACHED ();
+}
+
+/* Stores E as extent IDX of INODE, allocating extent blocks as
+   needed.  Changes to the inode itself are not written to disk.
+   Returns false if an extent block could not be allocated. */
+static bool
+put_extent (struct inode *inode, size_t idx, const struct extent *e)
+{
+  block_sector_t block;
+  size_t ofs;
+
+  if (idx < DIRECT_CNT)
+    inode->data.direct[idx] = *e;
+  else if (idx < MAX_EXTENTS && locate_extent (inode, idx, true, &block, &ofs))
+    cache_write_meta_at (block, e, ofs * sizeof *e, sizeof *e);
+  else
+    return false;
+  return true;
+}
+
+/* Finds the extent of INODE that contains file sector
+   SECTOR_IDX, which must be less than the inode's sector count,
+   and stores it in *E, its index in *IDXP, and the file sector
+   at which it begins in *POSP. */
+static void
+find_extent (struct inode *inode, size_t sector_idx, struct extent *e,
+             size_t *idxp, size_t *posp)
+{
+  size_t idx, idx_pos;
+
+  ASSERT (sector_idx < inode->data.sector_cnt);
+
+  /* Files are mostly accessed sequentially, so start from the
+     extent found last time when possible. */
+  lock_acquire (&inode->hint_lock);
+  if (sector_idx >= inode->hint_pos && inode->hint_idx < inode->data.extent_cnt)
+    {
+      idx = inode->hint_idx;
+      idx_pos = inode->hint_pos;
+    }
+  else
+    idx = idx_pos = 0;
+  lock_release (&inode->hint_lock);
+
+  for (; idx < inode->data.extent_cnt; idx++)
+    {
+      get_extent (inode, idx, e);
+      if (sector_idx < idx_pos + e->length)
+        {
+          lock_acquire (&inode->hint_lock);
+          inode->hint_idx = idx;
+          inode->hint_pos = idx_pos;
+          lock_release (&inode->hint_lock);
+          *idxp = idx;
+          *posp = idx_pos;
+          return;
+        }
+      idx_pos += e->length;
+    }
+  NOT_REACHED ();
+}
+
 /* Returns the block device sector that contains byte offset POS
-   within INODE.
+   within INODE, and sets *UNWRITTEN to true if that sector has
+   never been written and so must read as zeros.
    Returns -1 if INODE does not contain data for a byte at offset
    POS. */
 static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+byte_to_sector (struct inode *inode, off_t pos, bool *unwritten) 
 {
+  size_t sector_idx = pos / BLOCK_SECTOR_SIZE;
+  struct extent e;
+  size_t idx, idx_pos;
+
   ASSERT (inode != NULL);
-  if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
-  else
+  if (pos >= inode->data.length || sector_idx >= inode->data.sector_cnt)
     return -1;
+
+  find_extent (inode, sector_idx, &e, &idx, &idx_pos);
+  *unwritten = e.unwritten;
+  return e.start + (sector_idx - idx_pos);
+}
+
+/* Makes sure that INODE can take CNT more extents without
+   allocating an extent block.  Returns false if it cannot. */
+static bool
+make_room (struct inode *inode, size_t cnt)
+{
+  struct inode_disk *d = &inode->data;
+  block_sector_t block;
+  size_t ofs;
+  size_t i;
+
+  if (d->extent_cnt + cnt > MAX_EXTENTS)
+    return false;
+  for (i = d->extent_cnt; i < d->extent_cnt + cnt; i++)
+    if (i >= DIRECT_CNT && !locate_extent (inode, i, true, &block, &ofs))
+      return false;
+  return true;
+}
+
+/* Replaces the OLD_CNT extents of INODE starting at index LO by
+   the NEW_CNT extents in NEW, moving the extents that follow
+   them.  Returns false if an extent block could not be
+   allocated, in which case INODE is unchanged. */
+static bool
+splice_extents (struct inode *inode, size_t lo, size_t old_cnt,
+                const struct extent new[], size_t new_cnt)
+{
+  struct inode_disk *d = &inode->data;
+  struct extent e;
+  size_t i;
+
+  ASSERT (lo + old_cnt <= d->extent_cnt);
+
+  if (new_cnt > old_cnt)
+    {
+      /* Make sure there is room at the end before moving
+         anything, so that moving cannot fail halfway. */
+      if (!make_room (inode, new_cnt - old_cnt))
+        return false;
+
+      for (i = d->extent_cnt; i-- > lo + old_cnt; )
+        {
+          get_extent (inode, i, &e);
+          put_extent (inode, i + (new_cnt - old_cnt), &e);
+        }
+    }
+  else if (new_cnt < old_cnt)
+    for (i = lo + old_cnt; i < d->extent_cnt; i++)
+      {
+        get_extent (inode, i, &e);
+        put_extent (inode, i - (old_cnt - new_cnt), &e);
+      }
+
+  d->extent_cnt = d->extent_cnt - old_cnt + new_cnt;
+  for (i = 0; i < new_cnt; i++)
+    put_extent (inode, lo + i, &new[i]);
+
+  /* Extents have moved, so the lookup hint may be stale. */
+  lock_acquire (&inode->hint_lock);
+  inode->hint_idx = inode->hint_pos = 0;
+  lock_release (&inode->hint_lock);
+  return true;
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Marks file sectors START through END - 1 of INODE, which must
+   all lie within unwritten extent IDX, which begins at file
+   sector POS, as written, or if WRITTEN is false, as allocated
+   but still unwritten.  If the extent is a hole, the sectors
+   must already have been allocated, consecutively from
+   MID_START; otherwise MID_START is ignored.  Returns false if an
+   extent block could not be allocated. */
+static bool
+convert_extent (struct inode *inode, size_t idx, size_t pos,
+                size_t start, size_t end, block_sector_t mid_start,
+                bool written)
+{
+  struct inode_disk *d = &inode->data;
+  struct extent e, new[3];
+  size_t lo = idx, hi = idx + 1;
+  size_t new_cnt = 0;
+  size_t a = start - pos, b = end - pos;
+  bool hole;
+  struct extent mid;
+
+  get_extent (inode, idx, &e);
+  ASSERT (e.unwritten && a < b && b <= e.length);
+  hole = e.start == HOLE_SECTOR;
+
+  mid.start = hole ? mid_start : e.start + a;
+  mid.length = b - a;
+  mid.unwritten = !written;
+
+  /* Unwritten sectors before the converted ones, or else an
+     extent just before, of the same kind, that MID can be merged
+     into. */
+  if (a > 0)
+    {
+      new[new_cnt].start = e.start;
+      new[new_cnt].length = a;
+      new[new_cnt].unwritten = true;
+      new_cnt++;
+    }
+  else if (idx > 0)
+    {
+      struct extent prev;
+
+      get_extent (inode, idx - 1, &prev);
+      if (prev.unwritten == mid.unwritten && prev.start != HOLE_SECTOR
+          && prev.start + prev.length == mid.start)
+        {
+          mid.start = prev.start;
+          mid.length += prev.length;
+          lo--;
+        }
+    }
+
+  /* Likewise after. */
+  if (b < e.length)
+    {
+      new[new_cnt++] = mid;
+      new[new_cnt].start = hole ? HOLE_SECTOR : e.start + b;
+      new[new_cnt].length = e.length - b;
+      new[new_cnt].unwritten = true;
+      new_cnt++;
+    }
+  else
+    {
+      if (idx + 1 < d->extent_cnt)
+        {
+          struct extent next;
+
+          get_extent (inode, idx + 1, &next);
+          if (next.unwritten == mid.unwritten && next.start != HOLE_SECTOR
+              && mid.start + mid.length == next.start)
+            {
+              mid.length += next.length;
+              hi++;
+            }
+        }
+      new[new_cnt++] = mid;
+    }
+
+  return splice_extents (inode, lo, hi - lo, new, new_cnt);
+}
+
+/* Allocates up to CNT consecutive sectors to fill part of hole
+   extent IDX of INODE, which begins at file sector POS, starting
+   at file sector SECTOR_IDX.  When the part begins the hole,
+   prefers the sectors just past the previous extent, so that
+   filling holes in order keeps the file contiguous, and
+   otherwise sectors near the previous extent or, failing that,
+   the inode.  Stores the first sector allocated in *SECTORP and
+   returns the number of sectors allocated, which is 0 if the
+   disk is full. */
+static size_t
+allocate_hole (struct inode *inode, size_t idx, size_t pos,
+               size_t sector_idx, size_t cnt, block_sector_t *sectorp)
+{
+  block_sector_t goal = inode->sector;
+
+  if (idx > 0)
+    {
+      struct extent prev;
+
+      get_extent (inode, idx - 1, &prev);
+      if (prev.start != HOLE_SECTOR)
+        {
+          goal = prev.start + prev.length;
+          if (sector_idx == pos)
+            {
+              size_t got = free_map_allocate_at (goal, cnt,
+                                                 inode_reserve (inode));
+              if (got > 0)
+                {
+                  *sectorp = goal;
+                  return got;
+                }
+            }
+        }
+    }
+
+  for (; cnt > 0; cnt /= 2)
+    if (free_map_allocate_near (cnt, goal, sectorp, inode_reserve (inode)))
+      break;
+  return cnt;
+}
+
+/* Gets the sectors of INODE that hold bytes OFFSET through
+   OFFSET + SIZE - 1, which must lie within the file, ready to be
+   written in place: allocates space for any that are in holes,
+   leaving it unwritten, and zeros any unwritten sectors that are
+   only partly covered, since the rest of them must still read as
+   zeros.  Also makes sure that finish_written() will not need to
+   allocate anything.  Writes INODE to disk if it changes.
+   Returns the number of bytes, starting at OFFSET, that are
+   ready to be written, which is less than SIZE only if the disk
+   is full. */
+static off_t
+prepare_written (struct inode *inode, off_t offset, off_t size)
+{
+  static const uint8_t zeros[BLOCK_SECTOR_SIZE];
+  size_t first = offset / BLOCK_SECTOR_SIZE;
+  size_t last = (offset + size - 1) / BLOCK_SECTOR_SIZE;
+  size_t sector_idx = first;
+  bool changed = false;
+  bool unwritten = false;
+
+  if (size <= 0)
+    return 0;
+
+  while (sector_idx <= last)
+    {
+      struct extent e;
+      size_t idx, pos, end;
+
+      find_extent (inode, sector_idx, &e, &idx, &pos);
+      end = pos + e.length;
+      if (end > last + 1)
+        end = last + 1;
+
+      if (e.unwritten)
+        {
+          block_sector_t first_sector = e.start + (sector_idx - pos);
+
+          if (e.start == HOLE_SECTOR)
+            {
+              size_t cnt = allocate_hole (inode, idx, pos, sector_idx,
+                                          end - sector_idx, &first_sector);
+              if (cnt == 0)
+                break;
+              end = sector_idx + cnt;
+              if (!convert_extent (inode, idx, pos, sector_idx, end,
+                                   first_sector, false))
+                {
+                  free_map_release (first_sector, cnt);
+                  break;
+                }
+              changed = true;
+            }
+          unwritten = true;
+
+          if (sector_idx == first && offset % BLOCK_SECTOR_SIZE != 0)
+            write_data (inode, first_sector, zeros, 0, BLOCK_SECTOR_SIZE);
+          if (end == last + 1 && (offset + size) % BLOCK_SECTOR_SIZE != 0
+              && (last != first || offset % BLOCK_SECTOR_SIZE == 0))
+            write_data (inode, first_sector + (last - sector_idx), zeros,
+                        0, BLOCK_SECTOR_SIZE);
+        }
+      sector_idx = end;
+    }
+
+  /* Marking a range written splits at most the extents at its two
+     ends. */
+  if (unwritten && !make_room (inode, 2))
+    sector_idx = first;
+
+  if (changed)
+    cache_write_meta (inode->sector, &inode->data);
+  if (sector_idx > last)
+    return size;
+  else if ((off_t) sector_idx * BLOCK_SECTOR_SIZE > offset)
+    return (off_t) sector_idx * BLOCK_SECTOR_SIZE - offset;
+  else
+    return 0;
+}
+
+/* Marks the sectors of INODE that hold bytes OFFSET through
+   OFFSET + SIZE - 1, which prepare_written() got ready and
+   which have since been written, as written.  Unless the data is
+   metadata, first asks the journal to write the sectors back
+   before it commits the change, so that after a crash each of
+   them reads as zeros or as what was written to it, never as
+   what it held before it was allocated to INODE.  Writes INODE
+   to disk if it changes. */
+static void
+finish_written (struct inode *inode, off_t offset, off_t size)
+{
+  size_t sector_idx = offset / BLOCK_SECTOR_SIZE;
+  size_t last;
+  bool changed = false;
+
+  if (size <= 0)
+    return;
+
+  last = (offset + size - 1) / BLOCK_SECTOR_SIZE;
+  while (sector_idx <= last)
+    {
+      struct extent e;
+      size_t idx, pos, end;
+
+      find_extent (inode, sector_idx, &e, &idx, &pos);
+      end = pos + e.length;
+      if (end > last + 1)
+        end = last + 1;
+
+      if (e.unwritten)
+        {
+          block_sector_t first_sector = e.start + (sector_idx - pos);
+          bool success;
+
+          ASSERT (e.start != HOLE_SECTOR);
+          if (!inode->metadata)
+            journal_order (first_sector, end - sector_idx);
+          success = convert_extent (inode, idx, pos, sector_idx, end,
+                                    first_sector, true);
+          ASSERT (success);
+          changed = true;
+        }
+      sector_idx = end;
+    }
+
+  if (changed)
+    cache_write_meta (inode->sector, &inode->data);
+}
+
+/* Returns true if any of the sectors of INODE that hold bytes
+   OFFSET through OFFSET + SIZE - 1, which must lie within the
+   file, is unwritten. */
+static bool
+range_unwritten (struct inode *inode, off_t offset, off_t size)
+{
+  size_t sector_idx = offset / BLOCK_SECTOR_SIZE;
+  size_t last = (offset + size - 1) / BLOCK_SECTOR_SIZE;
+
+  if (size <= 0)
+    return false;
+
+  while (sector_idx <= last)
+    {
+      struct extent e;
+      size_t idx, pos;
+
+      find_extent (inode, sector_idx, &e, &idx, &pos);
+      if (e.unwritten)
+        return true;
+      sector_idx = pos + e.length;
+    }
+  return false;
+}
+
+/* Extends INODE's extents to cover at least SECTORS sectors,
+   which are unwritten and so read as zeros, and writes INODE to
+   disk.  New sectors are taken from just past the last extent
+   when they are free, so that growing files stay contiguous, and
+   otherwise from near the inode.
+   Returns false if disk space ran out, in which case INODE may
+   still have grown partway. */
+static bool
+inode_grow (struct inode *inode, size_t sectors)
+{
+  struct inode_disk *d = &inode->data;
+  bool success = true;
+
+  while (d->sector_cnt < sectors)
+    {
+      size_t need = sectors - d->sector_cnt;
+      struct extent e;
+      block_sector_t start = inode->sector;
+      size_t cnt;
+
+      /* Try to continue the last extent. */
+      cnt = 0;
+      if (d->extent_cnt > 0)
+        {
+          get_extent (inode, d->extent_cnt - 1, &e);
+          if (e.start != HOLE_SECTOR)
+            {
+              start = e.start + e.length;
+              cnt = free_map_allocate_at (start, need, inode_reserve (inode));
+            }
+          if (cnt > 0 && e.unwritten)
+            {
+              e.length += cnt;
+              put_extent (inode, d->extent_cnt - 1, &e);
+              d->sector_cnt += cnt;
+              continue;
+            }
+        }
+
+      /* Otherwise find space as near there, or to the inode, as
+         free space allows. */
+      if (cnt == 0)
+        {
+          for (cnt = need; cnt > 0; cnt /= 2)
+            if (free_map_allocate_near (cnt, start, &start,
+                                        inode_reserve (inode)))
+              break;
+          if (cnt == 0)
+            {
+              success = false;
+              break;
+            }
+        }
+
+      /* Add a new unwritten extent. */
+      e.start = start;
+      e.length = cnt;
+      e.unwritten = true;
+      if (!put_extent (inode, d->extent_cnt, &e))
+        {
+          free_map_release (start, cnt);
+          success = false;
+          break;
+        }
+      d->extent_cnt++;
+      d->sector_cnt += cnt;
+    }
+
+  cache_write_meta (inode->sector, d);
+  return success;
+}
+
+/* Extends INODE's extents with a hole, which takes no disk
+   space, to cover at least SECTORS sectors.  Returns false if an
+   extent block could not be allocated. */
+static bool
+inode_extend_hole (struct inode *inode, size_t sectors)
+{
+  struct inode_disk *d = &inode->data;
+  struct extent e;
+
+  if (d->sector_cnt >= sectors)
+    return true;
+
+  /* Grow a hole at the end of the file in place. */
+  if (d->extent_cnt > 0)
+    {
+      get_extent (inode, d->extent_cnt - 1, &e);
+      if (e.start == HOLE_SECTOR)
+        {
+          e.length += sectors - d->sector_cnt;
+          put_extent (inode, d->extent_cnt - 1, &e);
+          d->sector_cnt = sectors;
+          return true;
+        }
+    }
+
+  e.start = HOLE_SECTOR;
+  e.length = sectors - d->sector_cnt;
+  e.unwritten = true;
+  if (!put_extent (inode, d->extent_cnt, &e))
+    return false;
+  d->extent_cnt++;
+  d->sector_cnt = sectors;
+  return true;
+}
+
+/* Moves the data of INODE, which must be stored inline, into a
+   data sector, and writes INODE to disk.  Returns false if the
+   disk is full, in which case INODE is unchanged. */
+static bool
+inode_uninline (struct inode *inode)
+{
+  struct inode_disk *d = &inode->data;
+  uint8_t data[INLINE_MAX];
+  off_t length = d->length;
+  bool unwritten;
+
+  ASSERT (d->flags & INODE_INLINE);
+
+  memcpy (data, d->inline_data, length);
+  memset (d->inline_data, 0, sizeof d->inline_data);
+  d->flags &= ~INODE_INLINE;
+  if (length > 0)
+    {
+      if (!inode_extend_hole (inode, 1)
+          || prepare_written (inode, 0, length) == 0)
+        {
+          /* The hole, if any, holds no disk space. */
+          d->extent_cnt = d->sector_cnt = 0;
+          d->flags |= INODE_INLINE;
+          memcpy (d->inline_data, data, length);
+          return false;
+        }
+      write_data (inode, byte_to_sector (inode, 0, &unwritten), data, 0,
+                  length);
+      finish_written (inode, 0, length);
+    }
+  cache_write_meta (inode->sector, d);
+  return true;
+}
+
+/* Releases all of INODE's data sectors and extent blocks. */
+static void
+inode_deallocate (struct inode *inode)
+{
+  struct inode_disk *d = &inode->data;
+  size_t idx;
+
+  for (idx = 0; idx < d->extent_cnt; idx++)
+    {
+      struct extent e;
+      get_extent (inode, idx, &e);
+      if (e.start != HOLE_SECTOR)
+        free_map_release (e.start, e.length);
+    }
+
+  if (d->indirect != 0)
+    free_map_release (d->indirect, 1);
+  if (d->dbl_indirect != 0)
+    {
+      block_sector_t ptrs[PTRS_PER_BLOCK];
+
+      cache_read (d->dbl_indirect, ptrs);
+      for (idx = 0; idx < PTRS_PER_BLOCK; idx++)
+        if (ptrs[idx] != 0)
+          free_map_release (ptrs[idx], 1);
+      free_map_release (d->dbl_indirect, 1);
+    }
+
+  d->extent_cnt = d->sector_cnt = 0;
+  d->indirect = d->dbl_indirect = 0;
+  inode->hint_idx = inode->hint_pos = 0;
+}
+
+/* Open inodes, keyed by sector, so that opening a single inode
+   twice returns the same `struct inode'.  The lock also protects
+   each open inode's open_cnt and closing.  The condition is
+   signaled when a closing inode leaves the table. */
+static struct ohash open_inodes;
+static struct lock open_inodes_lock;
+static struct condition inode_closed;
+
+/* In-memory inodes. */
+static struct slab_cache inode_cache;
+
+/* Inodes with delay buffers.  The lock protects the list and
+   the counts.  It may be acquired before open_inodes_lock or
+   free_map_lock, but not while holding either. */
+static struct list delayed_inodes;
+static struct lock delay_lock;
+static size_t delay_cnt;                /* Number of delay buffers. */
+
+/* Gives INODE, whose data ends at or before byte offset START,
+   which must be sector-aligned, or in the same sector, a delay
+   buffer for data from START on, filled with the data already
+   there.  INODE's lock must be held for writing.  Returns false
+   if too many delay buffers are in use, if there is too little
+   free space to reserve for another one or too few extents left
+   in INODE to record its data, or if memory is short. */
+static bool
+delay_create (struct inode *inode, off_t start)
+{
+  off_t length = inode->data.length;
+  uint8_t *delay = NULL;
+
+  ASSERT (inode->delay == NULL);
+  ASSERT (start % BLOCK_SECTOR_SIZE == 0);
+
+  if (inode->data.extent_cnt + DELAY_SECTORS + 4 > MAX_EXTENTS)
+    return false;
+
+  lock_acquire (&delay_lock);
+  if (delay_cnt < DELAY_CNT && free_map_reserve (DELAY_RESERVE))
+    {
+      delay = palloc_get_multiple (PAL_ZERO, DELAY_PAGES);
+      if (delay == NULL)
+        free_map_unreserve (DELAY_RESERVE);
+    }
+  if (delay != NULL)
+    {
+      delay_cnt++;
+      list_push_back (&delayed_inodes, &inode->delay_elem);
+    }
+  lock_release (&delay_lock);
+  if (delay == NULL)
+    return false;
+
+  if (start < length)
+    {
+      bool unwritten;
+      block_sector_t sector = byte_to_sector (inode, start, &unwritten);
+      if (!unwritten)
+        cache_read_at (sector, delay, 0, length - start);
+    }
+  inode->delay = delay;
+  inode->delay_start = start;
+  inode->reserve = DELAY_RESERVE;
+  return true;
+}
+
+/* Frees INODE's delay buffer, discarding its contents, and
+   whatever is left of its reservation. */
+static void
+delay_release (struct inode *inode)
+{
+  lock_acquire (&delay_lock);
+  list_remove (&inode->delay_elem);
+  delay_cnt--;
+  lock_release (&delay_lock);
+
+  free_map_unreserve (inode->reserve);
+  inode->reserve = 0;
+
+  palloc_free_multiple (inode->delay, DELAY_PAGES);
+  inode->delay = NULL;
+}
+
+/* Allocates sectors for the data in INODE's delay buffer, if it
+   has one, all at once, from the space reserved for it, writes
+   the data to them, and frees the buffer.  INODE's lock must be
+   held for writing, or INODE must be closing. */
+static void
+delay_flush (struct inode *inode)
+{
+  off_t start = inode->delay_start;
+  off_t size, ofs;
+
+  if (inode->delay == NULL)
+    return;
+
+  /* Sectors past the end of file are zero in the buffer, so
+     whole sectors can be written. */
+  inode->flushing = true;
+  size = prepare_written (inode, start, inode->data.length - start);
+  inode->flushing = false;
+  ASSERT (size == inode->data.length - start);
+  for (ofs = 0; ofs < size; ofs += BLOCK_SECTOR_SIZE)
+    {
+      bool unwritten;
+      block_sector_t sector = byte_to_sector (inode, start + ofs, &unwritten);
+      write_data (inode, sector, inode->delay + ofs, 0, BLOCK_SECTOR_SIZE);
+    }
+  finish_written (inode, start, size);
+  delay_release (inode);
+}
+
+/* Tries to write the SIZE bytes in vector IOV into INODE,
+   starting at OFFSET, by copying them into its delay buffer, first giving it
+   one if this write appends to the file.  Flushes the delay
+   buffer if the write overlaps it or extends the file but does
+   not fit in it.  INODE's lock must be held for writing.
+   Returns true if successful, false if the write must go to disk
+   instead. */
+static bool
+delay_write (struct inode *inode, const struct iovec *iov, off_t size,
+             off_t offset)
+{
+  off_t length = inode->data.length;
+
+  if (inode->delay != NULL)
+    {
+      off_t start = inode->delay_start;
+
+      if (offset >= start && offset + size <= start + DELAY_MAX)
+        goto copy;
+      if (offset + size <= start)
+        return false;
+      delay_flush (inode);
+    }
+
+  /* Only appends start a delay buffer. */
+  if (inode->metadata || offset < length
+      || offset % BLOCK_SECTOR_SIZE + size > DELAY_MAX
+      || !delay_create (inode, ROUND_DOWN (offset, BLOCK_SECTOR_SIZE)))
+    return false;
+
+ copy:
+  if (offset + size > length)
+    {
+      if (!inode_extend_hole (inode, bytes_to_sectors (offset + size)))
+        {
+          delay_flush (inode);
+          return false;
+        }
+      inode->data.length = offset + size;
+      cache_write_meta (inode->sector, &inode->data);
+    }
+  iov_gather (inode->delay + (offset - inode->delay_start), iov, 0, size);
+  return true;
+}
+
+/* Initializes the locks in in-memory inode INODE_. */
+static void
+inode_ctor (void *inode_)
+{
+  struct inode *inode = inode_;
+  rwlock_init (&inode->rwlock);
+  lock_init (&inode->lock);
+  lock_init (&inode->hint_lock);
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  if (!ohash_init (&open_inodes, NULL))
+    PANIC ("inode registry initialization failed");
+  lock_init (&open_inodes_lock);
+  cond_init (&inode_closed);
+  list_init (&delayed_inodes);
+  lock_init (&delay_lock);
+  slab_cache_init (&inode_cache, "inode", sizeof (struct inode), inode_ctor);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -73,7 +1108,8 @@ bool
 inode_create (block_sector_t sector, off_t length)
 {
   struct inode_disk *disk_inode = NULL;
-  bool success = false;
+  struct inode *inode;
+  bool success;
 
   ASSERT (length >= 0);
 
@@ -82,62 +1118,116 @@ inode_create (block_sector_t sector, off_t length)
   ASSERT (sizeof *disk_inode == BLOCK_SECTOR_SIZE);
 
   disk_inode = calloc (1, sizeof *disk_inode);
-  if (disk_inode != NULL)
+  if (disk_inode == NULL)
+    return false;
+  disk_inode->magic = INODE_MAGIC;
+  if (length <= (off_t) INLINE_MAX)
     {
-      size_t sectors = bytes_to_sectors (length);
+      /* Small enough to store in the inode. */
+      disk_inode->flags = INODE_INLINE;
       disk_inode->length = length;
-      disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
-        {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
-          success = true; 
-        } 
-      free (disk_inode);
     }
+  journal_begin ();
+  cache_write_meta (sector, disk_inode);
+  free (disk_inode);
+  if (length <= (off_t) INLINE_MAX)
+    {
+      journal_end ();
+      return true;
+    }
+
+  /* Allocate the data through an open inode. */
+  inode = inode_open (sector);
+  if (inode == NULL)
+    {
+      journal_end ();
+      return false;
+    }
+  success = inode_grow (inode, bytes_to_sectors (length));
+  if (success)
+    inode->data.length = length;
+  else
+    inode_deallocate (inode);
+  cache_write_meta (inode->sector, &inode->data);
+  inode_close (inode);
+  journal_end ();
   return success;
 }
 
 /* Reads an inode from SECTOR
    and returns a `struct inode' that contains it.
-   Returns a null pointer if memory allocation fails. */
+   Returns a null pointer if memory allocation fails, including
+   for growing the table of open inodes. */
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
+  struct ohash_elem *e;
   struct inode *inode;
 
-  /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+  /* Check whether this inode is already open.  If its last
+     opener is still closing it, its data on disk may not be up
+     to date yet, so wait until it is gone. */
+  lock_acquire (&open_inodes_lock);
+  while ((e = ohash_find (&open_inodes, sector)) != NULL)
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
+      inode = ohash_entry (e, struct inode, elem);
+      if (!inode->closing)
         {
-          inode_reopen (inode);
-          return inode; 
+          inode->open_cnt++;
+          lock_release (&open_inodes_lock);
+          return inode;
         }
+      cond_wait (&inode_closed, &open_inodes_lock);
     }
+  lock_release (&open_inodes_lock);
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = slab_alloc (&inode_cache);
   if (inode == NULL)
     return NULL;
 
-  /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
+  /* Initialize, reading the inode without holding the lock. */
+  inode->elem.key = sector;
   inode->sector = sector;
   inode->open_cnt = 1;
+  inode->closing = false;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  inode->metadata = false;
+  inode->read_end = 0;
+  inode->hint_idx = inode->hint_pos = 0;
+  inode->delay = NULL;
+  inode->reserve = 0;
+  inode->flushing = false;
+#ifdef VM
+  list_init (&inode->pages);
+#endif
+  cache_read (inode->sector, &inode->data);
+
+  /* Register the inode, unless someone else opened it meanwhile,
+     in which case use theirs.  If theirs is already closing,
+     what we read may be stale, so start over once it is gone. */
+  lock_acquire (&open_inodes_lock);
+  e = ohash_insert (&open_inodes, &inode->elem);
+  if (e == &inode->elem)
+    {
+      /* No room in the table. */
+      slab_free (&inode_cache, inode);
+      inode = NULL;
+    }
+  else if (e != NULL)
+    {
+      slab_free (&inode_cache, inode);
+      inode = ohash_entry (e, struct inode, elem);
+      if (inode->closing)
+        {
+          cond_wait (&inode_closed, &open_inodes_lock);
+          lock_release (&open_inodes_lock);
+          return inode_open (sector);
+        }
+      inode->open_cnt++;
+    }
+  lock_release (&open_inodes_lock);
   return inode;
 }
 
@@ -146,7 +1236,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -163,112 +1257,428 @@ inode_get_inumber (const struct inode *inode)
 void
 inode_close (struct inode *inode) 
 {
+  bool last;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
-  /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  /* Release resources if this was the last opener.  INODE stays
+     in open_inodes, marked as closing, until they are released,
+     so that inode_open() waits for its data to reach the disk
+     rather than reading it too soon. */
+  lock_acquire (&open_inodes_lock);
+  last = --inode->open_cnt == 0;
+  if (last)
+    inode->closing = true;
+  lock_release (&open_inodes_lock);
+
+  if (last)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
- 
-      /* Deallocate blocks if removed. */
+#ifdef VM
+      pagecache_drop (inode);
+#endif
+
+      /* Deallocate blocks if removed, otherwise write out delayed
+         data. */
       if (inode->removed) 
         {
+          journal_begin ();
+          if (inode->delay != NULL)
+            delay_release (inode);
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
+          inode_deallocate (inode);
+          journal_end ();
+        }
+      else if (inode->delay != NULL)
+        {
+          journal_begin ();
+          delay_flush (inode);
+          journal_end ();
         }
 
-      free (inode); 
+      lock_acquire (&open_inodes_lock);
+      ohash_delete (&open_inodes, inode->sector);
+      cond_broadcast (&inode_closed, &open_inodes_lock);
+      lock_release (&open_inodes_lock);
+
+      slab_free (&inode_cache, inode); 
     }
 }
 
+/* Writes out the delay buffers of all open inodes. */
+void
+inode_flush_delayed (void)
+{
+  for (;;)
+    {
+      struct inode *inode = NULL;
+      struct list_elem *e;
+
+      /* Find an inode with a delay buffer that is not being
+         closed for the last time, whose closer flushes it, and
+         open it so that it stays open while it is flushed. */
+      lock_acquire (&delay_lock);
+      lock_acquire (&open_inodes_lock);
+      for (e = list_begin (&delayed_inodes); e != list_end (&delayed_inodes);
+           e = list_next (e))
+        {
+          struct inode *i = list_entry (e, struct inode, delay_elem);
+          if (i->open_cnt > 0)
+            {
+              inode = i;
+              inode->open_cnt++;
+              break;
+            }
+        }
+      lock_release (&open_inodes_lock);
+      lock_release (&delay_lock);
+      if (inode == NULL)
+        break;
+
+      journal_begin ();
+      rwlock_acquire_write (&inode->rwlock);
+      delay_flush (inode);
+      rwlock_release_write (&inode->rwlock);
+      journal_end ();
+      inode_close (inode);
+    }
+}
+
+/* Writes INODE's data to disk, first allocating sectors for data
+   held back in its delay buffer, in order of sector number, and
+   then makes its metadata durable by committing the journal, or,
+   without a journal, by writing back every dirty sector. */
+void
+inode_sync (struct inode *inode)
+{
+  size_t i;
+
+  journal_begin ();
+  rwlock_acquire_write (&inode->rwlock);
+  delay_flush (inode);
+  rwlock_release_write (&inode->rwlock);
+  journal_end ();
+
+  rwlock_acquire_read (&inode->rwlock);
+  if (!(inode->data.flags & INODE_INLINE))
+    for (i = 0; i < inode->data.extent_cnt; i++)
+      {
+        struct extent e;
+
+        get_extent (inode, i, &e);
+        if (e.start != HOLE_SECTOR && !e.unwritten)
+          cache_flush_range (e.start, e.length);
+      }
+  rwlock_release_read (&inode->rwlock);
+
+  if (journal_enabled ())
+    journal_force ();
+  else
+    cache_flush ();
+}
+
 /* Marks INODE to be deleted when it is closed by the last caller who
    has it open. */
 void
 inode_remove (struct inode *inode) 
 {
   ASSERT (inode != NULL);
+  rwlock_acquire_write (&inode->rwlock);
   inode->removed = true;
+  rwlock_release_write (&inode->rwlock);
 }
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
-   than SIZE if an error occurs or end of file is reached. */
+   than SIZE if an error occurs or end of file is reached.
+   If this read continues where the last one left off, starts
+   reading the following sector into the cache in the
+   background. */
 off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
+inode_read_at (struct inode *inode, void *buffer, off_t size, off_t offset) 
+{
+  struct iovec iov;
+
+  iov.iov_base = buffer;
+  iov.iov_len = size;
+  return inode_readv (inode, &iov, 1, offset);
+}
+
+/* Reads like inode_readv(), directly as in inode_readv_direct()
+   if DIRECT is true. */
+static off_t
+read_vector (struct inode *inode, const struct iovec *iov, size_t iov_cnt,
+             off_t offset, bool direct)
 {
-  uint8_t *buffer = buffer_;
+  off_t size = iov_size (iov, iov_cnt);
+  size_t iov_ofs = 0;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
+  bool sequential = offset == inode->read_end;
+
+  rwlock_acquire_read (&inode->rwlock);
+
+  if (inode->data.flags & INODE_INLINE)
+    {
+      /* Copy out of the inode, or out of its cached page for a
+         direct read, as below. */
+      if (offset < inode->data.length)
+        {
+          const uint8_t *src = inode->data.inline_data;
+#ifdef VM
+          uint8_t *page = direct ? pagecache_pin_valid (inode, 0) : NULL;
+          if (page != NULL)
+            src = page;
+#endif
+          bytes_read = inode->data.length - offset;
+          if (bytes_read > size)
+            bytes_read = size;
+          iov_scatter (iov, src + offset, 0, bytes_read);
+          offset += bytes_read;
+#ifdef VM
+          if (page != NULL)
+            pagecache_unpin (inode, 0);
+#endif
+        }
+      size = 0;
+    }
 
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      bool unwritten;
+      block_sector_t sector_idx = byte_to_sector (inode, offset, &unwritten);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
+      uint8_t *dst;
+#ifdef VM
+      int page_ofs;
+      uint8_t *page;
+#endif
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
       off_t inode_left = inode_length (inode) - offset;
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
       int min_left = inode_left < sector_left ? inode_left : sector_left;
 
-      /* Number of bytes to actually copy out of this sector. */
+      /* Number of bytes to actually copy out of this sector, no
+         more than fit in the current buffer. */
       int chunk_size = size < min_left ? size : min_left;
       if (chunk_size <= 0)
         break;
-
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
+      while (iov_ofs == iov->iov_len)
         {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
+          iov++;
+          iov_ofs = 0;
         }
-      else 
+      if ((size_t) chunk_size > iov->iov_len - iov_ofs)
+        chunk_size = iov->iov_len - iov_ofs;
+      dst = (uint8_t *) iov->iov_base + iov_ofs;
+
+#ifdef VM
+      /* A direct read bypasses the page cache, but a cached page
+         may hold changes made through a mapping that have not
+         reached the file yet, so take those bytes from it. */
+      page_ofs = offset % PGSIZE;
+      page = direct ? pagecache_pin_valid (inode, offset - page_ofs) : NULL;
+      if (page != NULL)
         {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
+          memcpy (dst, page + page_ofs, chunk_size);
+          pagecache_unpin (inode, offset - page_ofs);
         }
+      else
+#endif
+      if (inode->delay != NULL && offset >= inode->delay_start)
+        memcpy (dst, inode->delay + (offset - inode->delay_start),
+                chunk_size);
+      else if (unwritten)
+        memset (dst, 0, chunk_size);
+      else if (direct && chunk_size == BLOCK_SECTOR_SIZE && !inode->metadata)
+        cache_read_direct (sector_idx, dst);
+      else
+        cache_read_at (sector_idx, dst, sector_ofs, chunk_size);
       
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
+      iov_ofs += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
+  inode->read_end = offset;
+
+  if (sequential && !direct && bytes_read > 0
+      && offset < inode_length (inode)
+      && !(inode->data.flags & INODE_INLINE))
+    {
+      bool unwritten;
+      block_sector_t next = byte_to_sector (inode, offset, &unwritten);
+      if (!unwritten)
+        cache_readahead (next);
+    }
+  rwlock_release_read (&inode->rwlock);
 
   return bytes_read;
 }
 
+/* Reads from INODE, starting at position OFFSET, into the
+   IOV_CNT buffers in IOV in turn, filling each before going on
+   to the next.  Returns the number of bytes actually read, which
+   may be less than the buffers' total size if an error occurs or
+   end of file is reached.  Otherwise like inode_read_at(), but
+   as a single operation on INODE. */
+off_t
+inode_readv (struct inode *inode, const struct iovec *iov, size_t iov_cnt,
+             off_t offset)
+{
+  return read_vector (inode, iov, iov_cnt, offset, false);
+}
+
+/* Like inode_readv(), but reads each whole sector that lands on
+   a whole sector of a buffer straight from disk into the buffer,
+   bypassing the buffer cache, and does not read ahead.  Reads of
+   sector-aligned, sector-multiple buffers at sector-aligned
+   offsets thus never copy data through the cache.  Bytes of a
+   page that the page cache holds come from there instead, since
+   a process may have changed it through a mapping. */
+off_t
+inode_readv_direct (struct inode *inode, const struct iovec *iov,
+                    size_t iov_cnt, off_t offset)
+{
+  return read_vector (inode, iov, iov_cnt, offset, true);
+}
+
+#ifdef VM
+/* Copies the SIZE bytes just written to INODE at OFFSET, from
+   the buffers in IOV, into the pages of that range that the page
+   cache holds, so that they match the file.  INODE's lock must
+   be held. */
+static void
+update_pages (struct inode *inode, const struct iovec *iov, off_t offset,
+              off_t size)
+{
+  off_t done = 0;
+
+  while (done < size)
+    {
+      off_t pos = offset + done;
+      int page_ofs = pos % PGSIZE;
+      off_t chunk = PGSIZE - page_ofs < size - done
+                    ? PGSIZE - page_ofs : size - done;
+      uint8_t *page = pagecache_pin (inode, pos - page_ofs);
+
+      if (page != NULL)
+        {
+          iov_gather (page + page_ofs, iov, done, chunk);
+          pagecache_unpin (inode, pos - page_ofs);
+        }
+      done += chunk;
+    }
+}
+#endif
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
-   Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   Writing past end of file extends INODE, leaving a hole in any
+   gap, which reads as zeros.  Returns the number of bytes
+   actually written, which may be less than SIZE if the disk
+   fills up. */
 off_t
-inode_write_at (struct inode *inode, const void *buffer_, off_t size,
+inode_write_at (struct inode *inode, const void *buffer, off_t size,
                 off_t offset) 
 {
-  const uint8_t *buffer = buffer_;
+  struct iovec iov;
+
+  iov.iov_base = (void *) buffer;
+  iov.iov_len = size;
+  return inode_writev (inode, &iov, 1, offset);
+}
+
+/* Writes like inode_writev(), directly as in
+   inode_writev_direct() if DIRECT is true.  If FROM_PAGE is
+   true, the data comes from the page cache's own page of the
+   range, which is thus left alone. */
+static off_t
+write_vector (struct inode *inode, const struct iovec *iov, size_t iov_cnt,
+              off_t offset, bool direct, bool from_page)
+{
+  off_t size = iov_size (iov, iov_cnt);
+  size_t iov_ofs = 0;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
+  bool exclusive = offset + size > inode_length (inode);
+#ifdef VM
+  const struct iovec *start_iov = iov;
+  off_t start = offset;
+#endif
+
+  journal_begin ();
+
+  /* Extending the file, writing to unwritten sectors, or writing
+     data stored in the inode or in its delay buffer changes the
+     inode, which takes exclusive access.  Otherwise the data can
+     be written in place. */
+  if (exclusive)
+    rwlock_acquire_write (&inode->rwlock);
+  else
+    {
+      rwlock_acquire_read (&inode->rwlock);
+      if (offset + size > inode_length (inode)
+          || (inode->data.flags & INODE_INLINE)
+          || (inode->delay != NULL && offset + size > inode->delay_start)
+          || range_unwritten (inode, offset, size))
+        {
+          rwlock_release_read (&inode->rwlock);
+          rwlock_acquire_write (&inode->rwlock);
+          exclusive = true;
+        }
+    }
 
   if (inode->deny_write_cnt)
-    return 0;
+    goto done;
+
+  if ((inode->data.flags & INODE_INLINE) && size > 0)
+    {
+      if (offset + size <= (off_t) INLINE_MAX)
+        {
+          /* Store in the inode.  Bytes past the end of file are
+             always zero, so there is no gap to fill. */
+          iov_gather (inode->data.inline_data + offset, iov, 0, size);
+          if (offset + size > inode->data.length)
+            inode->data.length = offset + size;
+          cache_write_meta (inode->sector, &inode->data);
+          bytes_written = size;
+          goto done;
+        }
+      if (!inode_uninline (inode))
+        goto done;
+    }
+
+  if (exclusive && size > 0 && direct)
+    delay_flush (inode);
+  else if (exclusive && size > 0 && delay_write (inode, iov, size, offset))
+    {
+      bytes_written = size;
+      goto done;
+    }
+
+  if (exclusive && size > 0)
+    {
+      /* Cover the range to be written with extents, then make
+         sure that all of its sectors are allocated, and then make
+         what fits visible.  The sectors still read as zeros until
+         they are marked written below. */
+      if (!inode_extend_hole (inode, bytes_to_sectors (offset + size)))
+        goto done;
+      size = prepare_written (inode, offset, size);
+      if (offset + size > inode->data.length)
+        {
+          inode->data.length = offset + size;
+          cache_write_meta (inode->sector, &inode->data);
+        }
+    }
 
   while (size > 0) 
     {
       /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      bool unwritten;
+      block_sector_t sector_idx = byte_to_sector (inode, offset, &unwritten);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -276,54 +1686,432 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
       int min_left = inode_left < sector_left ? inode_left : sector_left;
 
-      /* Number of bytes to actually write into this sector. */
+      /* Number of bytes to actually write into this sector, no
+         more than are left in the current buffer. */
       int chunk_size = size < min_left ? size : min_left;
       if (chunk_size <= 0)
         break;
-
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
+      while (iov_ofs == iov->iov_len)
         {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
+          iov++;
+          iov_ofs = 0;
         }
-      else 
-        {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
+      if ((size_t) chunk_size > iov->iov_len - iov_ofs)
+        chunk_size = iov->iov_len - iov_ofs;
 
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
-        }
+      ASSERT (!unwritten || exclusive);
+      if (direct && chunk_size == BLOCK_SECTOR_SIZE && !inode->metadata)
+        cache_write_direct (sector_idx, (uint8_t *) iov->iov_base + iov_ofs);
+      else
+        write_data (inode, sector_idx, (uint8_t *) iov->iov_base + iov_ofs,
+                    sector_ofs, chunk_size);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
+      iov_ofs += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
+  if (exclusive)
+    finish_written (inode, offset - bytes_written, bytes_written);
 
+ done:
+#ifdef VM
+  if (!from_page)
+    update_pages (inode, start_iov, start, bytes_written);
+#endif
+  if (exclusive)
+    rwlock_release_write (&inode->rwlock);
+  else
+    rwlock_release_read (&inode->rwlock);
+  journal_end ();
   return bytes_written;
 }
 
+/* Writes the IOV_CNT buffers in IOV, in turn, into INODE,
+   starting at OFFSET.  Returns the number of bytes actually
+   written, which may be less than the buffers' total size if the
+   disk fills up.  Otherwise like inode_write_at(), but as a
+   single operation on INODE, so that the whole range is
+   allocated at once. */
+off_t
+inode_writev (struct inode *inode, const struct iovec *iov, size_t iov_cnt,
+              off_t offset)
+{
+  return write_vector (inode, iov, iov_cnt, offset, false, false);
+}
+
+/* Like inode_writev(), but writes each whole sector that comes
+   from a whole sector of a buffer straight from the buffer to
+   disk, bypassing the buffer cache and the delay buffer, so that
+   those sectors are on disk when it returns.  (Metadata recording
+   any allocation is committed by the journal later, as usual.) */
+off_t
+inode_writev_direct (struct inode *inode, const struct iovec *iov,
+                     size_t iov_cnt, off_t offset)
+{
+  return write_vector (inode, iov, iov_cnt, offset, true, false);
+}
+
+#ifdef VM
+/* Writes SIZE bytes of PAGE, the page cache's page of INODE at
+   OFFSET, back to INODE, as inode_write_at() would, but without
+   copying them into the page they came from. */
+off_t
+inode_write_page (struct inode *inode, const void *page, off_t size,
+                  off_t offset)
+{
+  struct iovec iov;
+
+  iov.iov_base = (void *) page;
+  iov.iov_len = size;
+  return write_vector (inode, &iov, 1, offset, false, true);
+}
+
+/* Returns INODE's list of pages in the page cache, which belongs
+   to the page cache and is protected by its lock. */
+struct list *
+inode_pages (struct inode *inode)
+{
+  return &inode->pages;
+}
+#endif
+
+/* Returns the bytes of SRC from byte offset OFS through the end
+   of their sector, if they are in memory: stored in the inode,
+   held in its delay buffer, or read as zeros because they are
+   unwritten.  Otherwise returns a null pointer and stores the
+   sector that holds them in *SECTOR.  SRC's lock must be held. */
+static const uint8_t *
+locate_bytes (struct inode *src, off_t ofs, block_sector_t *sector)
+{
+  static const uint8_t zeros[BLOCK_SECTOR_SIZE];
+  bool unwritten;
+
+  if (src->data.flags & INODE_INLINE)
+    return src->data.inline_data + ofs;
+  if (src->delay != NULL && ofs >= src->delay_start)
+    return src->delay + (ofs - src->delay_start);
+  *sector = byte_to_sector (src, ofs, &unwritten);
+  return unwritten ? zeros + ofs % BLOCK_SECTOR_SIZE : NULL;
+}
+
+/* Most bytes that inode_copy() copies with its inodes locked. */
+#define COPY_MAX (128 * BLOCK_SECTOR_SIZE)
+
+/* Copies up to SIZE bytes from SRC, starting at SRC_OFS, to DST,
+   starting at DST_OFS, through a kernel buffer, for the copies
+   that copy_range() cannot do: within a single inode, and into
+   metadata, which must be journaled.  Returns the number of bytes
+   copied. */
+static off_t
+copy_buffered (struct inode *dst, off_t dst_ofs, struct inode *src,
+               off_t src_ofs, off_t size)
+{
+  uint8_t *buffer = palloc_get_page (0);
+  off_t copied = 0;
+
+  if (buffer == NULL)
+    return 0;
+  while (copied < size)
+    {
+      off_t chunk = size - copied < PGSIZE ? size - copied : PGSIZE;
+#ifdef VM
+      struct iovec iov = { buffer, chunk };
+      off_t n = pagecache_readv (src, &iov, 1, src_ofs + copied);
+#else
+      off_t n = inode_read_at (src, buffer, chunk, src_ofs + copied);
+#endif
+
+      n = inode_write_at (dst, buffer, n, dst_ofs + copied);
+      copied += n;
+      if (n < chunk)
+        break;
+    }
+  palloc_free_page (buffer);
+  return copied;
+}
+
+/* Copies up to SIZE bytes from SRC, starting at SRC_OFS, to DST,
+   starting at DST_OFS, as a single operation on each, for
+   inode_copy().  DST and SRC must differ. */
+static off_t
+copy_range (struct inode *dst, off_t dst_ofs, struct inode *src,
+            off_t src_ofs, off_t size)
+{
+  struct inode_disk *d = &dst->data;
+  off_t copied = 0;
+  bool in_inode;
+
+  /* Lock the inodes in order of sector number, so that copies in
+     opposite directions cannot deadlock. */
+  journal_begin ();
+  if (src->sector < dst->sector)
+    rwlock_acquire_read (&src->rwlock);
+  rwlock_acquire_write (&dst->rwlock);
+  if (src->sector > dst->sector)
+    rwlock_acquire_read (&src->rwlock);
+
+  if (dst->deny_write_cnt || src_ofs >= src->data.length)
+    goto done;
+  if (size > src->data.length - src_ofs)
+    size = src->data.length - src_ofs;
+
+  /* Prepare the destination as inode_writev() would. */
+  delay_flush (dst);
+  if ((d->flags & INODE_INLINE) && dst_ofs + size > (off_t) INLINE_MAX
+      && !inode_uninline (dst))
+    goto done;
+  in_inode = (d->flags & INODE_INLINE) != 0;
+  if (!in_inode)
+    {
+      if (!inode_extend_hole (dst, bytes_to_sectors (dst_ofs + size)))
+        goto done;
+      size = prepare_written (dst, dst_ofs, size);
+    }
+  if (dst_ofs + size > d->length)
+    d->length = dst_ofs + size;
+
+  /* Copy a piece at a time, no piece crossing a sector boundary
+     in either inode, from memory or straight from one cache
+     buffer to another.  With a page cache, a piece of SRC that it
+     holds comes from there instead, since a process may have
+     changed it through a mapping, and a cached page of DST gets
+     the piece too, so that it still matches. */
+  while (copied < size)
+    {
+      int d_ofs = dst_ofs % BLOCK_SECTOR_SIZE;
+      int s_ofs = src_ofs % BLOCK_SECTOR_SIZE;
+      int chunk = BLOCK_SECTOR_SIZE - (d_ofs > s_ofs ? d_ofs : s_ofs);
+      block_sector_t src_sector;
+      const uint8_t *p;
+#ifdef VM
+      off_t src_page = src_ofs - src_ofs % PGSIZE;
+      off_t dst_page = dst_ofs - dst_ofs % PGSIZE;
+      uint8_t *spage, *dpage;
+#endif
+
+      if (chunk > size - copied)
+        chunk = size - copied;
+#ifdef VM
+      spage = pagecache_pin (src, src_page);
+      if (spage != NULL)
+        p = spage + (src_ofs - src_page);
+      else
+#endif
+      p = locate_bytes (src, src_ofs, &src_sector);
+      if (in_inode)
+        {
+          if (p != NULL)
+            memcpy (d->inline_data + dst_ofs, p, chunk);
+          else
+            cache_read_at (src_sector, d->inline_data + dst_ofs, s_ofs,
+                           chunk);
+        }
+      else
+        {
+          bool unwritten;
+          block_sector_t dst_sector = byte_to_sector (dst, dst_ofs,
+                                                      &unwritten);
+
+          ASSERT (dst_sector != HOLE_SECTOR);
+          if (p != NULL)
+            cache_write_at (dst_sector, p, d_ofs, chunk);
+          else
+            cache_copy_at (dst_sector, d_ofs, src_sector, s_ofs, chunk);
+        }
+
+#ifdef VM
+      dpage = pagecache_pin (dst, dst_page);
+      if (dpage != NULL)
+        {
+          if (p != NULL)
+            memcpy (dpage + (dst_ofs - dst_page), p, chunk);
+          else
+            cache_read_at (src_sector, dpage + (dst_ofs - dst_page), s_ofs,
+                           chunk);
+          pagecache_unpin (dst, dst_page);
+        }
+      if (spage != NULL)
+        pagecache_unpin (src, src_page);
+#endif
+
+      src_ofs += chunk;
+      dst_ofs += chunk;
+      copied += chunk;
+    }
+
+  if (!in_inode)
+    finish_written (dst, dst_ofs - copied, copied);
+  cache_write_meta (dst->sector, d);
+
+ done:
+  rwlock_release_read (&src->rwlock);
+  rwlock_release_write (&dst->rwlock);
+  journal_end ();
+  return copied;
+}
+
+/* Copies up to SIZE bytes from SRC, starting at SRC_OFS, to DST,
+   starting at DST_OFS, as inode_read_at() and inode_write_at()
+   would, but without passing the data through a caller's buffer:
+   each piece goes straight from one cache buffer to the other,
+   or from memory if SRC has it there.  Large copies are done
+   COPY_MAX bytes at a time.  Returns the number of bytes
+   actually copied, which may be less than SIZE if end of SRC is
+   reached or the disk fills up.  Copies nothing if DST and SRC
+   are the same inode and the ranges overlap. */
+off_t
+inode_copy (struct inode *dst, off_t dst_ofs, struct inode *src,
+            off_t src_ofs, off_t size)
+{
+  off_t copied = 0;
+
+  if (dst == src && dst_ofs < src_ofs + size && src_ofs < dst_ofs + size)
+    return 0;
+
+  while (copied < size)
+    {
+      off_t chunk = size - copied < COPY_MAX ? size - copied : COPY_MAX;
+      off_t n;
+
+      if (dst == src || dst->metadata)
+        n = copy_buffered (dst, dst_ofs + copied, src, src_ofs + copied,
+                           chunk);
+      else
+        n = copy_range (dst, dst_ofs + copied, src, src_ofs + copied,
+                        chunk);
+      copied += n;
+      if (n < chunk)
+        break;
+    }
+  return copied;
+}
+
+/* Allocates disk space for bytes OFFSET through OFFSET + SIZE - 1
+   of INODE, extending the file if they lie past its end, so that
+   writing them later takes no allocation and cannot run out of
+   space.  The space is allocated in runs as long as the free map
+   allows, and any of it not yet written reads as zeros.  Returns
+   true if successful, false if writes to INODE are denied or the
+   disk fills up, in which case part of the range may have been
+   allocated anyway. */
+bool
+inode_allocate (struct inode *inode, off_t offset, off_t size)
+{
+  struct inode_disk *d = &inode->data;
+  size_t sector_idx, end;
+  bool success = false;
+
+  ASSERT (offset >= 0 && size >= 0);
+
+  if (size == 0)
+    return true;
+  journal_begin ();
+  rwlock_acquire_write (&inode->rwlock);
+
+  if (inode->deny_write_cnt)
+    goto done;
+  delay_flush (inode);
+  if (d->flags & INODE_INLINE)
+    {
+      if (offset + size <= (off_t) INLINE_MAX)
+        {
+          /* The inode already has room. */
+          if (offset + size > d->length)
+            {
+              d->length = offset + size;
+              cache_write_meta (inode->sector, d);
+            }
+          success = true;
+          goto done;
+        }
+      if (!inode_uninline (inode))
+        goto done;
+    }
+
+  /* Fill the holes in the part of the range that extents already
+     cover. */
+  end = bytes_to_sectors (offset + size);
+  sector_idx = offset / BLOCK_SECTOR_SIZE;
+  while (sector_idx < end && sector_idx < d->sector_cnt)
+    {
+      struct extent e;
+      size_t idx, pos, run_end;
+
+      find_extent (inode, sector_idx, &e, &idx, &pos);
+      run_end = pos + e.length < end ? pos + e.length : end;
+      if (e.start == HOLE_SECTOR)
+        {
+          block_sector_t first;
+          size_t cnt = allocate_hole (inode, idx, pos, sector_idx,
+                                      run_end - sector_idx, &first);
+          if (cnt == 0)
+            goto write;
+          if (!convert_extent (inode, idx, pos, sector_idx,
+                               sector_idx + cnt, first, false))
+            {
+              free_map_release (first, cnt);
+              goto write;
+            }
+          run_end = sector_idx + cnt;
+        }
+      sector_idx = run_end;
+    }
+
+  /* Cover the rest with new space, leaving any gap before the
+     range a hole. */
+  if (!inode_extend_hole (inode, offset / BLOCK_SECTOR_SIZE)
+      || !inode_grow (inode, end))
+    goto write;
+  if (offset + size > d->length)
+    d->length = offset + size;
+  success = true;
+
+ write:
+  cache_write_meta (inode->sector, d);
+ done:
+  rwlock_release_write (&inode->rwlock);
+  journal_end ();
+  return success;
+}
+
+/* Marks INODE's data as file system metadata, whose changes the
+   journal commits like those of INODE itself. */
+void
+inode_set_metadata (struct inode *inode)
+{
+  inode->metadata = true;
+}
+
+/* Records on disk that INODE is a directory. */
+void
+inode_set_dir (struct inode *inode)
+{
+  journal_begin ();
+  rwlock_acquire_write (&inode->rwlock);
+  inode->data.flags |= INODE_DIR;
+  cache_write_meta (inode->sector, &inode->data);
+  rwlock_release_write (&inode->rwlock);
+  journal_end ();
+}
+
+/* Returns true if INODE is a directory. */
+bool
+inode_is_dir (const struct inode *inode)
+{
+  return (inode->data.flags & INODE_DIR) != 0;
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
 inode_deny_write (struct inode *inode) 
 {
+  rwlock_acquire_write (&inode->rwlock);
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  rwlock_release_write (&inode->rwlock);
 }
 
 /* Re-enables writes to INODE.
@@ -332,14 +2120,36 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode) 
 {
+  rwlock_acquire_write (&inode->rwlock);
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  rwlock_release_write (&inode->rwlock);
 }
 
-/* Returns the length, in bytes, of INODE's data. */
+/* Returns the length, in bytes, of INODE's data.  Without the
+   inode's lock held, the length may change at any time, but it
+   never shrinks. */
 off_t
 inode_length (const struct inode *inode)
 {
   return inode->data.length;
 }
+
+/* Acquires INODE's general-purpose lock, which callers can use
+   to make a sequence of operations on INODE atomic, as the
+   directory code does for lookups and updates.  This lock is
+   independent of the locking inode_read_at() and
+   inode_write_at() do internally. */
+void
+inode_lock (struct inode *inode)
+{
+  lock_acquire (&inode->lock);
+}
+
+/* Releases INODE's general-purpose lock. */
+void
+inode_unlock (struct inode *inode)
+{
+  lock_release (&inode->lock);
+}
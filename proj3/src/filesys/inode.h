@@ -1,11 +1,13 @@
 #ifndef FILESYS_INODE_H
 #define FILESYS_INODE_H
 
+#include <iovec.h>
 #include <stdbool.h>
 #include "filesys/off_t.h"
 #include "devices/block.h"
 
 struct bitmap;
+struct list;
 
 void inode_init (void);
 bool inode_create (block_sector_t, off_t);
@@ -13,11 +15,34 @@ struct inode *inode_open (block_sector_t);
 struct inode *inode_reopen (struct inode *);
 block_sector_t inode_get_inumber (const struct inode *);
 void inode_close (struct inode *);
+void inode_flush_delayed (void);
+void inode_sync (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_readv (struct inode *, const struct iovec *, size_t iov_cnt,
+                   off_t offset);
+off_t inode_writev (struct inode *, const struct iovec *, size_t iov_cnt,
+                    off_t offset);
+off_t inode_readv_direct (struct inode *, const struct iovec *,
+                          size_t iov_cnt, off_t offset);
+off_t inode_writev_direct (struct inode *, const struct iovec *,
+                           size_t iov_cnt, off_t offset);
+#ifdef VM
+off_t inode_write_page (struct inode *, const void *page, off_t size,
+                        off_t offset);
+struct list *inode_pages (struct inode *);
+#endif
+off_t inode_copy (struct inode *dst, off_t dst_ofs, struct inode *src,
+                  off_t src_ofs, off_t size);
+bool inode_allocate (struct inode *, off_t offset, off_t size);
+void inode_set_metadata (struct inode *);
+void inode_set_dir (struct inode *);
+bool inode_is_dir (const struct inode *);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+void inode_lock (struct inode *);
+void inode_unlock (struct inode *);
 
 #endif /* filesys/inode.h */
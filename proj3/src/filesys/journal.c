@@ -0,0 +1,576 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/cache.h"
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Metadata journal.
+
+   Metadata, that is, inodes, extent blocks, directories, and the
+   free map, is not written straight to its home sectors.
+   Instead, the buffer cache marks each metadata buffer that
+   changes as "logged" and keeps it in memory, and from time to
+   time the journal commits all the logged buffers together as
+   one transaction: it writes a descriptor listing their sectors,
+   then copies of the buffers, then a commit block, one after
+   another into the log, a run of sectors set aside when the file
+   system is formatted.  Only then may the buffers go to their
+   home sectors, in any order.  After a crash, journal_open()
+   copies every committed transaction still in the log to its
+   home sectors again, so the metadata on disk reflects every
+   committed transaction and no others, however far the home
+   writes got.
+
+   File system operations are bracketed by journal_begin() and
+   journal_end(), and a commit asked for by journal_commit() is
+   put off until no operation is in progress, so that each
+   transaction holds whole operations and many operations share
+   one sequential log write ("group commit").  If logged buffers
+   pile up until the cache needs them back, journal_force()
+   commits in the middle of operations instead.  The file system
+   writes new objects before the metadata that points to them, so
+   at worst that leaks the sectors of an operation that did not
+   finish.
+
+   Checkpointing empties the log.  Once every committed buffer
+   has reached its home sector, which the write-behind thread
+   brings about by flushing the cache, the log can start over.
+   For that to hold whenever the cache has been flushed, the
+   cache writes a buffer changed by a committed transaction home
+   before it logs another change to it.
+
+   A freed sector may have an older image in the log, which
+   replay must not write over whatever the sector holds next.  So
+   freeing sectors "revokes" them in the running transaction,
+   which cancels their images in earlier transactions, and the
+   free map does not reuse them until that transaction commits.
+   The running transaction's own images of sectors it revoked are
+   simply left out of the log.
+
+   Only metadata is journaled.  File data is written in place,
+   but in "ordered" mode: once data has been written to sectors
+   that were unwritten, the inode code tells us with
+   journal_order(), and the running transaction, which holds the
+   change that marks them written, writes them back before it
+   commits.  So after a crash, a sector that a file's inode says
+   is written holds what was written to it, never what it held
+   before it was allocated, perhaps as part of a deleted file.
+
+   Committing never calls into the free map, so it is safe to
+   commit with the free map locked. */
+
+/* Number of sectors in the log. */
+#define LOG_SECTORS 256
+
+/* Identifies the journal header, descriptors, and commit blocks. */
+#define JOURNAL_MAGIC 0x4a524e4c
+#define DESCRIPTOR_MAGIC 0x44455343
+#define COMMIT_MAGIC 0x434d4954
+
+/* Slots in a descriptor, for sectors and revoked runs. */
+#define DESC_SLOTS 124
+
+/* Maximum number of runs revoked by one transaction.  This
+   leaves room for as many logged sectors as the buffer cache
+   has buffers. */
+#define REVOKE_MAX 30
+
+/* Maximum number of runs of data sectors that one transaction
+   keeps track of for ordered mode.  Past that, the runs are
+   written back early. */
+#define ORDER_MAX 32
+
+/* Journal header, in JOURNAL_SECTOR.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_header
+  {
+    unsigned magic;                     /* JOURNAL_MAGIC. */
+    block_sector_t start;               /* First sector of the log. */
+    uint32_t size;                      /* Number of sectors in the log. */
+    uint32_t seq;                       /* First transaction in the log. */
+    uint8_t unused[496];                /* Not used. */
+  };
+
+/* First sector of a transaction in the log, followed by an image
+   of each of its SECTOR_CNT sectors and then a commit block.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct descriptor
+  {
+    unsigned magic;                     /* DESCRIPTOR_MAGIC. */
+    uint32_t seq;                       /* Transaction's sequence number. */
+    uint32_t sector_cnt;                /* Number of sector images. */
+    uint32_t revoke_cnt;                /* Number of revoked runs. */
+    block_sector_t slots[DESC_SLOTS];   /* SECTOR_CNT home sectors, then
+                                           REVOKE_CNT (start, length) pairs. */
+  };
+
+/* Last sector of a transaction in the log.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct commit_block
+  {
+    unsigned magic;                     /* COMMIT_MAGIC. */
+    uint32_t seq;                       /* Transaction's sequence number. */
+    uint32_t checksum;                  /* Of descriptor and images. */
+    uint8_t unused[500];                /* Not used. */
+  };
+
+static struct lock journal_lock;        /* Protects all of the following. */
+static bool enabled;                    /* Does the disk have a journal? */
+static block_sector_t log_start;        /* First sector of the log. */
+static size_t log_size;                 /* Number of sectors in the log. */
+static size_t log_head;                 /* Log sectors in use. */
+static uint32_t next_seq;               /* Running transaction's number. */
+static int active_cnt;                  /* Operations in progress. */
+static bool commit_pending;             /* Commit once ACTIVE_CNT is 0? */
+
+/* Runs revoked by the running transaction. */
+static block_sector_t revokes[REVOKE_MAX][2];
+static size_t revoke_cnt;
+
+/* Runs of data sectors to write back before the running
+   transaction commits. */
+static block_sector_t orders[ORDER_MAX][2];
+static size_t order_cnt;
+
+/* Buffers for writing the log, used with journal_lock held. */
+static struct journal_header header;
+static struct descriptor descriptor;
+static struct commit_block commit_block;
+
+/* Statistics. */
+static long long commit_cnt;            /* Transactions committed. */
+static long long forced_cnt;            /* Commits forced mid-operation. */
+static long long logged_cnt;            /* Sector images written to the log. */
+static long long checkpoint_cnt;        /* Times the log was emptied. */
+
+static void commit (void);
+static void write_ordered (void);
+static void checkpoint (void);
+static uint32_t replay (uint32_t seq);
+
+/* Initializes the journal module.  The journal is not used until
+   journal_create() or journal_open() is called. */
+void
+journal_init (void)
+{
+  ASSERT (sizeof (struct journal_header) == BLOCK_SECTOR_SIZE);
+  ASSERT (sizeof (struct descriptor) == BLOCK_SECTOR_SIZE);
+  ASSERT (sizeof (struct commit_block) == BLOCK_SECTOR_SIZE);
+
+  lock_init (&journal_lock);
+}
+
+/* Writes the journal header, describing an empty log whose first
+   transaction will be NEXT_SEQ. */
+static void
+reset_log (void)
+{
+  memset (&header, 0, sizeof header);
+  header.magic = JOURNAL_MAGIC;
+  header.start = log_start;
+  header.size = log_size;
+  header.seq = next_seq;
+  block_write (fs_device, JOURNAL_SECTOR, &header);
+  log_head = 0;
+}
+
+/* Sets aside space for the log on a newly formatted file system
+   and starts journaling.  Everything written to the file system
+   so far is first flushed to disk, since the log does not cover
+   it. */
+void
+journal_create (void)
+{
+  if (!free_map_allocate_near (LOG_SECTORS, JOURNAL_SECTOR, &log_start,
+                               NULL))
+    PANIC ("journal creation failed");
+  log_size = LOG_SECTORS;
+  cache_flush ();
+
+  lock_acquire (&journal_lock);
+  next_seq = 1;
+  reset_log ();
+  enabled = true;
+  lock_release (&journal_lock);
+}
+
+/* Reads the journal header and replays the committed
+   transactions in the log, then starts journaling.  Does nothing
+   if the file system has no journal.  Must be called before
+   anything else reads the file system. */
+void
+journal_open (void)
+{
+  block_read (fs_device, JOURNAL_SECTOR, &header);
+  if (header.magic != JOURNAL_MAGIC || header.size < DESC_SLOTS + 2
+      || header.start + header.size > block_size (fs_device))
+    return;
+
+  lock_acquire (&journal_lock);
+  log_start = header.start;
+  log_size = header.size;
+  next_seq = replay (header.seq);
+  reset_log ();
+  enabled = true;
+  lock_release (&journal_lock);
+}
+
+/* Commits any metadata changes still in memory and checkpoints
+   the log, leaving the file system fully written to disk. */
+void
+journal_done (void)
+{
+  lock_acquire (&journal_lock);
+  if (enabled)
+    commit ();
+  checkpoint ();
+  lock_release (&journal_lock);
+}
+
+/* Returns true if metadata changes are being journaled. */
+bool
+journal_enabled (void)
+{
+  return enabled;
+}
+
+/* Marks the start of a file system operation, which a commit
+   asked for by journal_commit() will wait for.  Operations may
+   nest. */
+void
+journal_begin (void)
+{
+  lock_acquire (&journal_lock);
+  active_cnt++;
+  lock_release (&journal_lock);
+}
+
+/* Marks the end of a file system operation, committing if a
+   commit was waiting for it. */
+void
+journal_end (void)
+{
+  lock_acquire (&journal_lock);
+  ASSERT (active_cnt > 0);
+  if (--active_cnt == 0 && commit_pending)
+    commit ();
+  lock_release (&journal_lock);
+}
+
+/* Commits the running transaction as soon as no file system
+   operation is in progress, which may be right away. */
+void
+journal_commit (void)
+{
+  if (!enabled)
+    return;
+
+  lock_acquire (&journal_lock);
+  if (active_cnt == 0)
+    commit ();
+  else
+    commit_pending = true;
+  lock_release (&journal_lock);
+}
+
+/* Commits the running transaction right away, even if
+   operations are in progress. */
+void
+journal_force (void)
+{
+  if (!enabled)
+    return;
+
+  lock_acquire (&journal_lock);
+  if (active_cnt > 0)
+    forced_cnt++;
+  commit ();
+  lock_release (&journal_lock);
+}
+
+/* Writes every committed change to its home sector and empties
+   the log. */
+void
+journal_checkpoint (void)
+{
+  lock_acquire (&journal_lock);
+  checkpoint ();
+  lock_release (&journal_lock);
+}
+
+/* Records that CNT sectors starting at SECTOR have been freed by
+   the running transaction, which may commit it to make room.
+   Returns the sequence number of the transaction that holds the
+   record.  The sectors must not be allocated again until
+   journal_committed() returns true for it. */
+uint32_t
+journal_revoke (block_sector_t sector, size_t cnt)
+{
+  uint32_t seq;
+
+  lock_acquire (&journal_lock);
+  if (revoke_cnt >= REVOKE_MAX)
+    {
+      if (active_cnt > 0)
+        forced_cnt++;
+      commit ();
+    }
+  revokes[revoke_cnt][0] = sector;
+  revokes[revoke_cnt][1] = cnt;
+  revoke_cnt++;
+  seq = next_seq;
+  lock_release (&journal_lock);
+
+  return seq;
+}
+
+/* Records that CNT data sectors starting at SECTOR, which were
+   unwritten, have been written, so that the running transaction,
+   which is about to mark them written, must write them back
+   before it commits. */
+void
+journal_order (block_sector_t sector, size_t cnt)
+{
+  block_sector_t *last;
+
+  if (!enabled)
+    return;
+
+  lock_acquire (&journal_lock);
+  last = order_cnt > 0 ? orders[order_cnt - 1] : NULL;
+  if (last != NULL && last[0] + last[1] == sector)
+    last[1] += cnt;
+  else
+    {
+      if (order_cnt >= ORDER_MAX)
+        write_ordered ();
+      orders[order_cnt][0] = sector;
+      orders[order_cnt][1] = cnt;
+      order_cnt++;
+    }
+  lock_release (&journal_lock);
+}
+
+/* Returns true if transaction SEQ has committed. */
+bool
+journal_committed (uint32_t seq)
+{
+  return seq < next_seq;
+}
+
+/* Prints journal statistics. */
+void
+journal_print_stats (void)
+{
+  printf ("Journal: %lld commits (%lld forced), %lld sectors logged, "
+          "%lld checkpoints\n",
+          commit_cnt, forced_cnt, logged_cnt, checkpoint_cnt);
+}
+
+/* Returns SUM updated with the contents of BLOCK. */
+static uint32_t
+checksum (uint32_t sum, const void *block)
+{
+  const uint32_t *p = block;
+  size_t i;
+
+  for (i = 0; i < BLOCK_SECTOR_SIZE / sizeof *p; i++)
+    sum = ((sum << 1) | (sum >> 31)) + p[i];
+  return sum;
+}
+
+/* Returns true if the running transaction has revoked SECTOR. */
+static bool
+revoked (block_sector_t sector)
+{
+  size_t i;
+
+  for (i = 0; i < revoke_cnt; i++)
+    if (sector - revokes[i][0] < revokes[i][1])
+      return true;
+  return false;
+}
+
+/* Writes the running transaction to the log and starts a new
+   one.  Checkpoints first if the log might not have room.
+   Must be called with journal_lock held. */
+static void
+commit (void)
+{
+  static block_sector_t sectors[DESC_SLOTS];
+  static const void *data[DESC_SLOTS];
+  struct descriptor *d = &descriptor;
+  size_t cnt, i;
+  uint32_t sum;
+
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+
+  commit_pending = false;
+  if (log_head + DESC_SLOTS + 2 > log_size)
+    checkpoint ();
+  write_ordered ();
+
+  cnt = cache_freeze (sectors, data, DESC_SLOTS - 2 * revoke_cnt);
+  if (cnt == 0 && revoke_cnt == 0)
+    {
+      cache_thaw ();
+      return;
+    }
+
+  /* Describe the transaction, leaving out sectors it freed. */
+  memset (d, 0, sizeof *d);
+  d->magic = DESCRIPTOR_MAGIC;
+  d->seq = next_seq;
+  for (i = 0; i < cnt; i++)
+    if (!revoked (sectors[i]))
+      {
+        data[d->sector_cnt] = data[i];
+        d->slots[d->sector_cnt++] = sectors[i];
+      }
+  for (i = 0; i < revoke_cnt; i++)
+    {
+      d->slots[d->sector_cnt + 2 * i] = revokes[i][0];
+      d->slots[d->sector_cnt + 2 * i + 1] = revokes[i][1];
+    }
+  d->revoke_cnt = revoke_cnt;
+
+  /* Write it to the log.  The commit block goes last, so the
+     transaction counts only once all of it is on disk. */
+  block_write (fs_device, log_start + log_head, d);
+  sum = checksum (0, d);
+  for (i = 0; i < d->sector_cnt; i++)
+    {
+      block_write (fs_device, log_start + log_head + 1 + i, data[i]);
+      sum = checksum (sum, data[i]);
+    }
+  memset (&commit_block, 0, sizeof commit_block);
+  commit_block.magic = COMMIT_MAGIC;
+  commit_block.seq = next_seq;
+  commit_block.checksum = sum;
+  block_write (fs_device, log_start + log_head + d->sector_cnt + 1,
+               &commit_block);
+
+  log_head += d->sector_cnt + 2;
+  logged_cnt += d->sector_cnt;
+  commit_cnt++;
+  next_seq++;
+  revoke_cnt = 0;
+  cache_thaw ();
+}
+
+/* Writes back the data sectors that the running transaction
+   must write before it commits, and forgets them.  Must be called
+   with journal_lock held. */
+static void
+write_ordered (void)
+{
+  size_t i;
+
+  for (i = 0; i < order_cnt; i++)
+    cache_flush_range (orders[i][0], orders[i][1]);
+  order_cnt = 0;
+}
+
+/* Writes every committed change to its home sector, then empties
+   the log.  Must be called with journal_lock held. */
+static void
+checkpoint (void)
+{
+  cache_flush ();
+  if (log_head > 0)
+    {
+      reset_log ();
+      checkpoint_cnt++;
+    }
+}
+
+/* Returns true if the transaction described by descriptor D,
+   which is at sector POS of the log, is intact and committed. */
+static bool
+check_transaction (const struct descriptor *d, size_t pos, uint32_t seq)
+{
+  static uint8_t block[BLOCK_SECTOR_SIZE];
+  const struct commit_block *c = (const struct commit_block *) block;
+  uint32_t sum;
+  size_t i;
+
+  if (d->magic != DESCRIPTOR_MAGIC || d->seq != seq
+      || d->sector_cnt > DESC_SLOTS
+      || d->revoke_cnt > (DESC_SLOTS - d->sector_cnt) / 2
+      || pos + d->sector_cnt + 2 > log_size)
+    return false;
+
+  sum = checksum (0, d);
+  for (i = 0; i < d->sector_cnt; i++)
+    {
+      block_read (fs_device, log_start + pos + 1 + i, block);
+      sum = checksum (sum, block);
+    }
+  block_read (fs_device, log_start + pos + d->sector_cnt + 1, block);
+  return c->magic == COMMIT_MAGIC && c->seq == seq && c->checksum == sum;
+}
+
+/* Returns true if any of transactions FIRST up to CNT, whose
+   descriptors are in D, revokes SECTOR. */
+static bool
+revoked_later (const struct descriptor d[], size_t first, size_t cnt,
+               block_sector_t sector)
+{
+  size_t i, j;
+
+  for (i = first; i < cnt; i++)
+    for (j = 0; j < d[i].revoke_cnt; j++)
+      {
+        const block_sector_t *run = &d[i].slots[d[i].sector_cnt + 2 * j];
+        if (sector - run[0] < run[1])
+          return true;
+      }
+  return false;
+}
+
+/* Writes the sector images of the committed transactions in the
+   log, starting from transaction SEQ at the start of the log, to
+   their home sectors, except for images that a later transaction
+   revoked.  Returns the number of the first transaction not
+   found. */
+static uint32_t
+replay (uint32_t seq)
+{
+  static uint8_t block[BLOCK_SECTOR_SIZE];
+  struct descriptor *d;
+  size_t cnt, pos, i, j;
+
+  d = malloc (log_size / 2 * sizeof *d);
+  if (d == NULL)
+    PANIC ("journal replay failed");
+
+  /* Find the committed transactions. */
+  for (cnt = pos = 0; pos + 2 <= log_size; cnt++)
+    {
+      block_read (fs_device, log_start + pos, &d[cnt]);
+      if (!check_transaction (&d[cnt], pos, seq + cnt))
+        break;
+      pos += d[cnt].sector_cnt + 2;
+    }
+
+  /* Apply them in order. */
+  for (i = pos = 0; i < cnt; i++)
+    {
+      for (j = 0; j < d[i].sector_cnt; j++)
+        if (!revoked_later (d, i + 1, cnt, d[i].slots[j]))
+          {
+            block_read (fs_device, log_start + pos + 1 + j, block);
+            block_write (fs_device, d[i].slots[j], block);
+          }
+      pos += d[i].sector_cnt + 2;
+    }
+  if (cnt > 0)
+    printf ("journal: replayed %zu transactions\n", cnt);
+
+  free (d);
+  return seq + cnt;
+}
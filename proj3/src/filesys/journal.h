@@ -0,0 +1,27 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "devices/block.h"
+
+void journal_init (void);
+void journal_create (void);
+void journal_open (void);
+void journal_done (void);
+bool journal_enabled (void);
+
+void journal_begin (void);
+void journal_end (void);
+void journal_commit (void);
+void journal_force (void);
+void journal_checkpoint (void);
+
+uint32_t journal_revoke (block_sector_t, size_t);
+void journal_order (block_sector_t, size_t);
+bool journal_committed (uint32_t seq);
+
+void journal_print_stats (void);
+
+#endif /* filesys/journal.h */
@@ -0,0 +1,59 @@
+#ifndef __LIB_AIO_H
+#define __LIB_AIO_H
+
+/* Asynchronous I/O rings, shared between a user process and the
+   kernel.
+
+   The process registers a ring with aio_setup().  To start I/O,
+   it fills in submission queue entries at sq[sq_tail %
+   AIO_RING_SIZE] and advances sq_tail.  It then calls
+   wait_for_completions(), which hands every new entry to kernel
+   worker threads, advancing sq_head, and posts finished requests
+   as completion queue entries at cq[cq_tail % AIO_RING_SIZE],
+   advancing cq_tail.  The process consumes completions by
+   advancing cq_head.  Indexes only increase; only the kernel
+   writes sq_head and cq_tail, and only the process writes sq_tail
+   and cq_head.  The process may compute while its requests are in
+   progress, and must not touch a request's buffer until its
+   completion is posted. */
+
+/* Number of entries in each queue.  Must be a power of 2. */
+#define AIO_RING_SIZE 16
+
+/* Maximum number of bytes in a single request. */
+#define AIO_MAX 16384
+
+/* Request types. */
+#define AIO_READ 0              /* Read from a file. */
+#define AIO_WRITE 1             /* Write to a file. */
+
+/* Submission queue entry. */
+struct aio_sqe
+  {
+    int op;                     /* AIO_READ or AIO_WRITE. */
+    int fd;                     /* File descriptor. */
+    void *buf;                  /* Buffer to read into or write from. */
+    unsigned size;              /* Number of bytes, at most AIO_MAX. */
+    unsigned offset;            /* File offset. */
+    unsigned user_data;         /* Copied into the completion. */
+  };
+
+/* Completion queue entry. */
+struct aio_cqe
+  {
+    unsigned user_data;         /* From the submission. */
+    int result;                 /* Bytes transferred, or -1 on error. */
+  };
+
+/* A submission queue and a completion queue. */
+struct aio_ring
+  {
+    unsigned sq_head;           /* Next submission for the kernel. */
+    unsigned sq_tail;           /* Next submission for the process. */
+    unsigned cq_head;           /* Next completion for the process. */
+    unsigned cq_tail;           /* Next completion for the kernel. */
+    struct aio_sqe sq[AIO_RING_SIZE];
+    struct aio_cqe cq[AIO_RING_SIZE];
+  };
+
+#endif /* lib/aio.h */
@@ -0,0 +1,23 @@
+#ifndef __LIB_DIRENT_H
+#define __LIB_DIRENT_H
+
+/* Directory entries returned in bulk by getdents(). */
+
+/* Maximum characters in a name, not counting the null
+   terminator. */
+#define DIRENT_NAME_MAX 14
+
+/* Types of files. */
+#define DT_REG 0                /* Ordinary file. */
+#define DT_DIR 1                /* Directory. */
+
+/* A directory entry and the metadata of the file it names. */
+struct dirent
+  {
+    int inumber;                /* Inode number. */
+    int type;                   /* DT_REG or DT_DIR. */
+    unsigned size;              /* File size in bytes. */
+    char name[DIRENT_NAME_MAX + 1]; /* Null-terminated name. */
+  };
+
+#endif /* lib/dirent.h */
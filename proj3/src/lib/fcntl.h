@@ -0,0 +1,12 @@
+#ifndef __LIB_FCNTL_H
+#define __LIB_FCNTL_H
+
+/* Flags for open_flags(). */
+#define O_DIRECT 0x1            /* Transfer whole sectors straight between
+                                   disk and the caller's buffers, bypassing
+                                   the file system's caches. */
+
+/* All valid flags. */
+#define O_FLAGS (O_DIRECT)
+
+#endif /* lib/fcntl.h */
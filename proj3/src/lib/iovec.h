@@ -0,0 +1,18 @@
+#ifndef __LIB_IOVEC_H
+#define __LIB_IOVEC_H
+
+#include <stddef.h>
+
+/* One buffer in a vector of buffers for readv() and writev(),
+   which transfer the bytes of all the buffers in a vector, in
+   order, as a single stretch of file. */
+struct iovec
+  {
+    void *iov_base;             /* First byte. */
+    size_t iov_len;             /* Number of bytes. */
+  };
+
+/* Maximum number of buffers in a vector. */
+#define IOV_MAX 16
+
+#endif /* lib/iovec.h */
@@ -23,11 +23,21 @@ typedef unsigned long elem_type;
 
 /* From the outside, a bitmap is an array of bits.  From the
    inside, it's an array of elem_type (defined above) that
-   simulates an array of bits. */
+   simulates an array of bits.
+
+   Optionally, a bitmap also keeps a summary level with one bit
+   per element in each of two arrays: bit K of ANY_SET is 1 if
+   element K has any bit set, and bit K of ANY_CLEAR is 1 if
+   element K has any bit clear.  Searches use the summary to
+   skip ELEM_BITS full (or empty) elements at a time, so finding
+   a free bit costs about the same in a nearly full bitmap as in
+   an empty one. */
 struct bitmap
   {
     size_t bit_cnt;     /* Number of bits. */
     elem_type *bits;    /* Elements that represent bits. */
+    elem_type *any_set;   /* Summary: elements with a 1 bit, or null. */
+    elem_type *any_clear; /* Summary: elements with a 0 bit, or null. */
   };
 
 /* Returns the index of the element that contains the bit
@@ -69,6 +79,118 @@ last_mask (const struct bitmap *b)
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
 
+/* Returns a mask with the CNT bits starting at bit START of an
+   element set to 1 and the rest set to 0.
+   START + CNT must not exceed ELEM_BITS, and CNT must be
+   nonzero. */
+static inline elem_type
+range_mask (size_t start, size_t cnt)
+{
+  elem_type high = (start + cnt < ELEM_BITS
+                    ? ((elem_type) 1 << (start + cnt)) - 1
+                    : (elem_type) -1);
+  return high & ~(((elem_type) 1 << start) - 1);
+}
+
+/* Returns the number of bits set to 1 in X. */
+static inline size_t
+popcount (elem_type x)
+{
+  /* Count bits in parallel within ever wider fields.  We cannot
+     use __builtin_popcount(), which needs libgcc for i386. */
+  const elem_type ones = (elem_type) -1;
+  x = x - ((x >> 1) & (ones / 3));
+  x = (x & (ones / 15 * 3)) + ((x >> 2) & (ones / 15 * 3));
+  x = (x + (x >> 4)) & (ones / 255 * 15);
+  return (elem_type) (x * (ones / 255)) >> (sizeof x - 1) * CHAR_BIT;
+}
+
+/* Returns the index of the lowest 1 bit in X, which must be
+   nonzero. */
+static inline size_t
+lowest_bit (elem_type x)
+{
+  return __builtin_ctzl (x);
+}
+
+/* Returns the bits of element IDX in B that lie within the
+   bitmap, i.e. all of them unless IDX is the last element. */
+static inline elem_type
+valid_mask (const struct bitmap *b, size_t idx)
+{
+  return idx + 1 < elem_cnt (b->bit_cnt) ? (elem_type) -1 : last_mask (b);
+}
+
+/* Brings the summary bits for element IDX of B up to date, if
+   B has a summary. */
+static void
+update_summary (struct bitmap *b, size_t idx)
+{
+  if (b->any_set != NULL)
+    {
+      elem_type valid = valid_mask (b, idx);
+      elem_type mask = bit_mask (idx);
+      size_t sidx = elem_idx (idx);
+
+      if ((b->bits[idx] & valid) != 0)
+        b->any_set[sidx] |= mask;
+      else
+        b->any_set[sidx] &= ~mask;
+      if ((~b->bits[idx] & valid) != 0)
+        b->any_clear[sidx] |= mask;
+      else
+        b->any_clear[sidx] &= ~mask;
+    }
+}
+
+/* Returns the index of the first element at or after IDX in B
+   that has any bit set to VALUE, according to B's summary, or
+   the number of elements in B if there is none. */
+static size_t
+summary_next (const struct bitmap *b, size_t idx, bool value)
+{
+  const elem_type *summary = value ? b->any_set : b->any_clear;
+  size_t cnt = elem_cnt (b->bit_cnt);
+
+  while (idx < cnt)
+    {
+      elem_type w = summary[elem_idx (idx)] & ~(bit_mask (idx) - 1);
+      if (w != 0)
+        {
+          idx = elem_idx (idx) * ELEM_BITS + lowest_bit (w);
+          return idx < cnt ? idx : cnt;
+        }
+      idx = (elem_idx (idx) + 1) * ELEM_BITS;
+    }
+  return cnt;
+}
+
+/* Returns the index of the first bit in B between START and END,
+   exclusive, that is set to VALUE, or END if there is none. */
+static size_t
+find_next (const struct bitmap *b, size_t start, size_t end, bool value)
+{
+  elem_type flip = value ? 0 : (elem_type) -1;
+  size_t i = start;
+
+  while (i < end)
+    {
+      size_t idx = elem_idx (i);
+      elem_type w = (b->bits[idx] ^ flip) & ~(bit_mask (i) - 1);
+      if (w != 0)
+        {
+          i = idx * ELEM_BITS + lowest_bit (w);
+          return i < end ? i : end;
+        }
+
+      idx++;
+      if (b->any_set != NULL)
+        idx = summary_next (b, idx, value);
+      i = idx * ELEM_BITS;
+    }
+  return end;
+}
+
 /* Creation and destruction. */
 
 
@@ -80,6 +202,7 @@ bitmap_create (size_t bit_cnt)
     {
       b->bit_cnt = bit_cnt;
       b->bits = malloc (byte_cnt (bit_cnt));
+      b->any_set = b->any_clear = NULL;
       if (b->bits != NULL || bit_cnt == 0)
         {
           bitmap_set_all (b, false);
@@ -102,6 +225,7 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
 
   b->bit_cnt = bit_cnt;
   b->bits = (elem_type *) (b + 1);
+  b->any_set = b->any_clear = NULL;
   bitmap_set_all (b, false);
   return b;
 }
@@ -120,10 +244,45 @@ bitmap_destroy (struct bitmap *b)
 {
   if (b != NULL) 
     {
+      free (b->any_set);
+      free (b->any_clear);
       free (b->bits);
       free (b);
     }
 }
+
+/* Adds a summary level to B, which speeds up searches in large,
+   mostly full or mostly empty bitmaps.  B must have been created
+   with bitmap_create().  Returns true if successful, false if
+   memory allocation failed, in which case B still works without
+   a summary.
+
+   Summary updates are not atomic with the bit updates they
+   follow, so B's users must serialize modifications to B with a
+   lock of their own. */
+bool
+bitmap_enable_summary (struct bitmap *b)
+{
+  size_t summary_bytes = byte_cnt (elem_cnt (b->bit_cnt));
+  size_t idx;
+
+  ASSERT (b->any_set == NULL);
+  if (b->bit_cnt == 0)
+    return true;
+
+  b->any_set = calloc (1, summary_bytes);
+  b->any_clear = calloc (1, summary_bytes);
+  if (b->any_set == NULL || b->any_clear == NULL)
+    {
+      free (b->any_set);
+      free (b->any_clear);
+      b->any_set = b->any_clear = NULL;
+      return false;
+    }
+  for (idx = 0; idx < elem_cnt (b->bit_cnt); idx++)
+    update_summary (b, idx);
+  return true;
+}
 
 /* Bitmap size. */
 
@@ -159,6 +318,7 @@ bitmap_mark (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the OR instruction in [IA32-v2b]. */
   asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  update_summary (b, idx);
 }
 
 /* Atomically sets the bit numbered BIT_IDX in B to false. */
@@ -172,6 +332,7 @@ bitmap_reset (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the AND instruction in [IA32-v2a]. */
   asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+  update_summary (b, idx);
 }
 
 /* Atomically toggles the bit numbered IDX in B;
@@ -187,6 +348,7 @@ bitmap_flip (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the XOR instruction in [IA32-v2b]. */
   asm ("xorl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  update_summary (b, idx);
 }
 
 /* Returns the value of the bit numbered IDX in B. */
@@ -209,18 +371,35 @@ bitmap_set_all (struct bitmap *b, bool value)
   bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.
+   Each element is updated atomically, a whole element at a
+   time. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
+  size_t end = start + cnt;
   size_t i;
   
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  for (i = start; i < end; )
+    {
+      size_t idx = elem_idx (i);
+      size_t ofs = i % ELEM_BITS;
+      size_t n = ELEM_BITS - ofs < end - i ? ELEM_BITS - ofs : end - i;
+      elem_type mask = range_mask (ofs, n);
+
+      /* See bitmap_mark() and bitmap_reset() for why we use
+         inline assembly. */
+      if (value)
+        asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+      else
+        asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+      update_summary (b, idx);
+      i += n;
+    }
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -228,17 +407,22 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i, value_cnt;
+  size_t end = start + cnt;
+  size_t i, set_cnt;
 
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      value_cnt++;
-  return value_cnt;
+  set_cnt = 0;
+  for (i = start; i < end; )
+    {
+      size_t ofs = i % ELEM_BITS;
+      size_t n = ELEM_BITS - ofs < end - i ? ELEM_BITS - ofs : end - i;
+      set_cnt += popcount (b->bits[elem_idx (i)] & range_mask (ofs, n));
+      i += n;
+    }
+  return value ? set_cnt : cnt - set_cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -246,16 +430,11 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
-  return false;
+  return find_next (b, start, start + cnt, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -284,6 +463,37 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 
 /* Finding set or unset bits. */
 
+/* Finds and returns the starting index of the first group of CNT
+   consecutive bits in B that are all set to VALUE and that
+   starts between START and LAST, inclusive.
+   If there is no such group, returns BITMAP_ERROR. */
+static size_t
+scan_range (const struct bitmap *b, size_t start, size_t last,
+            size_t cnt, bool value)
+{
+  size_t i = start;
+
+  if (cnt == 0)
+    return start <= last ? start : BITMAP_ERROR;
+
+  /* Alternate between finding the next bit set to VALUE and the
+     first bit after it that is not, which gives the runs of
+     VALUE in order, a word at a time. */
+  while (i <= last)
+    {
+      size_t run_end;
+
+      i = find_next (b, i, last + 1, value);
+      if (i > last)
+        break;
+      run_end = find_next (b, i, i + cnt, !value);
+      if (run_end == i + cnt)
+        return i;
+      i = run_end;
+    }
+  return BITMAP_ERROR;
+}
+
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
@@ -295,16 +505,34 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
   ASSERT (start <= b->bit_cnt);
 
   if (cnt <= b->bit_cnt) 
-    {
-      size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
-    }
+    return scan_range (b, start, b->bit_cnt - cnt, cnt, value);
   return BITMAP_ERROR;
 }
 
+/* Like bitmap_scan(), but starts looking at HINT, typically just
+   past the previous allocation, and wraps around to the start of
+   B if there is no suitable group at or after HINT.  This
+   "next fit" policy avoids rescanning the densely used front of
+   a bitmap that fills from the bottom. */
+size_t
+bitmap_scan_next_fit (const struct bitmap *b, size_t hint, size_t cnt,
+                      bool value)
+{
+  size_t idx;
+
+  ASSERT (b != NULL);
+
+  if (cnt > b->bit_cnt)
+    return BITMAP_ERROR;
+  if (hint > b->bit_cnt - cnt)
+    hint = 0;
+
+  idx = scan_range (b, hint, b->bit_cnt - cnt, cnt, value);
+  if (idx == BITMAP_ERROR && hint > 0)
+    idx = scan_range (b, 0, hint - 1, cnt, value);
+  return idx;
+}
+
 /* Finds the first group of CNT consecutive bits in B at or after
    START that are all set to VALUE, flips them all to !VALUE,
    and returns the index of the first bit in the group.
@@ -320,6 +548,18 @@ bitmap_scan_and_flip (struct bitmap *b, size_t start, size_t cnt, bool value)
     bitmap_set_multiple (b, idx, cnt, !value);
   return idx;
 }
+
+/* Like bitmap_scan_and_flip(), but searches with
+   bitmap_scan_next_fit() starting from HINT. */
+size_t
+bitmap_scan_and_flip_next_fit (struct bitmap *b, size_t hint, size_t cnt,
+                               bool value)
+{
+  size_t idx = bitmap_scan_next_fit (b, hint, cnt, value);
+  if (idx != BITMAP_ERROR) 
+    bitmap_set_multiple (b, idx, cnt, !value);
+  return idx;
+}
 
 /* File input and output. */
 
@@ -340,8 +580,12 @@ bitmap_read (struct bitmap *b, struct file *file)
   if (b->bit_cnt > 0) 
     {
       off_t size = byte_cnt (b->bit_cnt);
+      size_t idx;
+
       success = file_read_at (file, b->bits, size, 0) == size;
       b->bits[elem_cnt (b->bit_cnt) - 1] &= last_mask (b);
+      for (idx = 0; idx < elem_cnt (b->bit_cnt); idx++)
+        update_summary (b, idx);
     }
   return success;
 }
@@ -354,6 +598,27 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes the part of B that holds the CNT bits starting at START
+   to FILE, at the same offset that bitmap_write() would write
+   it, so that a bitmap can be kept up to date on disk without
+   rewriting all of it.  Return true if successful, false
+   otherwise. */
+bool
+bitmap_write_range (const struct bitmap *b, struct file *file,
+                    size_t start, size_t cnt)
+{
+  off_t ofs, size;
+
+  ASSERT (start <= b->bit_cnt);
+  ASSERT (cnt <= b->bit_cnt - start);
+
+  if (cnt == 0)
+    return true;
+  ofs = start / CHAR_BIT;
+  size = DIV_ROUND_UP (start + cnt, CHAR_BIT) - ofs;
+  return file_write_at (file, (uint8_t *) b->bits + ofs, size, ofs) == size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
@@ -0,0 +1,314 @@
+/* Hash table with incremental rehashing.
+
+   See ihash.h for basic information. */
+
+#include "ihash.h"
+#include "../debug.h"
+#include "threads/malloc.h"
+
+#define list_elem_to_hash_elem(LIST_ELEM)                       \
+        list_entry(LIST_ELEM, struct hash_elem, list_elem)
+
+/* Element per bucket ratios. */
+#define MIN_ELEMS_PER_BUCKET  1 /* Elems/bucket < 1: reduce # of buckets. */
+#define BEST_ELEMS_PER_BUCKET 2 /* Ideal elems/bucket. */
+#define MAX_ELEMS_PER_BUCKET  4 /* Elems/bucket > 4: increase # of buckets. */
+
+/* Number of old buckets moved per insertion or deletion.  The
+   table can at most double in size, or halve, between resizes,
+   so this is enough to finish each move long before the next
+   one is needed. */
+#define MOVE_STEP 2
+
+static struct list *find_bucket (struct ihash *, struct hash_elem *);
+static struct hash_elem *find_elem (struct ihash *, struct list *,
+                                    struct hash_elem *);
+static void insert_elem (struct ihash *, struct list *, struct hash_elem *);
+static void remove_elem (struct ihash *, struct hash_elem *);
+static void resize (struct ihash *);
+static void move_buckets (struct ihash *, size_t cnt);
+
+/* Initializes hash table H to compute hash values using HASH and
+   compare hash elements using LESS, given auxiliary data AUX. */
+bool
+ihash_init (struct ihash *h,
+            hash_hash_func *hash, hash_less_func *less, void *aux)
+{
+  h->elem_cnt = 0;
+  h->bucket_cnt = 4;
+  h->buckets = malloc (sizeof *h->buckets * h->bucket_cnt);
+  h->old_bucket_cnt = 0;
+  h->old_buckets = NULL;
+  h->move_idx = 0;
+  h->hash = hash;
+  h->less = less;
+  h->aux = aux;
+
+  if (h->buckets != NULL)
+    {
+      ihash_clear (h, NULL);
+      return true;
+    }
+  else
+    return false;
+}
+
+/* Removes all the elements from H, calling DESTRUCTOR, if it is
+   non-null, for each of them.  The same restrictions apply as
+   for hash_clear(). */
+void
+ihash_clear (struct ihash *h, hash_action_func *destructor)
+{
+  size_t i;
+
+  /* Finish any move in progress, so there's one table to clear. */
+  move_buckets (h, h->old_bucket_cnt);
+
+  for (i = 0; i < h->bucket_cnt; i++)
+    {
+      struct list *bucket = &h->buckets[i];
+
+      if (destructor != NULL)
+        while (!list_empty (bucket))
+          {
+            struct list_elem *list_elem = list_pop_front (bucket);
+            struct hash_elem *hash_elem = list_elem_to_hash_elem (list_elem);
+            destructor (hash_elem, h->aux);
+          }
+
+      list_init (bucket);
+    }
+
+  h->elem_cnt = 0;
+}
+
+/* Destroys hash table H, calling DESTRUCTOR, if it is non-null,
+   for each element first.  The same restrictions apply as for
+   hash_destroy(). */
+void
+ihash_destroy (struct ihash *h, hash_action_func *destructor)
+{
+  if (destructor != NULL)
+    ihash_clear (h, destructor);
+  free (h->old_buckets);
+  free (h->buckets);
+}
+
+/* Inserts NEW into hash table H and returns a null pointer, if
+   no equal element is already in the table.
+   If an equal element is already in the table, returns it
+   without inserting NEW. */
+struct hash_elem *
+ihash_insert (struct ihash *h, struct hash_elem *new)
+{
+  struct list *bucket = find_bucket (h, new);
+  struct hash_elem *old = find_elem (h, bucket, new);
+
+  if (old == NULL)
+    insert_elem (h, bucket, new);
+
+  resize (h);
+
+  return old;
+}
+
+/* Inserts NEW into hash table H, replacing any equal element
+   already in the table, which is returned. */
+struct hash_elem *
+ihash_replace (struct ihash *h, struct hash_elem *new)
+{
+  struct list *bucket = find_bucket (h, new);
+  struct hash_elem *old = find_elem (h, bucket, new);
+
+  if (old != NULL)
+    remove_elem (h, old);
+  insert_elem (h, bucket, new);
+
+  resize (h);
+
+  return old;
+}
+
+/* Finds and returns an element equal to E in hash table H, or a
+   null pointer if no equal element exists in the table. */
+struct hash_elem *
+ihash_find (struct ihash *h, struct hash_elem *e)
+{
+  return find_elem (h, find_bucket (h, e), e);
+}
+
+/* Finds, removes, and returns an element equal to E in hash
+   table H.  Returns a null pointer if no equal element existed
+   in the table. */
+struct hash_elem *
+ihash_delete (struct ihash *h, struct hash_elem *e)
+{
+  struct hash_elem *found = find_elem (h, find_bucket (h, e), e);
+  if (found != NULL)
+    remove_elem (h, found);
+  resize (h);
+  return found;
+}
+
+/* Calls ACTION for each element in hash table H in arbitrary
+   order.  The same restrictions apply as for hash_apply(). */
+void
+ihash_apply (struct ihash *h, hash_action_func *action)
+{
+  size_t i;
+
+  ASSERT (action != NULL);
+
+  for (i = 0; i < h->old_bucket_cnt + h->bucket_cnt; i++)
+    {
+      struct list *bucket = (i < h->old_bucket_cnt
+                             ? &h->old_buckets[i]
+                             : &h->buckets[i - h->old_bucket_cnt]);
+      struct list_elem *elem, *next;
+
+      for (elem = list_begin (bucket); elem != list_end (bucket); elem = next)
+        {
+          next = list_next (elem);
+          action (list_elem_to_hash_elem (elem), h->aux);
+        }
+    }
+}
+
+/* Returns the number of elements in H. */
+size_t
+ihash_size (struct ihash *h)
+{
+  return h->elem_cnt;
+}
+
+/* Returns true if H contains no elements, false otherwise. */
+bool
+ihash_empty (struct ihash *h)
+{
+  return h->elem_cnt == 0;
+}
+
+/* Returns the bucket in H that E belongs in: its bucket in the
+   table being moved, if that bucket has not been moved yet, and
+   its bucket in the current table otherwise. */
+static struct list *
+find_bucket (struct ihash *h, struct hash_elem *e)
+{
+  unsigned hash = h->hash (e, h->aux);
+
+  if (h->old_buckets != NULL)
+    {
+      size_t old_idx = hash & (h->old_bucket_cnt - 1);
+      if (old_idx >= h->move_idx)
+        return &h->old_buckets[old_idx];
+    }
+  return &h->buckets[hash & (h->bucket_cnt - 1)];
+}
+
+/* Searches BUCKET in H for a hash element equal to E.  Returns
+   it if found or a null pointer otherwise. */
+static struct hash_elem *
+find_elem (struct ihash *h, struct list *bucket, struct hash_elem *e)
+{
+  struct list_elem *i;
+
+  for (i = list_begin (bucket); i != list_end (bucket); i = list_next (i))
+    {
+      struct hash_elem *hi = list_elem_to_hash_elem (i);
+      if (!h->less (hi, e, h->aux) && !h->less (e, hi, h->aux))
+        return hi;
+    }
+  return NULL;
+}
+
+/* Moves the elements of up to CNT not yet moved old buckets of H
+   into the current table, and frees the old table once it is
+   empty. */
+static void
+move_buckets (struct ihash *h, size_t cnt)
+{
+  if (h->old_buckets == NULL)
+    return;
+
+  for (; cnt > 0 && h->move_idx < h->old_bucket_cnt; cnt--)
+    {
+      struct list *old_bucket = &h->old_buckets[h->move_idx++];
+
+      while (!list_empty (old_bucket))
+        {
+          struct list_elem *elem = list_pop_front (old_bucket);
+          struct hash_elem *e = list_elem_to_hash_elem (elem);
+          size_t idx = h->hash (e, h->aux) & (h->bucket_cnt - 1);
+          list_push_front (&h->buckets[idx], elem);
+        }
+    }
+
+  if (h->move_idx >= h->old_bucket_cnt)
+    {
+      free (h->old_buckets);
+      h->old_buckets = NULL;
+      h->old_bucket_cnt = 0;
+      h->move_idx = 0;
+    }
+}
+
+/* Continues any move in progress in H, or starts one if H's load
+   factor has left the range it should be in.  Like rehash() in
+   hash.c, this can fail because of an out-of-memory condition,
+   which only makes the table less efficient. */
+static void
+resize (struct ihash *h)
+{
+  size_t new_bucket_cnt;
+  struct list *new_buckets;
+  size_t i;
+
+  if (h->old_buckets != NULL)
+    {
+      move_buckets (h, MOVE_STEP);
+      return;
+    }
+
+  /* Leave the table alone while its load factor is in range. */
+  if (h->elem_cnt <= h->bucket_cnt * MAX_ELEMS_PER_BUCKET
+      && (h->elem_cnt >= h->bucket_cnt * MIN_ELEMS_PER_BUCKET
+          || h->bucket_cnt <= 4))
+    return;
+
+  /* Double or halve the number of buckets, moving toward
+     BEST_ELEMS_PER_BUCKET. */
+  if (h->elem_cnt > h->bucket_cnt * BEST_ELEMS_PER_BUCKET)
+    new_bucket_cnt = h->bucket_cnt * 2;
+  else
+    new_bucket_cnt = h->bucket_cnt / 2;
+
+  new_buckets = malloc (sizeof *new_buckets * new_bucket_cnt);
+  if (new_buckets == NULL)
+    return;
+  for (i = 0; i < new_bucket_cnt; i++)
+    list_init (&new_buckets[i]);
+
+  /* Retire the current table and start moving it. */
+  h->old_buckets = h->buckets;
+  h->old_bucket_cnt = h->bucket_cnt;
+  h->move_idx = 0;
+  h->buckets = new_buckets;
+  h->bucket_cnt = new_bucket_cnt;
+  move_buckets (h, MOVE_STEP);
+}
+
+/* Inserts E into BUCKET (in hash table H). */
+static void
+insert_elem (struct ihash *h, struct list *bucket, struct hash_elem *e)
+{
+  h->elem_cnt++;
+  list_push_front (bucket, &e->list_elem);
+}
+
+/* Removes E from hash table H. */
+static void
+remove_elem (struct ihash *h, struct hash_elem *e)
+{
+  h->elem_cnt--;
+  list_remove (&e->list_elem);
+}
@@ -0,0 +1,60 @@
+#ifndef __LIB_KERNEL_IHASH_H
+#define __LIB_KERNEL_IHASH_H
+
+/* Hash table with incremental rehashing.
+
+   This is a variant of the chained hash table in hash.h, using
+   the same `struct hash_elem', hash_entry(), and hash and
+   comparison function types, so that a table can be switched
+   from one to the other by changing only the calls that operate
+   on the table itself.
+
+   The difference is in how the table grows and shrinks.
+   hash.c moves every element into a new bucket array in the
+   insertion or deletion that crosses a load factor threshold,
+   so an occasional operation costs O(n).  This table instead
+   allocates the new bucket array and then moves the elements of
+   a few old buckets at each subsequent insertion or deletion,
+   so every operation costs O(1) amortized and O(1) worst case
+   apart from the allocation itself.  While a move is in
+   progress, an element lives in its old bucket if that bucket
+   has not been moved yet, and in its new bucket otherwise. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "hash.h"
+
+/* Hash table. */
+struct ihash
+  {
+    size_t elem_cnt;            /* Number of elements in table. */
+    size_t bucket_cnt;          /* Number of buckets, a power of 2. */
+    struct list *buckets;       /* Array of `bucket_cnt' lists. */
+    size_t old_bucket_cnt;      /* Buckets in table being moved. */
+    struct list *old_buckets;   /* Table being moved, or null. */
+    size_t move_idx;            /* Next old bucket to move. */
+    hash_hash_func *hash;       /* Hash function. */
+    hash_less_func *less;       /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `hash' and `less'. */
+  };
+
+/* Basic life cycle. */
+bool ihash_init (struct ihash *, hash_hash_func *, hash_less_func *,
+                 void *aux);
+void ihash_clear (struct ihash *, hash_action_func *);
+void ihash_destroy (struct ihash *, hash_action_func *);
+
+/* Search, insertion, deletion. */
+struct hash_elem *ihash_insert (struct ihash *, struct hash_elem *);
+struct hash_elem *ihash_replace (struct ihash *, struct hash_elem *);
+struct hash_elem *ihash_find (struct ihash *, struct hash_elem *);
+struct hash_elem *ihash_delete (struct ihash *, struct hash_elem *);
+
+/* Iteration. */
+void ihash_apply (struct ihash *, hash_action_func *);
+
+/* Information. */
+size_t ihash_size (struct ihash *);
+bool ihash_empty (struct ihash *);
+
+#endif /* lib/kernel/ihash.h */
@@ -0,0 +1,247 @@
+/* Open-addressing hash table for integer keys.
+
+   See ohash.h for basic information. */
+
+#include "ohash.h"
+#include "../debug.h"
+#include "threads/malloc.h"
+
+/* Load factor limits, as fractions of the slot count.  Linear
+   probing degrades quickly above one half full. */
+#define MIN_SLOTS 8             /* Never fewer slots than this. */
+#define MAX_LOAD_SHIFT 1        /* Grow above slot_cnt >> 1 elements. */
+#define MIN_LOAD_SHIFT 3        /* Shrink below slot_cnt >> 3 elements. */
+
+static bool resize (struct ohash *, size_t new_slot_cnt);
+
+/* Returns the home slot index for KEY in a table with SLOT_CNT
+   slots.  Keys such as page addresses and sector numbers have
+   their entropy in a few bits, often not the low ones, so the
+   key is mixed before it is masked. */
+static inline size_t
+home_slot (uintptr_t key, size_t slot_cnt)
+{
+  uint32_t x = key;
+  x ^= x >> 16;
+  x *= 0x45d9f3bu;
+  x ^= x >> 16;
+  return x & (slot_cnt - 1);
+}
+
+/* Returns the index of the slot in H that holds KEY, or of the
+   empty slot where KEY would go if it is not in H. */
+static size_t
+find_slot (const struct ohash *h, uintptr_t key)
+{
+  size_t mask = h->slot_cnt - 1;
+  size_t i;
+
+  for (i = home_slot (key, h->slot_cnt); h->slots[i] != NULL;
+       i = (i + 1) & mask)
+    if (h->slots[i]->key == key)
+      break;
+  return i;
+}
+
+/* Initializes hash table H, with auxiliary data AUX for the
+   functions passed to ohash_clear(), ohash_destroy(), and
+   ohash_apply(). */
+bool
+ohash_init (struct ohash *h, void *aux)
+{
+  h->elem_cnt = 0;
+  h->slot_cnt = MIN_SLOTS;
+  h->min_slot_cnt = MIN_SLOTS;
+  h->slots = calloc (h->slot_cnt, sizeof *h->slots);
+  h->aux = aux;
+  return h->slots != NULL;
+}
+
+/* Removes all the elements from H, calling DESTRUCTOR, if it is
+   non-null, for each of them.  Modifying H while ohash_clear()
+   is running yields undefined behavior. */
+void
+ohash_clear (struct ohash *h, ohash_action_func *destructor)
+{
+  size_t i;
+
+  for (i = 0; i < h->slot_cnt; i++)
+    if (h->slots[i] != NULL)
+      {
+        struct ohash_elem *e = h->slots[i];
+        h->slots[i] = NULL;
+        if (destructor != NULL)
+          destructor (e, h->aux);
+      }
+  h->elem_cnt = 0;
+}
+
+/* Destroys hash table H, calling DESTRUCTOR, if it is non-null,
+   for each element first. */
+void
+ohash_destroy (struct ohash *h, ohash_action_func *destructor)
+{
+  if (destructor != NULL)
+    ohash_clear (h, destructor);
+  free (h->slots);
+}
+
+/* Makes room in hash table H for CNT elements, and keeps it
+   from shrinking below that, so that inserting into H never
+   fails while it holds fewer than CNT elements.  Returns true if
+   successful, false if memory allocation failed. */
+bool
+ohash_reserve (struct ohash *h, size_t cnt)
+{
+  size_t slot_cnt = MIN_SLOTS;
+
+  while (cnt > slot_cnt >> MAX_LOAD_SHIFT)
+    slot_cnt *= 2;
+  if (slot_cnt > h->slot_cnt && !resize (h, slot_cnt))
+    return false;
+  h->min_slot_cnt = slot_cnt;
+  return true;
+}
+
+/* Inserts NEW into hash table H and returns a null pointer, if
+   no element with the same key is already in the table.
+   If one is, returns it without inserting NEW.  If H is full and
+   cannot grow because memory allocation failed, returns NEW
+   itself without inserting it. */
+struct ohash_elem *
+ohash_insert (struct ohash *h, struct ohash_elem *new)
+{
+  size_t i = find_slot (h, new->key);
+
+  if (h->slots[i] != NULL)
+    return h->slots[i];
+
+  /* Grow if this would put us over the maximum load.  If that
+     fails we can keep going, less efficiently, as long as one
+     slot stays empty to terminate probes. */
+  if (h->elem_cnt + 1 > h->slot_cnt >> MAX_LOAD_SHIFT
+      && resize (h, h->slot_cnt * 2))
+    i = find_slot (h, new->key);
+  else if (h->elem_cnt + 2 > h->slot_cnt)
+    return new;
+
+  h->slots[i] = new;
+  h->elem_cnt++;
+  return NULL;
+}
+
+/* Inserts NEW into hash table H, replacing any element with the
+   same key already in the table, which is returned.  Returns NEW
+   itself, without inserting it, under the same conditions as
+   ohash_insert(). */
+struct ohash_elem *
+ohash_replace (struct ohash *h, struct ohash_elem *new)
+{
+  size_t i = find_slot (h, new->key);
+  struct ohash_elem *old = h->slots[i];
+
+  if (old == NULL)
+    return ohash_insert (h, new);
+  h->slots[i] = new;
+  return old;
+}
+
+/* Finds and returns the element with the given KEY in hash table
+   H, or a null pointer if there is none. */
+struct ohash_elem *
+ohash_find (struct ohash *h, uintptr_t key)
+{
+  return h->slots[find_slot (h, key)];
+}
+
+/* Finds, removes, and returns the element with the given KEY in
+   hash table H.  Returns a null pointer if there was none. */
+struct ohash_elem *
+ohash_delete (struct ohash *h, uintptr_t key)
+{
+  size_t mask = h->slot_cnt - 1;
+  size_t hole = find_slot (h, key);
+  struct ohash_elem *found = h->slots[hole];
+  size_t i;
+
+  if (found == NULL)
+    return NULL;
+
+  /* Close the hole by shifting back later elements of the same
+     probe run that would not be found from their home slot with
+     the hole in the way. */
+  h->slots[hole] = NULL;
+  for (i = (hole + 1) & mask; h->slots[i] != NULL; i = (i + 1) & mask)
+    {
+      size_t home = home_slot (h->slots[i]->key, h->slot_cnt);
+      bool reachable = (hole <= i
+                        ? hole < home && home <= i
+                        : hole < home || home <= i);
+      if (!reachable)
+        {
+          h->slots[hole] = h->slots[i];
+          h->slots[i] = NULL;
+          hole = i;
+        }
+    }
+  h->elem_cnt--;
+
+  if (h->slot_cnt > h->min_slot_cnt
+      && h->elem_cnt < h->slot_cnt >> MIN_LOAD_SHIFT)
+    resize (h, h->slot_cnt / 2);
+  return found;
+}
+
+/* Calls ACTION for each element in hash table H in arbitrary
+   order.  Modifying H while ohash_apply() is running yields
+   undefined behavior. */
+void
+ohash_apply (struct ohash *h, ohash_action_func *action)
+{
+  size_t i;
+
+  ASSERT (action != NULL);
+
+  for (i = 0; i < h->slot_cnt; i++)
+    if (h->slots[i] != NULL)
+      action (h->slots[i], h->aux);
+}
+
+/* Returns the number of elements in H. */
+size_t
+ohash_size (struct ohash *h)
+{
+  return h->elem_cnt;
+}
+
+/* Returns true if H contains no elements, false otherwise. */
+bool
+ohash_empty (struct ohash *h)
+{
+  return h->elem_cnt == 0;
+}
+
+/* Rebuilds H with NEW_SLOT_CNT slots.  Returns true if
+   successful, false if memory allocation failed, in which case
+   H is unchanged. */
+static bool
+resize (struct ohash *h, size_t new_slot_cnt)
+{
+  struct ohash_elem **old_slots = h->slots;
+  size_t old_slot_cnt = h->slot_cnt;
+  size_t i;
+
+  h->slots = calloc (new_slot_cnt, sizeof *h->slots);
+  if (h->slots == NULL)
+    {
+      h->slots = old_slots;
+      return false;
+    }
+  h->slot_cnt = new_slot_cnt;
+
+  for (i = 0; i < old_slot_cnt; i++)
+    if (old_slots[i] != NULL)
+      h->slots[find_slot (h, old_slots[i]->key)] = old_slots[i];
+  free (old_slots);
+  return true;
+}
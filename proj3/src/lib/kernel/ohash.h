@@ -0,0 +1,70 @@
+#ifndef __LIB_KERNEL_OHASH_H
+#define __LIB_KERNEL_OHASH_H
+
+/* Open-addressing hash table for integer keys.
+
+   This is a variant of the hash table in hash.h for the common
+   case where elements are identified by a single integer, such
+   as a page address or a sector number.  Instead of chaining
+   elements on per-bucket lists, the table is one flat array of
+   pointers to elements, searched by linear probing, which keeps
+   a lookup to one or two cache lines and needs no hash or
+   comparison callbacks.
+
+   As with hash.h, elements are not allocated by the table:
+   each structure that can be in a table embeds a `struct
+   ohash_elem' holding its key, and ohash_entry() converts back
+   from the embedded member to the enclosing structure. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Hash element. */
+struct ohash_elem
+  {
+    uintptr_t key;              /* Key that identifies the element. */
+  };
+
+/* Converts pointer to hash element OHASH_ELEM into a pointer to
+   the structure that OHASH_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the hash element. */
+#define ohash_entry(OHASH_ELEM, STRUCT, MEMBER)                 \
+        ((STRUCT *) ((uint8_t *) &(OHASH_ELEM)->key             \
+                     - offsetof (STRUCT, MEMBER.key)))
+
+/* Performs some operation on hash element E, given auxiliary
+   data AUX. */
+typedef void ohash_action_func (struct ohash_elem *e, void *aux);
+
+/* Hash table. */
+struct ohash
+  {
+    size_t elem_cnt;            /* Number of elements in table. */
+    size_t slot_cnt;            /* Number of slots, a power of 2. */
+    size_t min_slot_cnt;        /* Never shrink below this many slots. */
+    struct ohash_elem **slots;  /* Array of `slot_cnt' element pointers. */
+    void *aux;                  /* Auxiliary data for actions. */
+  };
+
+/* Basic life cycle. */
+bool ohash_init (struct ohash *, void *aux);
+void ohash_clear (struct ohash *, ohash_action_func *);
+void ohash_destroy (struct ohash *, ohash_action_func *);
+bool ohash_reserve (struct ohash *, size_t cnt);
+
+/* Search, insertion, deletion. */
+struct ohash_elem *ohash_insert (struct ohash *, struct ohash_elem *);
+struct ohash_elem *ohash_replace (struct ohash *, struct ohash_elem *);
+struct ohash_elem *ohash_find (struct ohash *, uintptr_t key);
+struct ohash_elem *ohash_delete (struct ohash *, uintptr_t key);
+
+/* Iteration. */
+void ohash_apply (struct ohash *, ohash_action_func *);
+
+/* Information. */
+size_t ohash_size (struct ohash *);
+bool ohash_empty (struct ohash *);
+
+#endif /* lib/kernel/ohash.h */
@@ -28,7 +28,19 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_FALLOCATE,              /* Reserve disk space for a file. */
+    SYS_READV,                  /* Read from a file into several buffers. */
+    SYS_WRITEV,                 /* Write several buffers to a file. */
+    SYS_COPY_FILE_RANGE,        /* Copy bytes from one file to another. */
+    SYS_AIO_SETUP,              /* Register an asynchronous I/O ring. */
+    SYS_WAIT_FOR_COMPLETIONS,   /* Submit and reap asynchronous I/O. */
+    SYS_FSYNC,                  /* Write a file's data to disk. */
+    SYS_SYNC,                   /* Write all file system data to disk. */
+    SYS_OPEN_FLAGS,             /* Open a file with O_* flags. */
+    SYS_GETDENTS                /* Read many directory entries at once. */
   };
 
 #endif /* lib/syscall-nr.h */
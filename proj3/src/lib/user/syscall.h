@@ -1,6 +1,10 @@
 #ifndef __LIB_USER_SYSCALL_H
 #define __LIB_USER_SYSCALL_H
 
+#include <aio.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iovec.h>
 #include <stdbool.h>
 #include <debug.h>
 
@@ -45,4 +49,16 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+bool fallocate (int fd, unsigned offset, unsigned length);
+int readv (int fd, const struct iovec *, int iov_cnt);
+int writev (int fd, const struct iovec *, int iov_cnt);
+int copy_file_range (int fd_in, int fd_out, unsigned length);
+bool aio_setup (struct aio_ring *);
+int wait_for_completions (int min_complete);
+bool fsync (int fd);
+void sync (void);
+int open_flags (const char *file, int flags);
+int getdents (int fd, struct dirent *, unsigned cnt);
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,38 @@
+/* Starts asynchronous writes and exits without waiting for
+   them.  The kernel must let them finish and clean up after the
+   process without crashing. */
+
+#include <aio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define REQ_CNT 8
+
+static struct aio_ring ring;
+static char buf[AIO_MAX];
+
+void
+test_main (void) 
+{
+  const char *file_name = "abandoned";
+  int fd, i;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (aio_setup (&ring), "aio_setup");
+  for (i = 0; i < REQ_CNT; i++)
+    {
+      struct aio_sqe *sqe = &ring.sq[ring.sq_tail % AIO_RING_SIZE];
+
+      sqe->op = AIO_WRITE;
+      sqe->fd = fd;
+      sqe->buf = buf;
+      sqe->size = sizeof buf;
+      sqe->offset = i * sizeof buf;
+      sqe->user_data = i;
+      ring.sq_tail++;
+    }
+  CHECK (wait_for_completions (0) >= 0, "start %d writes", REQ_CNT);
+  msg ("exit with writes outstanding");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(aio-exit) begin
+(aio-exit) create "abandoned"
+(aio-exit) open "abandoned"
+(aio-exit) aio_setup
+(aio-exit) start 8 writes
+(aio-exit) exit with writes outstanding
+(aio-exit) end
+aio-exit: exit(0)
+EOF
+pass;
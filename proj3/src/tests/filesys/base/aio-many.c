@@ -0,0 +1,89 @@
+/* Writes a file with more asynchronous requests than the ring
+   holds at once, keeping the submission queue full and reaping
+   completions several at a time with wait_for_completions(),
+   then reads it back the same way and verifies it. */
+
+#include <aio.h>
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define REQ_CNT (AIO_RING_SIZE * 5 / 2)
+#define REQ_SIZE 512
+
+static struct aio_ring ring;
+static char buf[REQ_CNT * REQ_SIZE];
+static char got[REQ_CNT * REQ_SIZE];
+static bool done[REQ_CNT];
+
+/* Runs REQ_CNT requests of type OP on FD, request I covering
+   REQ_SIZE bytes at offset I * REQ_SIZE of the file and of DATA,
+   keeping the submission queue as full as it can be, and waits
+   for MIN_COMPLETE completions at a time. */
+static void
+run_requests (int op, int fd, char *data, int min_complete)
+{
+  int submitted = 0, completed = 0;
+
+  memset (done, 0, sizeof done);
+  while (completed < REQ_CNT)
+    {
+      int outstanding, ready;
+
+      while (submitted < REQ_CNT
+             && ring.sq_tail - ring.sq_head < AIO_RING_SIZE)
+        {
+          struct aio_sqe *sqe = &ring.sq[ring.sq_tail % AIO_RING_SIZE];
+
+          sqe->op = op;
+          sqe->fd = fd;
+          sqe->buf = data + submitted * REQ_SIZE;
+          sqe->size = REQ_SIZE;
+          sqe->offset = submitted * REQ_SIZE;
+          sqe->user_data = submitted;
+          ring.sq_tail++;
+          submitted++;
+        }
+
+      outstanding = submitted - completed;
+      ready = wait_for_completions (min_complete);
+      if (ready < min_complete && ready < outstanding)
+        fail ("wait_for_completions returned %d of %d outstanding, "
+              "expected at least %d", ready, outstanding, min_complete);
+
+      while (ring.cq_head != ring.cq_tail)
+        {
+          struct aio_cqe *cqe = &ring.cq[ring.cq_head % AIO_RING_SIZE];
+
+          if (cqe->user_data >= REQ_CNT || done[cqe->user_data])
+            fail ("unexpected completion %u", cqe->user_data);
+          if (cqe->result != REQ_SIZE)
+            fail ("request %u returned %d", cqe->user_data, cqe->result);
+          done[cqe->user_data] = true;
+          completed++;
+          ring.cq_head++;
+        }
+    }
+}
+
+void
+test_main (void) 
+{
+  const char *file_name = "async";
+  int fd;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (aio_setup (&ring), "aio_setup");
+  msg ("write \"%s\" with %d requests", file_name, REQ_CNT);
+  run_requests (AIO_WRITE, fd, buf, 4);
+  msg ("read \"%s\" with %d requests", file_name, REQ_CNT);
+  run_requests (AIO_READ, fd, got, AIO_RING_SIZE);
+  compare_bytes (got, buf, sizeof buf, 0, file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+}
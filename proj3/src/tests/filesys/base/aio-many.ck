@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(aio-many) begin
+(aio-many) create "async"
+(aio-many) open "async"
+(aio-many) aio_setup
+(aio-many) write "async" with 40 requests
+(aio-many) read "async" with 40 requests
+(aio-many) close "async"
+(aio-many) open "async" for verification
+(aio-many) verified contents of "async"
+(aio-many) close "async"
+(aio-many) end
+EOF
+pass;
@@ -0,0 +1,42 @@
+/* Copies within a single file with copy_file_range, open
+   twice.  Copying between overlapping ranges must copy nothing
+   and leave the file alone, and copying between separate ranges
+   must work. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[8000];
+
+void
+test_main (void) 
+{
+  const char *file_name = "self";
+  int in_fd, out_fd;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((in_fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK ((out_fd = open (file_name)) > 1, "open \"%s\" again", file_name);
+  CHECK (write (out_fd, buf, sizeof buf) == sizeof buf,
+         "write \"%s\"", file_name);
+
+  msg ("seek to 1000 and 3000");
+  seek (in_fd, 1000);
+  seek (out_fd, 3000);
+  CHECK (copy_file_range (in_fd, out_fd, 2500) == 0,
+         "copy between overlapping ranges");
+  CHECK (tell (in_fd) == 1000 && tell (out_fd) == 3000,
+         "positions unchanged");
+  CHECK (copy_file_range (in_fd, out_fd, 2000) == 2000,
+         "copy between adjacent ranges");
+  memmove (buf + 3000, buf + 1000, 2000);
+  msg ("close \"%s\"", file_name);
+  close (in_fd);
+  msg ("close \"%s\"", file_name);
+  close (out_fd);
+  check_file (file_name, buf, sizeof buf);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(copy-overlap) begin
+(copy-overlap) create "self"
+(copy-overlap) open "self"
+(copy-overlap) open "self" again
+(copy-overlap) write "self"
+(copy-overlap) seek to 1000 and 3000
+(copy-overlap) copy between overlapping ranges
+(copy-overlap) positions unchanged
+(copy-overlap) copy between adjacent ranges
+(copy-overlap) close "self"
+(copy-overlap) close "self"
+(copy-overlap) open "self" for verification
+(copy-overlap) verified contents of "self"
+(copy-overlap) close "self"
+(copy-overlap) end
+EOF
+pass;
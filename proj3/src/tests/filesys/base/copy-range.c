@@ -0,0 +1,59 @@
+/* Copies between two files with copy_file_range, the whole of
+   one into a new file as the cp example does and then a range
+   from the middle of one into the middle of the other, and
+   verifies the results and the file positions. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char src_buf[10000];
+static char dst_buf[10000];
+
+void
+test_main (void) 
+{
+  int src_fd, dst_fd;
+
+  random_bytes (src_buf, sizeof src_buf);
+  CHECK (create ("src", 0), "create \"src\"");
+  CHECK ((src_fd = open ("src")) > 1, "open \"src\"");
+  CHECK (write (src_fd, src_buf, sizeof src_buf) == sizeof src_buf,
+         "write \"src\"");
+  msg ("close \"src\"");
+  close (src_fd);
+
+  /* Copy the way cp does. */
+  CHECK ((src_fd = open ("src")) > 1, "open \"src\"");
+  CHECK (create ("dst", filesize (src_fd)), "create \"dst\"");
+  CHECK ((dst_fd = open ("dst")) > 1, "open \"dst\"");
+  CHECK (copy_file_range (src_fd, dst_fd, filesize (src_fd))
+         == filesize (src_fd), "copy \"src\" to \"dst\"");
+  CHECK (tell (src_fd) == sizeof src_buf && tell (dst_fd) == sizeof src_buf,
+         "positions advanced");
+  CHECK (copy_file_range (src_fd, dst_fd, 100) == 0,
+         "copy at end of \"src\"");
+  msg ("close \"dst\"");
+  close (dst_fd);
+  check_file ("dst", src_buf, sizeof src_buf);
+
+  /* Copy from the middle of one file into the middle of another,
+     running off the end of the source. */
+  random_bytes (dst_buf, sizeof dst_buf);
+  CHECK ((dst_fd = open ("dst")) > 1, "open \"dst\"");
+  CHECK (write (dst_fd, dst_buf, sizeof dst_buf) == sizeof dst_buf,
+         "write \"dst\"");
+  msg ("seek \"src\" to 7000, \"dst\" to 1234");
+  seek (src_fd, 7000);
+  seek (dst_fd, 1234);
+  CHECK (copy_file_range (src_fd, dst_fd, 5000) == 3000,
+         "copy 5000 bytes of \"src\" to \"dst\"");
+  memcpy (dst_buf + 1234, src_buf + 7000, 3000);
+  msg ("close \"src\"");
+  close (src_fd);
+  msg ("close \"dst\"");
+  close (dst_fd);
+  check_file ("dst", dst_buf, sizeof dst_buf);
+}
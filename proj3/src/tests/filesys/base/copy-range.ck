@@ -0,0 +1,32 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(copy-range) begin
+(copy-range) create "src"
+(copy-range) open "src"
+(copy-range) write "src"
+(copy-range) close "src"
+(copy-range) open "src"
+(copy-range) create "dst"
+(copy-range) open "dst"
+(copy-range) copy "src" to "dst"
+(copy-range) positions advanced
+(copy-range) copy at end of "src"
+(copy-range) close "dst"
+(copy-range) open "dst" for verification
+(copy-range) verified contents of "dst"
+(copy-range) close "dst"
+(copy-range) open "dst"
+(copy-range) write "dst"
+(copy-range) seek "src" to 7000, "dst" to 1234
+(copy-range) copy 5000 bytes of "src" to "dst"
+(copy-range) close "src"
+(copy-range) close "dst"
+(copy-range) open "dst" for verification
+(copy-range) verified contents of "dst"
+(copy-range) close "dst"
+(copy-range) end
+EOF
+pass;
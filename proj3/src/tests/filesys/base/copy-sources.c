@@ -0,0 +1,75 @@
+/* Copies with copy_file_range from sources whose data is not in
+   ordinary disk blocks: a small file stored inside its inode, a
+   file whose appended data is still in its delay buffer, and a
+   sparse file, copying across the hole. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[9000];
+
+/* Copies all of the file open as SRC_FD, SIZE bytes long,
+   starting at its current position, into a new file named
+   DST_NAME, and verifies that it matches EXPECTED. */
+static void
+copy_and_check (int src_fd, const char *dst_name, const char *expected,
+                size_t size)
+{
+  int dst_fd;
+
+  CHECK (create (dst_name, 0), "create \"%s\"", dst_name);
+  CHECK ((dst_fd = open (dst_name)) > 1, "open \"%s\"", dst_name);
+  CHECK (copy_file_range (src_fd, dst_fd, size) == (int) size,
+         "copy %zu bytes to \"%s\"", size, dst_name);
+  msg ("close \"%s\"", dst_name);
+  close (dst_fd);
+  check_file (dst_name, expected, size);
+}
+
+void
+test_main (void) 
+{
+  int fd;
+
+  /* Stored in the inode. */
+  random_bytes (buf, sizeof buf);
+  CHECK (create ("inline", 0), "create \"inline\"");
+  CHECK ((fd = open ("inline")) > 1, "open \"inline\"");
+  CHECK (write (fd, buf, 200) == 200, "write 200 bytes to \"inline\"");
+  msg ("seek \"inline\" to 0");
+  seek (fd, 0);
+  copy_and_check (fd, "copy1", buf, 200);
+  msg ("close \"inline\"");
+  close (fd);
+
+  /* Appended, and still in the delay buffer. */
+  CHECK (create ("delayed", 0), "create \"delayed\"");
+  CHECK ((fd = open ("delayed")) > 1, "open \"delayed\"");
+  CHECK (write (fd, buf, 3000) == 3000, "write 3000 bytes to \"delayed\"");
+  CHECK (write (fd, buf + 3000, 1000) == 1000,
+         "write 1000 bytes to \"delayed\"");
+  msg ("seek \"delayed\" to 0");
+  seek (fd, 0);
+  copy_and_check (fd, "copy2", buf, 4000);
+  msg ("close \"delayed\"");
+  close (fd);
+
+  /* Sparse, with a hole from 1000 to 8000. */
+  memset (buf + 1000, 0, 7000);
+  CHECK (create ("sparse", 0), "create \"sparse\"");
+  CHECK ((fd = open ("sparse")) > 1, "open \"sparse\"");
+  CHECK (write (fd, buf, 1000) == 1000, "write 1000 bytes to \"sparse\"");
+  msg ("seek \"sparse\" to 8000");
+  seek (fd, 8000);
+  CHECK (write (fd, buf + 8000, 1000) == 1000,
+         "write 1000 bytes to \"sparse\"");
+  msg ("close \"sparse\"");
+  close (fd);
+  CHECK ((fd = open ("sparse")) > 1, "open \"sparse\"");
+  copy_and_check (fd, "copy3", buf, sizeof buf);
+  msg ("close \"sparse\"");
+  close (fd);
+}
@@ -0,0 +1,49 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(copy-sources) begin
+(copy-sources) create "inline"
+(copy-sources) open "inline"
+(copy-sources) write 200 bytes to "inline"
+(copy-sources) seek "inline" to 0
+(copy-sources) create "copy1"
+(copy-sources) open "copy1"
+(copy-sources) copy 200 bytes to "copy1"
+(copy-sources) close "copy1"
+(copy-sources) open "copy1" for verification
+(copy-sources) verified contents of "copy1"
+(copy-sources) close "copy1"
+(copy-sources) close "inline"
+(copy-sources) create "delayed"
+(copy-sources) open "delayed"
+(copy-sources) write 3000 bytes to "delayed"
+(copy-sources) write 1000 bytes to "delayed"
+(copy-sources) seek "delayed" to 0
+(copy-sources) create "copy2"
+(copy-sources) open "copy2"
+(copy-sources) copy 4000 bytes to "copy2"
+(copy-sources) close "copy2"
+(copy-sources) open "copy2" for verification
+(copy-sources) verified contents of "copy2"
+(copy-sources) close "copy2"
+(copy-sources) close "delayed"
+(copy-sources) create "sparse"
+(copy-sources) open "sparse"
+(copy-sources) write 1000 bytes to "sparse"
+(copy-sources) seek "sparse" to 8000
+(copy-sources) write 1000 bytes to "sparse"
+(copy-sources) close "sparse"
+(copy-sources) open "sparse"
+(copy-sources) create "copy3"
+(copy-sources) open "copy3"
+(copy-sources) copy 9000 bytes to "copy3"
+(copy-sources) close "copy3"
+(copy-sources) open "copy3" for verification
+(copy-sources) verified contents of "copy3"
+(copy-sources) close "copy3"
+(copy-sources) close "sparse"
+(copy-sources) end
+EOF
+pass;
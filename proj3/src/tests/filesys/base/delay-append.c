@@ -0,0 +1,37 @@
+/* Appends to a file in small writes, which the file system
+   holds in a delay buffer instead of allocating disk space for
+   each, and verifies the data both through the same descriptor
+   while it is still buffered and after the last close has
+   written it out. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PIECE 300
+
+static char buf[9000];
+
+void
+test_main (void) 
+{
+  const char *file_name = "appended";
+  size_t ofs;
+  int fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf, sizeof buf);
+  msg ("append to \"%s\" in %d-byte writes", file_name, PIECE);
+  for (ofs = 0; ofs < sizeof buf; ofs += PIECE)
+    if (write (fd, buf + ofs, PIECE) != PIECE)
+      fail ("write %d bytes at offset %zu in \"%s\" failed",
+            PIECE, ofs, file_name);
+  msg ("seek \"%s\" to 0", file_name);
+  seek (fd, 0);
+  check_file_handle (fd, file_name, buf, sizeof buf);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(delay-append) begin
+(delay-append) create "appended"
+(delay-append) open "appended"
+(delay-append) append to "appended" in 300-byte writes
+(delay-append) seek "appended" to 0
+(delay-append) verified contents of "appended"
+(delay-append) close "appended"
+(delay-append) open "appended" for verification
+(delay-append) verified contents of "appended"
+(delay-append) close "appended"
+(delay-append) end
+EOF
+pass;
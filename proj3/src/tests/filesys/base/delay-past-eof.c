@@ -0,0 +1,46 @@
+/* Appends to a file, so that the data is held in a delay
+   buffer, then writes past end of file while the buffer is
+   live, and into the gap that leaves, and verifies that the
+   gap reads as zeros and no data is lost or misplaced. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[6000];
+
+void
+test_main (void) 
+{
+  const char *file_name = "gappy";
+  int fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf, sizeof buf);
+
+  CHECK (write (fd, buf, 1000) == 1000, "write 1000 bytes to \"%s\"",
+         file_name);
+  msg ("seek \"%s\" to 5000", file_name);
+  seek (fd, 5000);
+  CHECK (write (fd, buf + 5000, 1000) == 1000, "write 1000 bytes to \"%s\"",
+         file_name);
+  memset (buf + 1000, 0, 4000);
+  msg ("seek \"%s\" to 0", file_name);
+  seek (fd, 0);
+  check_file_handle (fd, file_name, buf, sizeof buf);
+
+  random_bytes (buf + 2000, 500);
+  msg ("seek \"%s\" to 2000", file_name);
+  seek (fd, 2000);
+  CHECK (write (fd, buf + 2000, 500) == 500, "write 500 bytes to \"%s\"",
+         file_name);
+  msg ("seek \"%s\" to 0", file_name);
+  seek (fd, 0);
+  check_file_handle (fd, file_name, buf, sizeof buf);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+}
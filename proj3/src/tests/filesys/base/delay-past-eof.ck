@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(delay-past-eof) begin
+(delay-past-eof) create "gappy"
+(delay-past-eof) open "gappy"
+(delay-past-eof) write 1000 bytes to "gappy"
+(delay-past-eof) seek "gappy" to 5000
+(delay-past-eof) write 1000 bytes to "gappy"
+(delay-past-eof) seek "gappy" to 0
+(delay-past-eof) verified contents of "gappy"
+(delay-past-eof) seek "gappy" to 2000
+(delay-past-eof) write 500 bytes to "gappy"
+(delay-past-eof) seek "gappy" to 0
+(delay-past-eof) verified contents of "gappy"
+(delay-past-eof) close "gappy"
+(delay-past-eof) open "gappy" for verification
+(delay-past-eof) verified contents of "gappy"
+(delay-past-eof) close "gappy"
+(delay-past-eof) end
+EOF
+pass;
@@ -0,0 +1,17 @@
+/* Tries to read from a directory with the read system call.
+   The process must be terminated with -1 exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[16];
+  int fd;
+
+  CHECK ((fd = open ("/")) > 1, "open \"/\"");
+  read (fd, buf, sizeof buf);
+  fail ("should not have survived read()");
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(dir-read) begin
+(dir-read) open "/"
+dir-read: exit(-1)
+EOF
+pass;
@@ -0,0 +1,17 @@
+/* Tries to write to a directory with the write system call.
+   The process must be terminated with -1 exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[16] = "scribble";
+  int fd;
+
+  CHECK ((fd = open ("/")) > 1, "open \"/\"");
+  write (fd, buf, sizeof buf);
+  fail ("should not have survived write()");
+}
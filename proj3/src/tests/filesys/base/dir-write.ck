@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(dir-write) begin
+(dir-write) open "/"
+dir-write: exit(-1)
+EOF
+pass;
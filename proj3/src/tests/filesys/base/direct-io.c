@@ -0,0 +1,87 @@
+/* Writes and reads a file opened with O_DIRECT, first whole
+   sectors from page-aligned buffers, while the same file is also
+   open for ordinary, cached access.  Then mixes unaligned direct
+   transfers with cached ones, and verifies that each kind of
+   access sees the other's data. */
+
+#include <fcntl.h>
+#include <random.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE 8192
+
+static char raw[SIZE * 2 + 4096];
+static char expected[SIZE];
+
+void
+test_main (void) 
+{
+  const char *file_name = "direct";
+  char *out = (char *) ROUND_UP ((uintptr_t) raw, 4096);
+  char *in = out + SIZE;
+  int dfd, bfd;
+
+  random_bytes (out, SIZE);
+  memcpy (expected, out, SIZE);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((dfd = open_flags (file_name, O_DIRECT)) > 1,
+         "open \"%s\" for direct I/O", file_name);
+  CHECK (write (dfd, out, SIZE) == SIZE,
+         "write %d bytes to \"%s\" directly", SIZE, file_name);
+  msg ("seek \"%s\" to 0", file_name);
+  seek (dfd, 0);
+  CHECK (read (dfd, in, SIZE) == SIZE,
+         "read %d bytes from \"%s\" directly", SIZE, file_name);
+  compare_bytes (in, expected, SIZE, 0, file_name);
+
+  /* Bring the file into the caches, then overwrite part of it
+     directly. */
+  CHECK ((bfd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (read (bfd, in, SIZE) == SIZE,
+         "read %d bytes from \"%s\" through the cache", SIZE, file_name);
+  random_bytes (out, 1024);
+  memcpy (expected + 2048, out, 1024);
+  msg ("seek \"%s\" to 2048", file_name);
+  seek (dfd, 2048);
+  CHECK (write (dfd, out, 1024) == 1024,
+         "write 1024 bytes to \"%s\" directly", file_name);
+  msg ("seek \"%s\" to 0", file_name);
+  seek (bfd, 0);
+  CHECK (read (bfd, in, SIZE) == SIZE,
+         "read %d bytes from \"%s\" through the cache", SIZE, file_name);
+  compare_bytes (in, expected, SIZE, 0, file_name);
+
+  /* Mix unaligned direct and cached transfers. */
+  random_bytes (out, 3000);
+  memcpy (expected + 100, out + 3, 700);
+  msg ("seek \"%s\" to 100", file_name);
+  seek (dfd, 100);
+  CHECK (write (dfd, out + 3, 700) == 700,
+         "write 700 bytes to \"%s\" directly", file_name);
+  memcpy (expected + 5000, out + 1000, 1500);
+  msg ("seek \"%s\" to 5000", file_name);
+  seek (bfd, 5000);
+  CHECK (write (bfd, out + 1000, 1500) == 1500,
+         "write 1500 bytes to \"%s\" through the cache", file_name);
+  msg ("seek \"%s\" to 4900", file_name);
+  seek (dfd, 4900);
+  CHECK (read (dfd, in + 1, 2000) == 2000,
+         "read 2000 bytes from \"%s\" directly", file_name);
+  compare_bytes (in + 1, expected + 4900, 2000, 4900, file_name);
+  msg ("seek \"%s\" to 0", file_name);
+  seek (bfd, 0);
+  CHECK (read (bfd, in, 1000) == 1000,
+         "read 1000 bytes from \"%s\" through the cache", file_name);
+  compare_bytes (in, expected, 1000, 0, file_name);
+
+  msg ("close \"%s\"", file_name);
+  close (dfd);
+  msg ("close \"%s\"", file_name);
+  close (bfd);
+  check_file (file_name, expected, SIZE);
+}
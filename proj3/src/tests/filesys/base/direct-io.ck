@@ -0,0 +1,33 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(direct-io) begin
+(direct-io) create "direct"
+(direct-io) open "direct" for direct I/O
+(direct-io) write 8192 bytes to "direct" directly
+(direct-io) seek "direct" to 0
+(direct-io) read 8192 bytes from "direct" directly
+(direct-io) open "direct"
+(direct-io) read 8192 bytes from "direct" through the cache
+(direct-io) seek "direct" to 2048
+(direct-io) write 1024 bytes to "direct" directly
+(direct-io) seek "direct" to 0
+(direct-io) read 8192 bytes from "direct" through the cache
+(direct-io) seek "direct" to 100
+(direct-io) write 700 bytes to "direct" directly
+(direct-io) seek "direct" to 5000
+(direct-io) write 1500 bytes to "direct" through the cache
+(direct-io) seek "direct" to 4900
+(direct-io) read 2000 bytes from "direct" directly
+(direct-io) seek "direct" to 0
+(direct-io) read 1000 bytes from "direct" through the cache
+(direct-io) close "direct"
+(direct-io) close "direct"
+(direct-io) open "direct" for verification
+(direct-io) verified contents of "direct"
+(direct-io) close "direct"
+(direct-io) end
+EOF
+pass;
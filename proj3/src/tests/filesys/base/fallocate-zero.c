@@ -0,0 +1,37 @@
+/* Preallocates space with fallocate, extending the file, and
+   verifies that the preallocated range reads back as zeros,
+   before and after writing into the middle of it and
+   preallocating again past its end. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[20000];
+
+void
+test_main (void) 
+{
+  const char *file_name = "prealloc";
+  int fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (fallocate (fd, 0, 12000), "fallocate 12000 bytes at offset 0");
+  CHECK (filesize (fd) == 12000, "filesize \"%s\" is 12000", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, 12000);
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf + 3000, 5000);
+  msg ("seek \"%s\" to 3000", file_name);
+  seek (fd, 3000);
+  CHECK (write (fd, buf + 3000, 5000) == 5000,
+         "write 5000 bytes to \"%s\"", file_name);
+  CHECK (fallocate (fd, 16000, 4000), "fallocate 4000 bytes at offset 16000");
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+}
@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fallocate-zero) begin
+(fallocate-zero) create "prealloc"
+(fallocate-zero) open "prealloc"
+(fallocate-zero) fallocate 12000 bytes at offset 0
+(fallocate-zero) filesize "prealloc" is 12000
+(fallocate-zero) close "prealloc"
+(fallocate-zero) open "prealloc" for verification
+(fallocate-zero) verified contents of "prealloc"
+(fallocate-zero) close "prealloc"
+(fallocate-zero) open "prealloc"
+(fallocate-zero) seek "prealloc" to 3000
+(fallocate-zero) write 5000 bytes to "prealloc"
+(fallocate-zero) fallocate 4000 bytes at offset 16000
+(fallocate-zero) close "prealloc"
+(fallocate-zero) open "prealloc" for verification
+(fallocate-zero) verified contents of "prealloc"
+(fallocate-zero) close "prealloc"
+(fallocate-zero) end
+EOF
+pass;
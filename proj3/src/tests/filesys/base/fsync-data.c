@@ -0,0 +1,44 @@
+/* Writes files, including one whose appended data is still in
+   its delay buffer and one that is empty, forces them to disk
+   with fsync and sync, and verifies that both calls return and
+   leave the data readable. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[7000];
+
+void
+test_main (void) 
+{
+  int fd, empty_fd;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create ("synced", 0), "create \"synced\"");
+  CHECK ((fd = open ("synced")) > 1, "open \"synced\"");
+  CHECK (write (fd, buf, 5000) == 5000, "write 5000 bytes to \"synced\"");
+  CHECK (fsync (fd), "fsync \"synced\"");
+  CHECK (write (fd, buf + 5000, 2000) == 2000,
+         "write 2000 bytes to \"synced\"");
+  CHECK (fsync (fd), "fsync \"synced\"");
+  check_file ("synced", buf, sizeof buf);
+
+  CHECK (create ("empty", 0), "create \"empty\"");
+  CHECK ((empty_fd = open ("empty")) > 1, "open \"empty\"");
+  CHECK (fsync (empty_fd), "fsync \"empty\"");
+  CHECK (filesize (empty_fd) == 0, "filesize \"empty\" is 0");
+  msg ("close \"empty\"");
+  close (empty_fd);
+
+  random_bytes (buf, 3000);
+  msg ("seek \"synced\" to 0");
+  seek (fd, 0);
+  CHECK (write (fd, buf, 3000) == 3000, "write 3000 bytes to \"synced\"");
+  msg ("sync");
+  sync ();
+  check_file ("synced", buf, sizeof buf);
+  msg ("close \"synced\"");
+  close (fd);
+}
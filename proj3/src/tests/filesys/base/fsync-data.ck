@@ -0,0 +1,30 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fsync-data) begin
+(fsync-data) create "synced"
+(fsync-data) open "synced"
+(fsync-data) write 5000 bytes to "synced"
+(fsync-data) fsync "synced"
+(fsync-data) write 2000 bytes to "synced"
+(fsync-data) fsync "synced"
+(fsync-data) open "synced" for verification
+(fsync-data) verified contents of "synced"
+(fsync-data) close "synced"
+(fsync-data) create "empty"
+(fsync-data) open "empty"
+(fsync-data) fsync "empty"
+(fsync-data) filesize "empty" is 0
+(fsync-data) close "empty"
+(fsync-data) seek "synced" to 0
+(fsync-data) write 3000 bytes to "synced"
+(fsync-data) sync
+(fsync-data) open "synced" for verification
+(fsync-data) verified contents of "synced"
+(fsync-data) close "synced"
+(fsync-data) close "synced"
+(fsync-data) end
+EOF
+pass;
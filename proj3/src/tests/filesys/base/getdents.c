@@ -0,0 +1,125 @@
+/* Creates more files than getdents gathers in one batch in the
+   kernel and lists the root directory with getdents, a few
+   entries per call and then all at once, verifying that each
+   file appears once with the right size, type, and inode
+   number.  Also checks isdir and inumber on the directory, and
+   that getdents refuses an ordinary file. */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 40
+
+static int inumbers[FILE_CNT];
+static bool seen[FILE_CNT];
+static struct dirent entries[FILE_CNT * 2];
+
+/* Returns the index of the file created as NAME, or -1 if NAME
+   is not one of them. */
+static int
+file_index (const char *name)
+{
+  int i;
+
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      char file_name[16];
+
+      snprintf (file_name, sizeof file_name, "f%d", i);
+      if (!strcmp (name, file_name))
+        return i;
+    }
+  return -1;
+}
+
+/* Checks the CNT entries in ENTRIES and marks the files among
+   them as seen. */
+static void
+check_entries (const struct dirent *e, int cnt)
+{
+  for (; cnt > 0; e++, cnt--)
+    {
+      int i = file_index (e->name);
+
+      if (e->type != DT_REG)
+        fail ("\"%s\" has type %d", e->name, e->type);
+      if (i < 0)
+        continue;
+      if (seen[i])
+        fail ("\"%s\" listed twice", e->name);
+      seen[i] = true;
+      if (e->size != (unsigned) i * 37)
+        fail ("\"%s\" has size %u, expected %d", e->name, e->size, i * 37);
+      if (e->inumber != inumbers[i])
+        fail ("\"%s\" has inode number %d, expected %d",
+              e->name, e->inumber, inumbers[i]);
+    }
+}
+
+/* Checks that every file has been seen, and forgets them. */
+static void
+check_all_seen (void)
+{
+  int i;
+
+  for (i = 0; i < FILE_CNT; i++)
+    if (!seen[i])
+      fail ("\"f%d\" not listed", i);
+  memset (seen, 0, sizeof seen);
+}
+
+void
+test_main (void) 
+{
+  int dir_fd, fd, cnt, total, i;
+
+  msg ("create %d files", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      char file_name[16];
+
+      snprintf (file_name, sizeof file_name, "f%d", i);
+      if (!create (file_name, i * 37))
+        fail ("create \"%s\" failed", file_name);
+      fd = open (file_name);
+      if (fd < 2)
+        fail ("open \"%s\" failed", file_name);
+      inumbers[i] = inumber (fd);
+      close (fd);
+    }
+
+  CHECK ((dir_fd = open ("/")) > 1, "open \"/\"");
+  CHECK (isdir (dir_fd), "isdir \"/\"");
+  CHECK (inumber (dir_fd) != inumbers[0], "inumber \"/\"");
+  msg ("getdents 7 entries at a time");
+  total = 0;
+  while ((cnt = getdents (dir_fd, entries, 7)) > 0)
+    {
+      if (cnt > 7)
+        fail ("getdents returned %d entries, expected at most 7", cnt);
+      check_entries (entries, cnt);
+      total += cnt;
+    }
+  CHECK (cnt == 0, "getdents at end of \"/\"");
+  check_all_seen ();
+  msg ("close \"/\"");
+  close (dir_fd);
+
+  CHECK ((dir_fd = open ("/")) > 1, "open \"/\"");
+  cnt = getdents (dir_fd, entries, FILE_CNT * 2);
+  CHECK (cnt == total, "getdents all entries at once");
+  check_entries (entries, cnt);
+  check_all_seen ();
+  msg ("close \"/\"");
+  close (dir_fd);
+
+  CHECK ((fd = open ("f1")) > 1, "open \"f1\"");
+  CHECK (!isdir (fd), "isdir \"f1\" is false");
+  CHECK (getdents (fd, entries, 1) == -1, "getdents \"f1\" fails");
+  msg ("close \"f1\"");
+  close (fd);
+}
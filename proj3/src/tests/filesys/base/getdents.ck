@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(getdents) begin
+(getdents) create 40 files
+(getdents) open "/"
+(getdents) isdir "/"
+(getdents) inumber "/"
+(getdents) getdents 7 entries at a time
+(getdents) getdents at end of "/"
+(getdents) close "/"
+(getdents) open "/"
+(getdents) getdents all entries at once
+(getdents) close "/"
+(getdents) open "f1"
+(getdents) isdir "f1" is false
+(getdents) getdents "f1" fails
+(getdents) close "f1"
+(getdents) end
+EOF
+pass;
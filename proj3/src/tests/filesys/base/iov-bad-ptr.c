@@ -0,0 +1,26 @@
+/* Passes readv a buffer in kernel memory.
+   The process must be terminated with -1 exit code. */
+
+#include <iovec.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[100];
+
+void
+test_main (void) 
+{
+  const char *file_name = "target";
+  struct iovec iov[2];
+  int fd;
+
+  CHECK (create (file_name, sizeof buf), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  iov[0].iov_base = buf;
+  iov[0].iov_len = sizeof buf;
+  iov[1].iov_base = (char *) 0xc0100000;
+  iov[1].iov_len = 123;
+  readv (fd, iov, 2);
+  fail ("should not have survived readv()");
+}
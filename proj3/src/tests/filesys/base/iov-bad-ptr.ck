@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(iov-bad-ptr) begin
+(iov-bad-ptr) create "target"
+(iov-bad-ptr) open "target"
+iov-bad-ptr: exit(-1)
+EOF
+pass;
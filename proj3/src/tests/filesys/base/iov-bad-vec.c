@@ -0,0 +1,19 @@
+/* Passes writev a vector of buffers that is not in user memory.
+   The process must be terminated with -1 exit code. */
+
+#include <iovec.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  const char *file_name = "target";
+  int fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  writev (fd, (struct iovec *) 0xc0100000, 2);
+  fail ("should not have survived writev()");
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(iov-bad-vec) begin
+(iov-bad-vec) create "target"
+(iov-bad-vec) open "target"
+iov-bad-vec: exit(-1)
+EOF
+pass;
@@ -0,0 +1,51 @@
+/* Reads with readv past end of file, and verifies that the
+   read comes up short, filling the buffers in order and leaving
+   those past end of file untouched. */
+
+#include <iovec.h>
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[1000];
+static char got[1800];
+static char untouched[1800];
+
+void
+test_main (void) 
+{
+  const char *file_name = "short";
+  struct iovec iov[3];
+  int fd;
+
+  random_bytes (buf, sizeof buf);
+  memset (got, 0x5a, sizeof got);
+  memset (untouched, 0x5a, sizeof untouched);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf,
+         "write %zu bytes to \"%s\"", sizeof buf, file_name);
+
+  iov[0].iov_base = got;
+  iov[0].iov_len = 600;
+  iov[1].iov_base = got + 600;
+  iov[1].iov_len = 600;
+  iov[2].iov_base = got + 1200;
+  iov[2].iov_len = 600;
+  msg ("seek \"%s\" to 0", file_name);
+  seek (fd, 0);
+  CHECK (readv (fd, iov, 3) == 1000, "readv 1800 bytes from \"%s\"",
+         file_name);
+  compare_bytes (got, buf, 1000, 0, file_name);
+  compare_bytes (got + 1000, untouched, 800, 1000, file_name);
+
+  msg ("seek \"%s\" to 400", file_name);
+  seek (fd, 400);
+  CHECK (readv (fd, iov, 3) == 600, "readv 1800 bytes from \"%s\"",
+         file_name);
+  CHECK (readv (fd, iov, 3) == 0, "readv at end of \"%s\"", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
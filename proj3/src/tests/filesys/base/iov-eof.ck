@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(iov-eof) begin
+(iov-eof) create "short"
+(iov-eof) open "short"
+(iov-eof) write 1000 bytes to "short"
+(iov-eof) seek "short" to 0
+(iov-eof) readv 1800 bytes from "short"
+(iov-eof) seek "short" to 400
+(iov-eof) readv 1800 bytes from "short"
+(iov-eof) readv at end of "short"
+(iov-eof) close "short"
+(iov-eof) end
+EOF
+pass;
@@ -0,0 +1,54 @@
+/* Writes and reads back a file with the most buffers readv and
+   writev accept, each a page long but not page-aligned, so that
+   together they cover more user pages than the kernel pins at
+   once and it has to transfer them in several batches. */
+
+#include <iovec.h>
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+
+static char buf[IOV_MAX * PAGE + 100];
+static char got[IOV_MAX * PAGE + 100];
+
+/* Points the IOV_MAX entries of IOV at consecutive pages of BASE,
+   starting 100 bytes in. */
+static void
+fill_iov (struct iovec *iov, char *base)
+{
+  int i;
+
+  for (i = 0; i < IOV_MAX; i++)
+    {
+      iov[i].iov_base = base + 100 + i * PAGE;
+      iov[i].iov_len = PAGE;
+    }
+}
+
+void
+test_main (void) 
+{
+  const char *file_name = "many";
+  struct iovec iov[IOV_MAX];
+  int fd;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  fill_iov (iov, buf);
+  CHECK (writev (fd, iov, IOV_MAX) == IOV_MAX * PAGE,
+         "writev %d pages to \"%s\"", IOV_MAX, file_name);
+  msg ("seek \"%s\" to 0", file_name);
+  seek (fd, 0);
+  fill_iov (iov, got);
+  CHECK (readv (fd, iov, IOV_MAX) == IOV_MAX * PAGE,
+         "readv %d pages from \"%s\"", IOV_MAX, file_name);
+  compare_bytes (got + 100, buf + 100, IOV_MAX * PAGE, 0, file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf + 100, IOV_MAX * PAGE);
+}
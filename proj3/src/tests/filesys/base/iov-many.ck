@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(iov-many) begin
+(iov-many) create "many"
+(iov-many) open "many"
+(iov-many) writev 16 pages to "many"
+(iov-many) seek "many" to 0
+(iov-many) readv 16 pages from "many"
+(iov-many) close "many"
+(iov-many) open "many" for verification
+(iov-many) verified contents of "many"
+(iov-many) close "many"
+(iov-many) end
+EOF
+pass;
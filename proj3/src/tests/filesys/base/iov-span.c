@@ -0,0 +1,55 @@
+/* Writes a file with writev from several buffers, out of order
+   in memory and each crossing page boundaries, then reads it
+   back with readv split differently, and verifies both. */
+
+#include <iovec.h>
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[12000];
+static char expected[12000];
+static char got[12000];
+
+void
+test_main (void) 
+{
+  const char *file_name = "vector";
+  struct iovec out[3], in[4];
+  int fd;
+
+  random_bytes (buf, sizeof buf);
+  out[0].iov_base = buf + 7000;
+  out[0].iov_len = 5000;
+  out[1].iov_base = buf + 100;
+  out[1].iov_len = 4500;
+  out[2].iov_base = buf + 4600;
+  out[2].iov_len = 2400;
+  memcpy (expected, buf + 7000, 5000);
+  memcpy (expected + 5000, buf + 100, 4500);
+  memcpy (expected + 9500, buf + 4600, 2400);
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (writev (fd, out, 3) == 11900, "writev 11900 bytes to \"%s\"",
+         file_name);
+
+  in[0].iov_base = got;
+  in[0].iov_len = 7;
+  in[1].iov_base = got + 7;
+  in[1].iov_len = 8190;
+  in[2].iov_base = got + 8197;
+  in[2].iov_len = 1;
+  in[3].iov_base = got + 8198;
+  in[3].iov_len = 3702;
+  msg ("seek \"%s\" to 0", file_name);
+  seek (fd, 0);
+  CHECK (readv (fd, in, 4) == 11900, "readv 11900 bytes from \"%s\"",
+         file_name);
+  compare_bytes (got, expected, 11900, 0, file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, expected, 11900);
+}
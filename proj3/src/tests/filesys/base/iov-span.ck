@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(iov-span) begin
+(iov-span) create "vector"
+(iov-span) open "vector"
+(iov-span) writev 11900 bytes to "vector"
+(iov-span) seek "vector" to 0
+(iov-span) readv 11900 bytes from "vector"
+(iov-span) close "vector"
+(iov-span) open "vector" for verification
+(iov-span) verified contents of "vector"
+(iov-span) close "vector"
+(iov-span) end
+EOF
+pass;
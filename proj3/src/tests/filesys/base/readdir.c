@@ -0,0 +1,54 @@
+/* Creates files and lists the root directory with readdir,
+   verifying that each file appears once, and that readdir
+   refuses an ordinary file. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 20
+
+static bool seen[FILE_CNT];
+
+void
+test_main (void) 
+{
+  char name[READDIR_MAX_LEN + 1];
+  int dir_fd, fd, i;
+
+  msg ("create %d files", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      char file_name[16];
+
+      snprintf (file_name, sizeof file_name, "file%d", i);
+      if (!create (file_name, i))
+        fail ("create \"%s\" failed", file_name);
+    }
+
+  CHECK ((dir_fd = open (".")) > 1, "open \".\"");
+  CHECK (isdir (dir_fd), "isdir \".\"");
+  msg ("readdir \".\"");
+  while (readdir (dir_fd, name))
+    {
+      if (memcmp (name, "file", 4))
+        continue;
+      i = atoi (name + 4);
+      if (i < 0 || i >= FILE_CNT || seen[i])
+        fail ("unexpected entry \"%s\"", name);
+      seen[i] = true;
+    }
+  for (i = 0; i < FILE_CNT; i++)
+    if (!seen[i])
+      fail ("\"file%d\" not listed", i);
+  msg ("close \".\"");
+  close (dir_fd);
+
+  CHECK ((fd = open ("file3")) > 1, "open \"file3\"");
+  CHECK (!readdir (fd, name), "readdir \"file3\" fails");
+  msg ("close \"file3\"");
+  close (fd);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(readdir) begin
+(readdir) create 20 files
+(readdir) open "."
+(readdir) isdir "."
+(readdir) readdir "."
+(readdir) close "."
+(readdir) open "file3"
+(readdir) readdir "file3" fails
+(readdir) close "file3"
+(readdir) end
+EOF
+pass;
@@ -0,0 +1,91 @@
+/* Writes a single byte a megabyte into each of several files,
+   so that together they are bigger than the whole disk, and
+   verifies that the gaps read back as zeros.  The gaps are
+   holes that take no disk space, so a dense file written
+   afterward must still fit. */
+
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SPARSE_CNT 4
+#define SPARSE_OFS (1024 * 1024)
+#define DENSE_SIZE (512 * 1024)
+
+static char buf[4096];
+static char dense[DENSE_SIZE];
+
+/* Checks that SIZE bytes at OFS in FD read back as zeros. */
+static void
+check_zeros (int fd, const char *name, unsigned ofs, size_t size)
+{
+  size_t i;
+
+  seek (fd, ofs);
+  if (read (fd, buf, size) != (int) size)
+    fail ("read %zu bytes at offset %u in \"%s\" failed", size, ofs, name);
+  for (i = 0; i < size; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu in \"%s\" is %d, expected 0", ofs + i, name, buf[i]);
+}
+
+void
+test_main (void) 
+{
+  int fd, i;
+
+  msg ("write one byte at offset %d in %d files", SPARSE_OFS, SPARSE_CNT);
+  for (i = 0; i < SPARSE_CNT; i++)
+    {
+      char name[16];
+      char c = 'a' + i;
+
+      snprintf (name, sizeof name, "sparse%d", i);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+      fd = open (name);
+      if (fd < 2)
+        fail ("open \"%s\" failed", name);
+      seek (fd, SPARSE_OFS);
+      if (write (fd, &c, 1) != 1)
+        fail ("write at offset %d in \"%s\" failed", SPARSE_OFS, name);
+      close (fd);
+    }
+
+  msg ("verify sparse files");
+  for (i = 0; i < SPARSE_CNT; i++)
+    {
+      char name[16];
+
+      snprintf (name, sizeof name, "sparse%d", i);
+      fd = open (name);
+      if (fd < 2)
+        fail ("open \"%s\" failed", name);
+      if (filesize (fd) != SPARSE_OFS + 1)
+        fail ("\"%s\" is %d bytes, expected %d",
+              name, filesize (fd), SPARSE_OFS + 1);
+      check_zeros (fd, name, 0, sizeof buf);
+      check_zeros (fd, name, SPARSE_OFS / 2 - 100, sizeof buf);
+      check_zeros (fd, name, SPARSE_OFS - sizeof buf, sizeof buf);
+      seek (fd, SPARSE_OFS);
+      if (read (fd, buf, sizeof buf) != 1)
+        fail ("read at end of \"%s\" returned wrong size", name);
+      if (buf[0] != 'a' + i)
+        fail ("last byte of \"%s\" is %d, expected %d",
+              name, buf[0], 'a' + i);
+      close (fd);
+    }
+
+  random_init (0);
+  random_bytes (dense, sizeof dense);
+  CHECK (create ("dense", 0), "create \"dense\"");
+  CHECK ((fd = open ("dense")) > 1, "open \"dense\"");
+  CHECK (write (fd, dense, sizeof dense) == (int) sizeof dense,
+         "write %d bytes to \"dense\"", DENSE_SIZE);
+  msg ("close \"dense\"");
+  close (fd);
+  check_file ("dense", dense, sizeof dense);
+}
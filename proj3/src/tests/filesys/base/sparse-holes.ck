@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sparse-holes) begin
+(sparse-holes) write one byte at offset 1048576 in 4 files
+(sparse-holes) verify sparse files
+(sparse-holes) create "dense"
+(sparse-holes) open "dense"
+(sparse-holes) write 524288 bytes to "dense"
+(sparse-holes) close "dense"
+(sparse-holes) open "dense" for verification
+(sparse-holes) verified contents of "dense"
+(sparse-holes) close "dense"
+(sparse-holes) end
+EOF
+pass;
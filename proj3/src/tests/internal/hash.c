@@ -0,0 +1,279 @@
+/* Test and microbenchmark for lib/kernel/hash.c, ihash.c, and
+   ohash.c.
+
+   Checks that the three hash table variants agree with each
+   other on a random mix of insertions, lookups, and deletions of
+   page-aligned keys, the kind of keys the supplemental page
+   table uses, then times each phase with the CPU's time-stamp
+   counter.  Besides the average cost of an operation it reports
+   the worst single insertion, which is where a full rehash in
+   hash.c shows up.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <hash.h>
+#include <ihash.h>
+#include <ohash.h>
+#include <random.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/test.h"
+#include "threads/vaddr.h"
+
+/* Number of elements in the benchmark tables. */
+#define ELEM_CNT 4096
+
+/* A hash table element.  The same element cannot be in a hash.c
+   and an ihash.c table at once, so each of those gets its own
+   array of them. */
+struct value
+  {
+    struct hash_elem elem;      /* hash.c or ihash.c element. */
+    struct ohash_elem oelem;    /* ohash.c element. */
+    uintptr_t key;              /* Key, a page address. */
+  };
+
+static struct value values[ELEM_CNT];
+static struct value ivalues[ELEM_CNT];
+
+static void check_agreement (void);
+static void bench_hash (void);
+static void bench_ihash (void);
+static void bench_ohash (void);
+static unsigned value_hash (const struct hash_elem *, void *);
+static bool value_less (const struct hash_elem *, const struct hash_elem *,
+                        void *);
+
+/* Returns the current value of the time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Timing for one benchmark phase. */
+struct timing
+  {
+    uint64_t start;             /* TSC at start of current operation. */
+    uint64_t total;             /* Total cycles. */
+    uint64_t worst;             /* Most cycles for one operation. */
+  };
+
+static void
+timing_begin (struct timing *t)
+{
+  t->start = rdtsc ();
+}
+
+static void
+timing_end (struct timing *t)
+{
+  uint64_t cycles = rdtsc () - t->start;
+  t->total += cycles;
+  if (cycles > t->worst)
+    t->worst = cycles;
+}
+
+static void
+timing_print (const char *table, const char *phase, const struct timing *t)
+{
+  printf ("%6s %-6s: %6llu cycles/op average, %8llu worst\n",
+          table, phase, t->total / ELEM_CNT, t->worst);
+}
+
+/* Test and time the hash table implementations. */
+void
+test (void)
+{
+  size_t i;
+
+  for (i = 0; i < ELEM_CNT; i++)
+    values[i].key = ivalues[i].key = values[i].oelem.key
+      = (uintptr_t) (i + 1) * PGSIZE;
+
+  printf ("checking that hash, ihash, and ohash agree...\n");
+  check_agreement ();
+
+  printf ("timing %d page-address keys:\n", ELEM_CNT);
+  bench_hash ();
+  bench_ihash ();
+  bench_ohash ();
+  printf ("done\n");
+}
+
+/* Performs the same random operations on one table of each kind
+   and checks each against a simple array of flags after each
+   one. */
+static void
+check_agreement (void)
+{
+  static bool present[ELEM_CNT];
+  struct hash h;
+  struct ihash ih;
+  struct ohash oh;
+  int op;
+
+  ASSERT (hash_init (&h, value_hash, value_less, NULL));
+  ASSERT (ihash_init (&ih, value_hash, value_less, NULL));
+  ASSERT (ohash_init (&oh, NULL));
+
+  for (op = 0; op < ELEM_CNT * 64; op++)
+    {
+      size_t idx = random_ulong () % ELEM_CNT;
+      struct value *v = &values[idx];
+      struct value *iv = &ivalues[idx];
+
+      ASSERT ((hash_find (&h, &v->elem) != NULL) == present[idx]);
+      ASSERT ((ihash_find (&ih, &iv->elem) != NULL) == present[idx]);
+      ASSERT ((ohash_find (&oh, v->key) != NULL) == present[idx]);
+
+      if (!present[idx])
+        {
+          ASSERT (hash_insert (&h, &v->elem) == NULL);
+          ASSERT (ihash_insert (&ih, &iv->elem) == NULL);
+          ASSERT (ohash_insert (&oh, &v->oelem) == NULL);
+        }
+      else
+        {
+          ASSERT (hash_delete (&h, &v->elem) == &v->elem);
+          ASSERT (ihash_delete (&ih, &iv->elem) == &iv->elem);
+          ASSERT (ohash_delete (&oh, v->key) == &v->oelem);
+        }
+      present[idx] = !present[idx];
+
+      ASSERT (hash_size (&h) == ihash_size (&ih));
+      ASSERT (hash_size (&h) == ohash_size (&oh));
+    }
+
+  hash_destroy (&h, NULL);
+  ihash_destroy (&ih, NULL);
+  ohash_destroy (&oh, NULL);
+}
+
+/* Times insertion, lookup, and deletion of every element of
+   VALUES in a hash.c table. */
+static void
+bench_hash (void)
+{
+  struct timing ins = {0, 0, 0}, find = {0, 0, 0}, del = {0, 0, 0};
+  struct hash h;
+  size_t i;
+
+  ASSERT (hash_init (&h, value_hash, value_less, NULL));
+  for (i = 0; i < ELEM_CNT; i++)
+    {
+      timing_begin (&ins);
+      hash_insert (&h, &values[i].elem);
+      timing_end (&ins);
+    }
+  for (i = 0; i < ELEM_CNT; i++)
+    {
+      timing_begin (&find);
+      ASSERT (hash_find (&h, &values[i].elem) != NULL);
+      timing_end (&find);
+    }
+  for (i = 0; i < ELEM_CNT; i++)
+    {
+      timing_begin (&del);
+      hash_delete (&h, &values[i].elem);
+      timing_end (&del);
+    }
+  hash_destroy (&h, NULL);
+
+  timing_print ("hash", "insert", &ins);
+  timing_print ("hash", "find", &find);
+  timing_print ("hash", "delete", &del);
+}
+
+/* Times insertion, lookup, and deletion of every element of
+   VALUES in an ihash.c table. */
+static void
+bench_ihash (void)
+{
+  struct timing ins = {0, 0, 0}, find = {0, 0, 0}, del = {0, 0, 0};
+  struct ihash h;
+  size_t i;
+
+  ASSERT (ihash_init (&h, value_hash, value_less, NULL));
+  for (i = 0; i < ELEM_CNT; i++)
+    {
+      timing_begin (&ins);
+      ihash_insert (&h, &ivalues[i].elem);
+      timing_end (&ins);
+    }
+  for (i = 0; i < ELEM_CNT; i++)
+    {
+      timing_begin (&find);
+      ASSERT (ihash_find (&h, &ivalues[i].elem) != NULL);
+      timing_end (&find);
+    }
+  for (i = 0; i < ELEM_CNT; i++)
+    {
+      timing_begin (&del);
+      ihash_delete (&h, &ivalues[i].elem);
+      timing_end (&del);
+    }
+  ihash_destroy (&h, NULL);
+
+  timing_print ("ihash", "insert", &ins);
+  timing_print ("ihash", "find", &find);
+  timing_print ("ihash", "delete", &del);
+}
+
+/* Times insertion, lookup, and deletion of every element of
+   VALUES in an ohash.c table. */
+static void
+bench_ohash (void)
+{
+  struct timing ins = {0, 0, 0}, find = {0, 0, 0}, del = {0, 0, 0};
+  struct ohash h;
+  size_t i;
+
+  ASSERT (ohash_init (&h, NULL));
+  for (i = 0; i < ELEM_CNT; i++)
+    {
+      timing_begin (&ins);
+      ohash_insert (&h, &values[i].oelem);
+      timing_end (&ins);
+    }
+  for (i = 0; i < ELEM_CNT; i++)
+    {
+      timing_begin (&find);
+      ASSERT (ohash_find (&h, values[i].key) != NULL);
+      timing_end (&find);
+    }
+  for (i = 0; i < ELEM_CNT; i++)
+    {
+      timing_begin (&del);
+      ohash_delete (&h, values[i].key);
+      timing_end (&del);
+    }
+  ohash_destroy (&h, NULL);
+
+  timing_print ("ohash", "insert", &ins);
+  timing_print ("ohash", "find", &find);
+  timing_print ("ohash", "delete", &del);
+}
+
+/* Returns a hash of the key of the value containing E. */
+static unsigned
+value_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int ((int) hash_entry (e, struct value, elem)->key);
+}
+
+/* Returns true if the value containing A has a smaller key than
+   the value containing B. */
+static bool
+value_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct value, elem)->key
+          < hash_entry (b, struct value, elem)->key);
+}
@@ -38,6 +38,8 @@
 #include "filesys/fsutil.h"
 #endif
 #include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/pagecache.h"
 #include "vm/swap.h"
 
 /* Page directory with kernel mappings only. */
@@ -113,6 +115,7 @@ main (void)
 #ifdef USERPROG
   exception_init ();
   syscall_init ();
+  process_init ();
 #endif
 
   /* Start thread scheduler and enable interrupts. */
@@ -120,6 +123,11 @@ main (void)
   serial_init_queue ();
   timer_calibrate ();
 
+  /* The page cache keeps file data in frames, so it must be
+     ready before the file system. */
+  frame_init ();
+  pagecache_init ();
+
 #ifdef FILESYS
   /* Initialize file system. */
   ide_init ();
@@ -127,7 +135,7 @@ main (void)
   filesys_init (format_filesys);
 #endif
   //TODO:
-  frame_init ();
+  page_init ();
   swap_init ();
 
   printf ("Boot complete.\n");
@@ -2,13 +2,14 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/loader.h"
-#include "threads/synch.h"
+#include "threads/interrupt.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -23,22 +24,59 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Within a pool, pages are managed by a binary buddy allocator.
+   Free memory is kept as blocks of 2**ORDER pages, each aligned
+   (relative to the pool base) to its own size, on one free list
+   per order.  A request for N pages takes the smallest block of
+   order >= ceil(log2(N)), splitting larger blocks as needed, and
+   gives the unused tail back.  Freeing a block merges it with its
+   "buddy" (the block whose index differs only in bit ORDER) for
+   as long as the buddy is also free, so both operations take
+   O(log n) time and free space does not fragment into runs that
+   a linear scan would have to step over.
+
+   The free lists and bitmap are protected by disabling
+   interrupts rather than by a lock, because
+   thread_schedule_tail() frees a dying thread's page in the
+   middle of a context switch, where sleeping on a lock held by
+   a preempted thread is not an option. */
+
+/* Largest block order.  Requests for more than 2**MAX_ORDER
+   pages always fail. */
+#define MAX_ORDER 20
+
+/* Value in a pool's `orders' map for a page that does not start
+   a free block. */
+#define ORDER_NONE 0xff
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
+    uint8_t *orders;                    /* Order of each free block's
+                                           first page, else ORDER_NONE. */
+    struct list free_lists[MAX_ORDER + 1]; /* Free blocks, by order. */
+    size_t free_cnt;                    /* Number of free pages. */
     uint8_t *base;                      /* Base of pool. */
   };
 
+/* Header stored in the first page of each free block. */
+struct free_block
+  {
+    struct list_elem elem;              /* Element in a free list. */
+  };
+
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t buddy_alloc (struct pool *, size_t page_cnt);
+static void buddy_free (struct pool *, size_t page_idx, size_t page_cnt);
+static void print_pool_stats (struct pool *, const char *name);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -73,13 +111,16 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
   void *pages;
   size_t page_idx;
+  enum intr_level old_level;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  old_level = intr_disable ();
+  page_idx = buddy_alloc (pool, page_cnt);
+  if (page_idx != BITMAP_ERROR)
+    bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+  intr_set_level (old_level);
 
   if (page_idx != BITMAP_ERROR)
     pages = pool->base + PGSIZE * page_idx;
@@ -119,6 +160,7 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 {
   struct pool *pool;
   size_t page_idx;
+  enum intr_level old_level;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
@@ -137,8 +179,11 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
+  old_level = intr_disable ();
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  buddy_free (pool, page_idx, page_cnt);
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -148,15 +193,26 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Prints fragmentation statistics for both pools. */
+void
+palloc_print_stats (void)
+{
+  print_pool_stats (&kernel_pool, "kernel pool");
+  print_pool_stats (&user_pool, "user pool");
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  /* We'll put the pool's used_map and order map at its base.
+     Calculate the space needed for them and subtract it from the
+     pool's size. */
+  size_t bm_bytes = ROUND_UP (bitmap_buf_size (page_cnt), sizeof (void *));
+  size_t bm_pages = DIV_ROUND_UP (bm_bytes + page_cnt, PGSIZE);
+  int order;
+
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -164,9 +220,16 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_bytes);
+  p->orders = (uint8_t *) base + bm_bytes;
+  memset (p->orders, ORDER_NONE, page_cnt);
+  for (order = 0; order <= MAX_ORDER; order++)
+    list_init (&p->free_lists[order]);
+  p->free_cnt = 0;
   p->base = base + bm_pages * PGSIZE;
+
+  /* Hand every page to the buddy allocator. */
+  buddy_free (p, 0, page_cnt);
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -180,3 +243,155 @@ page_from_pool (const struct pool *pool, void *page)
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the number of pages in POOL. */
+static inline size_t
+pool_size (const struct pool *pool)
+{
+  return bitmap_size (pool->used_map);
+}
+
+/* Returns the smallest order whose blocks hold PAGE_CNT pages. */
+static inline int
+order_for (size_t page_cnt)
+{
+  int order = 0;
+  while (((size_t) 1 << order) < page_cnt)
+    order++;
+  return order;
+}
+
+/* Returns the free block header in POOL's page PAGE_IDX. */
+static inline struct free_block *
+idx_to_block (const struct pool *pool, size_t page_idx)
+{
+  return (struct free_block *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Adds the free block of 2**ORDER pages at PAGE_IDX to POOL. */
+static void
+push_block (struct pool *pool, size_t page_idx, int order)
+{
+  pool->orders[page_idx] = order;
+  list_push_front (&pool->free_lists[order],
+                   &idx_to_block (pool, page_idx)->elem);
+  pool->free_cnt += (size_t) 1 << order;
+}
+
+/* Removes the free block at PAGE_IDX from POOL. */
+static void
+pull_block (struct pool *pool, size_t page_idx)
+{
+  int order = pool->orders[page_idx];
+
+  ASSERT (order != ORDER_NONE);
+  list_remove (&idx_to_block (pool, page_idx)->elem);
+  pool->orders[page_idx] = ORDER_NONE;
+  pool->free_cnt -= (size_t) 1 << order;
+}
+
+/* Frees the block of 2**ORDER pages at PAGE_IDX in POOL,
+   merging it with its buddy for as long as the buddy is free. */
+static void
+merge_block (struct pool *pool, size_t page_idx, int order)
+{
+  while (order < MAX_ORDER)
+    {
+      size_t buddy_idx = page_idx ^ ((size_t) 1 << order);
+      if (buddy_idx + ((size_t) 1 << order) > pool_size (pool)
+          || pool->orders[buddy_idx] != order)
+        break;
+
+      pull_block (pool, buddy_idx);
+      if (buddy_idx < page_idx)
+        page_idx = buddy_idx;
+      order++;
+    }
+  push_block (pool, page_idx, order);
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first, or BITMAP_ERROR if no free block is large
+   enough.  Interrupts must be off. */
+static size_t
+buddy_alloc (struct pool *pool, size_t page_cnt)
+{
+  int want = order_for (page_cnt);
+  int order;
+  size_t page_idx;
+
+  if (want > MAX_ORDER)
+    return BITMAP_ERROR;
+
+  /* Find the smallest free block that is big enough. */
+  for (order = want; order <= MAX_ORDER; order++)
+    if (!list_empty (&pool->free_lists[order]))
+      break;
+  if (order > MAX_ORDER)
+    return BITMAP_ERROR;
+
+  page_idx = (((uint8_t *) list_front (&pool->free_lists[order])
+               - pool->base) / PGSIZE);
+  pull_block (pool, page_idx);
+
+  /* Split it, returning upper halves to the free lists. */
+  while (order > want)
+    {
+      order--;
+      push_block (pool, page_idx + ((size_t) 1 << order), order);
+    }
+
+  /* Give back the pages past PAGE_CNT. */
+  if (page_cnt < (size_t) 1 << want)
+    buddy_free (pool, page_idx + page_cnt, ((size_t) 1 << want) - page_cnt);
+
+  return page_idx;
+}
+
+/* Returns PAGE_CNT pages starting at PAGE_IDX to POOL, as the
+   largest aligned blocks that cover them.  Interrupts must be
+   off, except during initialization. */
+static void
+buddy_free (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  while (page_cnt > 0)
+    {
+      int order = 0;
+      while (order < MAX_ORDER
+             && (page_idx & ((size_t) 1 << order)) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+
+      merge_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Prints the free page count, the largest free block, and the
+   resulting external fragmentation of POOL, named NAME. */
+static void
+print_pool_stats (struct pool *pool, const char *name)
+{
+  size_t largest = 0;
+  size_t block_cnt = 0;
+  size_t free_cnt;
+  enum intr_level old_level;
+  int order;
+
+  old_level = intr_disable ();
+  for (order = 0; order <= MAX_ORDER; order++)
+    {
+      size_t cnt = list_size (&pool->free_lists[order]);
+      if (cnt > 0)
+        largest = (size_t) 1 << order;
+      block_cnt += cnt;
+    }
+  free_cnt = pool->free_cnt;
+  intr_set_level (old_level);
+
+  printf ("%s: %zu of %zu pages free in %zu blocks, "
+          "largest %zu pages, %zu%% fragmented\n",
+          name, free_cnt, pool_size (pool), block_cnt, largest,
+          free_cnt > 0 ? 100 - largest * 100 / free_cnt : 0);
+}
@@ -0,0 +1,196 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Slab allocator for fixed-size kernel objects.
+
+   malloc() serves every request of a given power-of-2 size from
+   one descriptor, so unrelated object types contend for the same
+   lock, and each call pays for arena bookkeeping and rounding.
+   A slab cache instead serves a single object type: it has its
+   own lock, packs objects at their exact size, and keeps
+   objects in their constructed state between uses, so callers
+   that free an object the way the constructor left it do not
+   have to reinitialize it.
+
+   Free objects in a slab are tracked by an array of 16-bit
+   "next free" indexes in the slab header, rather than by links
+   stored inside the objects, so freeing an object never
+   disturbs its contents. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* End of a slab's free object chain. */
+#define SLAB_NONE UINT16_MAX
+
+/* A slab: one page holding this header, the free chain, and the
+   objects themselves. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct slab_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* `partial' or `full' list element. */
+    size_t free_cnt;            /* Number of free objects. */
+    uint16_t free_head;         /* First free object, or SLAB_NONE. */
+    uint8_t *objs;              /* First object. */
+    uint16_t next[];            /* Next free object after each one. */
+  };
+
+/* Returns the offset within a slab of its first object, for
+   slabs of OBJS_PER_SLAB objects. */
+static size_t
+objs_offset (size_t objs_per_slab)
+{
+  return ROUND_UP (sizeof (struct slab) + objs_per_slab * sizeof (uint16_t),
+                   sizeof (void *));
+}
+
+/* Initializes cache C for objects of OBJ_SIZE bytes, named NAME
+   for debugging purposes.  If CTOR is non-null, it is called on
+   each object when its slab is created. */
+void
+slab_cache_init (struct slab_cache *c, const char *name, size_t obj_size,
+                 slab_ctor_func *ctor)
+{
+  ASSERT (obj_size > 0);
+
+  c->name = name;
+  c->obj_size = ROUND_UP (obj_size, sizeof (void *));
+  c->objs_per_slab = ((PGSIZE - sizeof (struct slab))
+                      / (c->obj_size + sizeof (uint16_t)));
+  while (c->objs_per_slab > 0
+         && (objs_offset (c->objs_per_slab)
+             + c->objs_per_slab * c->obj_size) > PGSIZE)
+    c->objs_per_slab--;
+  ASSERT (c->objs_per_slab > 0 && c->objs_per_slab < SLAB_NONE);
+
+  c->ctor = ctor;
+  lock_init (&c->lock);
+  list_init (&c->partial);
+  list_init (&c->full);
+  c->empty = NULL;
+  c->slab_cnt = 0;
+  c->in_use = 0;
+}
+
+/* Obtains a page for a new slab in C and constructs its objects.
+   Returns a null pointer if no page is available. */
+static struct slab *
+slab_create (struct slab_cache *c)
+{
+  struct slab *s = palloc_get_page (0);
+  size_t i;
+
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->free_cnt = c->objs_per_slab;
+  s->free_head = 0;
+  s->objs = (uint8_t *) s + objs_offset (c->objs_per_slab);
+  for (i = 0; i < c->objs_per_slab; i++)
+    {
+      s->next[i] = i + 1 < c->objs_per_slab ? i + 1 : SLAB_NONE;
+      if (c->ctor != NULL)
+        c->ctor (s->objs + i * c->obj_size);
+    }
+  c->slab_cnt++;
+  return s;
+}
+
+/* Obtains and returns an object from cache C.
+   Returns a null pointer if memory is not available. */
+void *
+slab_alloc (struct slab_cache *c)
+{
+  struct slab *s;
+  uint16_t idx;
+
+  lock_acquire (&c->lock);
+
+  /* Make sure there is a slab with a free object. */
+  if (list_empty (&c->partial))
+    {
+      if (c->empty != NULL)
+        {
+          s = c->empty;
+          c->empty = NULL;
+        }
+      else
+        {
+          s = slab_create (c);
+          if (s == NULL)
+            {
+              lock_release (&c->lock);
+              return NULL;
+            }
+        }
+      list_push_front (&c->partial, &s->elem);
+    }
+
+  /* Take the first free object of the first partial slab. */
+  s = list_entry (list_front (&c->partial), struct slab, elem);
+  idx = s->free_head;
+  ASSERT (idx != SLAB_NONE);
+  s->free_head = s->next[idx];
+  if (--s->free_cnt == 0)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->full, &s->elem);
+    }
+  c->in_use++;
+
+  lock_release (&c->lock);
+  return s->objs + idx * c->obj_size;
+}
+
+/* Returns OBJ, which must have been obtained from cache C with
+   slab_alloc(), to C.  OBJ should be left in the state its
+   constructor put it in. */
+void
+slab_free (struct slab_cache *c, void *obj)
+{
+  struct slab *s;
+  size_t ofs;
+
+  if (obj == NULL)
+    return;
+
+  s = pg_round_down (obj);
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+  ofs = (uint8_t *) obj - s->objs;
+  ASSERT (ofs % c->obj_size == 0);
+  ASSERT (ofs / c->obj_size < c->objs_per_slab);
+
+  lock_acquire (&c->lock);
+
+  s->next[ofs / c->obj_size] = s->free_head;
+  s->free_head = ofs / c->obj_size;
+  c->in_use--;
+  if (s->free_cnt++ == 0)
+    {
+      /* Was full, now partial. */
+      list_remove (&s->elem);
+      list_push_front (&c->partial, &s->elem);
+    }
+  if (s->free_cnt == c->objs_per_slab)
+    {
+      /* Now empty.  Keep one such slab, release the rest. */
+      list_remove (&s->elem);
+      if (c->empty == NULL)
+        c->empty = s;
+      else
+        {
+          c->slab_cnt--;
+          palloc_free_page (s);
+        }
+    }
+
+  lock_release (&c->lock);
+}
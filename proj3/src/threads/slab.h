@@ -0,0 +1,40 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+#include "threads/synch.h"
+
+/* Initializes a newly carved-out object OBJ.  Called once per
+   object, when the slab that holds it is created, not on every
+   allocation. */
+typedef void slab_ctor_func (void *obj);
+
+/* A cache of equally sized objects.
+
+   Each slab is one page from the kernel pool, holding a header
+   followed by as many objects as fit.  Slabs with at least one
+   free object sit on the `partial' list, so an allocation never
+   has to look past the first slab there.  At most one completely
+   free slab is kept around to absorb alloc/free ping-pong; any
+   other slab that empties is returned to the page allocator. */
+struct slab_cache
+  {
+    const char *name;           /* Name, for debugging. */
+    size_t obj_size;            /* Size of each object in bytes. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    slab_ctor_func *ctor;       /* Object constructor, or null. */
+    struct lock lock;           /* Protects everything below. */
+    struct list partial;        /* Slabs with some objects free. */
+    struct list full;           /* Slabs with no objects free. */
+    struct slab *empty;         /* Cached slab with all objects free. */
+    size_t slab_cnt;            /* Number of slabs, including `empty'. */
+    size_t in_use;              /* Number of allocated objects. */
+  };
+
+void slab_cache_init (struct slab_cache *, const char *name,
+                      size_t obj_size, slab_ctor_func *);
+void *slab_alloc (struct slab_cache *);
+void slab_free (struct slab_cache *, void *);
+
+#endif /* threads/slab.h */
@@ -560,6 +560,7 @@ init_thread (struct thread *t, const char *name, int priority, tid_t tid)
     list_init (&t->list_mmap_files);
     list_init (&t->donors);
     t->next_handle = 2;
+    t->aio = NULL;
 
   list_push_back (&all_list, &t->allelem);
 }
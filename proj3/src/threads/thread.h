@@ -2,7 +2,7 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
-#include <hash.h>
+#include <ihash.h>
 #include <list.h>
 #include <stdint.h>
 #include "threads/synch.h"
@@ -58,7 +58,7 @@ struct thread
 
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
-    struct hash *SPT;                   /* Supplementary Page table. */
+    struct ihash *SPT;                  /* Supplementary Page table. */
     struct file *bin_file;              /* Executable. */
 
     /* Owned by syscall.c. */
@@ -66,6 +66,7 @@ struct thread
     struct list list_mmap_files;               /* Memory-mapped files. */
     int next_handle;                    /* Next handle value. */
     void *user_esp;                     /* User's stack pointer. */
+    struct aio_context *aio;            /* Asynchronous I/O, if set up. */
 
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
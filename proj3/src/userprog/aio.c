@@ -0,0 +1,184 @@
+#include "userprog/aio.h"
+#include <debug.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+
+/* Asynchronous I/O.
+
+   Requests that processes submit go on a single work queue,
+   served by WORKER_CNT kernel threads, so that a process keeps
+   running while its requests wait for the disk, and can have
+   several of them in progress at once.  The workers never touch
+   user memory: data to write is copied in when a request is
+   submitted, and data read is copied out when it is reaped, by
+   the process itself in its system calls (see
+   userprog/syscall.c).  Each request has its own opening of its
+   file, so closing the file descriptor while the request is in
+   progress is harmless. */
+
+/* Number of worker threads. */
+#define WORKER_CNT 2
+
+static struct list work_queue;          /* Requests not yet started. */
+static struct lock work_lock;           /* Protects the following. */
+static struct condition work_cond;      /* Signaled when work arrives. */
+static bool workers_started;            /* Are the workers running? */
+
+static thread_func worker_thread;
+
+/* Initializes asynchronous I/O. */
+void
+aio_init (void)
+{
+  list_init (&work_queue);
+  lock_init (&work_lock);
+  cond_init (&work_cond);
+}
+
+/* Creates and returns a context for a process whose ring is
+   RING, starting the workers if no process has used asynchronous
+   I/O before.  Returns a null pointer if memory is short. */
+struct aio_context *
+aio_create (struct aio_ring *ring)
+{
+  struct aio_context *ctx;
+
+  lock_acquire (&work_lock);
+  if (!workers_started)
+    {
+      int i;
+
+      for (i = 0; i < WORKER_CNT; i++)
+        thread_create ("aio", PRI_DEFAULT, worker_thread, NULL);
+      workers_started = true;
+    }
+  lock_release (&work_lock);
+
+  ctx = malloc (sizeof *ctx);
+  if (ctx == NULL)
+    return NULL;
+  ctx->ring = ring;
+  ctx->sq_head = ctx->cq_tail = 0;
+  ctx->outstanding = 0;
+  lock_init (&ctx->lock);
+  cond_init (&ctx->done_cond);
+  list_init (&ctx->done);
+  return ctx;
+}
+
+/* Waits for all of CTX's requests to finish, then frees them
+   and CTX. */
+void
+aio_destroy (struct aio_context *ctx)
+{
+  struct aio_request *r;
+
+  while ((r = aio_reap (ctx, true)) != NULL)
+    aio_request_free (r);
+  free (ctx);
+}
+
+/* Returns a new request with room for SIZE bytes of data, or a
+   null pointer if memory is short. */
+struct aio_request *
+aio_request_create (off_t size)
+{
+  struct aio_request *r = malloc (sizeof *r);
+
+  if (r == NULL)
+    return NULL;
+  r->file = NULL;
+  r->size = size;
+  r->data = NULL;
+  if (size > 0)
+    {
+      r->data = malloc (size);
+      if (r->data == NULL)
+        {
+          free (r);
+          return NULL;
+        }
+    }
+  return r;
+}
+
+/* Frees R and closes its file. */
+void
+aio_request_free (struct aio_request *r)
+{
+  file_close (r->file);
+  free (r->data);
+  free (r);
+}
+
+/* Adds R to CTX's requests, to be carried out by a worker.  A
+   request without a file fails at once. */
+void
+aio_submit (struct aio_context *ctx, struct aio_request *r)
+{
+  r->ctx = ctx;
+  ctx->outstanding++;
+
+  if (r->file == NULL)
+    {
+      r->result = -1;
+      lock_acquire (&ctx->lock);
+      list_push_back (&ctx->done, &r->elem);
+      lock_release (&ctx->lock);
+      return;
+    }
+
+  lock_acquire (&work_lock);
+  list_push_back (&work_queue, &r->elem);
+  cond_signal (&work_cond, &work_lock);
+  lock_release (&work_lock);
+}
+
+/* Removes and returns one of CTX's requests that is done, oldest
+   first.  If none is done, waits for one if WAIT is true and any
+   is in progress, and otherwise returns a null pointer. */
+struct aio_request *
+aio_reap (struct aio_context *ctx, bool wait)
+{
+  struct aio_request *r = NULL;
+
+  lock_acquire (&ctx->lock);
+  while (wait && list_empty (&ctx->done) && ctx->outstanding > 0)
+    cond_wait (&ctx->done_cond, &ctx->lock);
+  if (!list_empty (&ctx->done))
+    {
+      r = list_entry (list_pop_front (&ctx->done), struct aio_request, elem);
+      ctx->outstanding--;
+    }
+  lock_release (&ctx->lock);
+  return r;
+}
+
+/* Carries out requests from the work queue. */
+static void
+worker_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      struct aio_request *r;
+      struct aio_context *ctx;
+
+      lock_acquire (&work_lock);
+      while (list_empty (&work_queue))
+        cond_wait (&work_cond, &work_lock);
+      r = list_entry (list_pop_front (&work_queue), struct aio_request, elem);
+      lock_release (&work_lock);
+
+      if (r->op == AIO_READ)
+        r->result = file_read_at (r->file, r->data, r->size, r->offset);
+      else
+        r->result = file_write_at (r->file, r->data, r->size, r->offset);
+
+      ctx = r->ctx;
+      lock_acquire (&ctx->lock);
+      list_push_back (&ctx->done, &r->elem);
+      cond_signal (&ctx->done_cond, &ctx->lock);
+      lock_release (&ctx->lock);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef USERPROG_AIO_H
+#define USERPROG_AIO_H
+
+#include <aio.h>
+#include <list.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+/* An asynchronous I/O request. */
+struct aio_request
+  {
+    struct list_elem elem;      /* In the work queue or a done list. */
+    struct file *file;          /* File, opened for this request. */
+    int op;                     /* AIO_READ or AIO_WRITE. */
+    off_t offset;               /* File offset. */
+    off_t size;                 /* Number of bytes. */
+    void *buf;                  /* User buffer. */
+    unsigned user_data;         /* For the completion. */
+    uint8_t *data;              /* Kernel copy of the data. */
+    int result;                 /* Bytes transferred, or -1. */
+    struct aio_context *ctx;    /* Owning context. */
+  };
+
+/* A process's asynchronous I/O state. */
+struct aio_context
+  {
+    struct aio_ring *ring;      /* User's ring. */
+    unsigned sq_head;           /* Kernel's copy of ring->sq_head. */
+    unsigned cq_tail;           /* Kernel's copy of ring->cq_tail. */
+    size_t outstanding;         /* Requests submitted but not reaped. */
+
+    struct lock lock;           /* Protects the following. */
+    struct condition done_cond; /* Signaled when a request is done. */
+    struct list done;           /* Requests done but not reaped. */
+  };
+
+void aio_init (void);
+struct aio_context *aio_create (struct aio_ring *);
+void aio_destroy (struct aio_context *);
+
+struct aio_request *aio_request_create (off_t size);
+void aio_request_free (struct aio_request *);
+void aio_submit (struct aio_context *, struct aio_request *);
+struct aio_request *aio_reap (struct aio_context *, bool wait);
+
+#endif /* userprog/aio.h */
@@ -16,6 +16,7 @@
 #include "threads/interrupt.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "vm/page.h"
@@ -37,6 +38,25 @@ struct exec_info
     bool success;                       /* Program successfully loaded? */
   };
 
+/* Child process completion records. */
+static struct slab_cache wait_status_cache;
+
+/* Constructs a wait_status in WAIT_STATUS_CACHE. */
+static void
+wait_status_ctor (void *cs_)
+{
+  struct wait_status *cs = cs_;
+  lock_init (&cs->lock);
+}
+
+/* Initializes the process module. */
+void
+process_init (void)
+{
+  slab_cache_init (&wait_status_cache, "wait_status",
+                   sizeof (struct wait_status), wait_status_ctor);
+}
+
 /* Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
    before process_execute() returns.  Returns the new process's
@@ -89,14 +109,13 @@ start_process (void *exec_)
   if (success)
     {
       exec->wait_status = thread_current ()->wait_status
-        = malloc (sizeof *exec->wait_status);
+        = slab_alloc (&wait_status_cache);
       success = exec->wait_status != NULL;
     }
 
   /* Initialize wait_status. */
   if (success)
     {
-      lock_init (&exec->wait_status->lock);
       exec->wait_status->ref_cnt = 2;
       exec->wait_status->tid = thread_current ()->tid;
       sema_init (&exec->wait_status->dead, 0);
@@ -130,7 +149,7 @@ release_child (struct wait_status *cs)
   lock_release (&cs->lock);
 
   if (new_ref_cnt == 0)
-    free (cs);
+    slab_free (&wait_status_cache, cs);
 }
 
 /* Waits for thread TID to die and returns its exit status.  If
@@ -327,7 +346,7 @@ load (const char *cmd_line, void (**eip) (void), void **esp)
   t->SPT = malloc (sizeof *t->SPT);
   if (t->SPT == NULL)
     goto done;
-  hash_init (t->SPT, page_hash, addr_less, NULL);
+  ihash_init (t->SPT, page_hash, addr_less, NULL);
 
   /* Extract file_name from command line. */
   while (*cmd_line == ' ')
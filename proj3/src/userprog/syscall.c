@@ -1,7 +1,11 @@
 #include "userprog/syscall.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <string.h>
 #include <syscall-nr.h>
+#include "userprog/aio.h"
 #include "userprog/process.h"
 #include "userprog/pagedir.h"
 #include "devices/input.h"
@@ -9,9 +13,11 @@
 #include "filesys/directory.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#include "filesys/inode.h"
 #include "threads/interrupt.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "vm/page.h"
@@ -30,6 +36,20 @@ static int sys_write (int handle, void *usrc_, unsigned size);
 static int sys_seek (int handle, unsigned position);
 static int sys_tell (int handle);
 static int sys_close (int handle);
+static int sys_fallocate (int handle, unsigned offset, unsigned length);
+static int sys_readv (int handle, const struct iovec *uiov, int iov_cnt);
+static int sys_writev (int handle, const struct iovec *uiov, int iov_cnt);
+static int sys_copy_file_range (int in_handle, int out_handle,
+                                unsigned length);
+static int sys_aio_setup (struct aio_ring *uring);
+static int sys_wait_for_completions (int min_complete);
+static int sys_fsync (int handle);
+static int sys_sync (void);
+static int sys_open_flags (const char *ufile, int flags);
+static int sys_readdir (int handle, char *uname);
+static int sys_isdir (int handle);
+static int sys_inumber (int handle);
+static int sys_getdents (int handle, struct dirent *uentries, unsigned cnt);
 
 void clear_mapping (struct mapping *m);
 static int sys_mapping (int handle, void *addr);
@@ -38,6 +58,7 @@ static inline bool
 get_user (uint8_t *dst, const uint8_t *usrc);
 static void syscall_handler (struct intr_frame *);
 static void copy_in (void *, const void *, size_t);
+static void copy_out (void *, const void *, size_t);
 int add_file_to_mapping(struct file* file,
                         off_t ofs,
                         uint8_t* addr,
@@ -46,13 +67,28 @@ int add_file_to_mapping(struct file* file,
                         struct mapping *m);
 
 static bool  verify_user (const void *uaddr);
-static struct lock fs_lock;
+
+/* Caches for file descriptors and memory mappings. */
+static struct slab_cache fd_cache;
+static struct slab_cache mapping_cache;
+
+/* A file descriptor, for binding a file handle to a file. */
+struct file_descriptor
+  {
+    struct list_elem elem;      /* List element. */
+    struct file *file;          /* File, or null for a directory. */
+    struct dir *dir;            /* Directory, or null for a file. */
+    int handle;                 /* File handle. */
+  };
 
 void
 syscall_init (void)
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
-  lock_init (&fs_lock);
+  slab_cache_init (&fd_cache, "file_descriptor",
+                   sizeof (struct file_descriptor), NULL);
+  slab_cache_init (&mapping_cache, "mapping", sizeof (struct mapping), NULL);
+  aio_init ();
 }
 
 /* System call handler. */
@@ -86,6 +122,21 @@ syscall_handler (struct intr_frame *f)
       {1, (syscall_function *) sys_close},
       {2, (syscall_function *) sys_mapping},
       {1, (syscall_function *) sys_munmap},
+      {0, NULL},                /* chdir: not implemented. */
+      {0, NULL},                /* mkdir: not implemented. */
+      {2, (syscall_function *) sys_readdir},
+      {1, (syscall_function *) sys_isdir},
+      {1, (syscall_function *) sys_inumber},
+      {3, (syscall_function *) sys_fallocate},
+      {3, (syscall_function *) sys_readv},
+      {3, (syscall_function *) sys_writev},
+      {3, (syscall_function *) sys_copy_file_range},
+      {1, (syscall_function *) sys_aio_setup},
+      {1, (syscall_function *) sys_wait_for_completions},
+      {1, (syscall_function *) sys_fsync},
+      {0, (syscall_function *) sys_sync},
+      {2, (syscall_function *) sys_open_flags},
+      {3, (syscall_function *) sys_getdents},
     };
 
   const struct syscall *sc;
@@ -97,6 +148,8 @@ syscall_handler (struct intr_frame *f)
   if (call_nr >= sizeof syscall_table / sizeof *syscall_table)
     thread_exit ();
   sc = syscall_table + call_nr;
+  if (sc->func == NULL)
+    thread_exit ();
 
   /* Get the system call arguments. */
   ASSERT (sc->arg_cnt <= sizeof args / sizeof *args);
@@ -130,6 +183,64 @@ static void copy_in (void *dst_, const void *usrc_, size_t size)
     }
 }
 
+/* Copies SIZE bytes from kernel address SRC to user address UDST.
+   Call thread_exit() if any of the user accesses are invalid. */
+static void
+copy_out (void *udst_, const void *src_, size_t size)
+{
+  uint8_t *udst = udst_;
+  const uint8_t *src = src_;
+
+  while (size > 0)
+    {
+      size_t chunk_size = PGSIZE - pg_ofs (udst);
+      if (chunk_size > size)
+        chunk_size = size;
+
+      if (!page_lock (udst, true))
+        thread_exit ();
+      memcpy (udst, src, chunk_size);
+      page_unlock (udst);
+
+      udst += chunk_size;
+      src += chunk_size;
+      size -= chunk_size;
+    }
+}
+
+/* Returns true if the SIZE bytes at user address UADDR are
+   mapped, and writable if WILL_WRITE is true, faulting them in
+   if necessary, false if any of them are invalid. */
+static bool
+user_range_ok (const void *uaddr, size_t size, bool will_write)
+{
+  const uint8_t *upage = pg_round_down (uaddr);
+  const uint8_t *end = (const uint8_t *) uaddr + size;
+
+  if (size == 0)
+    return true;
+  if (end < (const uint8_t *) uaddr)
+    return false;
+  for (; upage < end; upage += PGSIZE)
+    {
+      if (!page_lock (upage, will_write))
+        return false;
+      page_unlock (upage);
+    }
+  return true;
+}
+
+/* Checks that the SIZE bytes at user address UADDR are mapped,
+   and writable if WILL_WRITE is true, faulting them in if
+   necessary.
+   Call thread_exit() if any of them are invalid. */
+static void
+check_user (const void *uaddr, size_t size, bool will_write)
+{
+  if (!user_range_ok (uaddr, size, will_write))
+    thread_exit ();
+}
+
 /* Creates a copy of user string US in kernel memory
    and returns it as a page that must be freed with
    palloc_free_page().
@@ -211,9 +322,7 @@ sys_exec (const char *ufile)
   tid_t tid;
   char *kfile = copy_in_string (ufile);
 
-  lock_acquire (&fs_lock);
   tid = process_execute (kfile);
-  lock_release (&fs_lock);
 
   palloc_free_page (kfile);
 
@@ -234,9 +343,7 @@ sys_create (const char *ufile, unsigned initial_size)
   char *kfile = copy_in_string (ufile);
   bool ok;
 
-  lock_acquire (&fs_lock);
   ok = filesys_create (kfile, initial_size);
-  lock_release (&fs_lock);
 
   palloc_free_page (kfile);
 
@@ -250,56 +357,55 @@ sys_remove (const char *ufile)
   char *kfile = copy_in_string (ufile);
   bool ok;
 
-  lock_acquire (&fs_lock);
   ok = filesys_remove (kfile);
-  lock_release (&fs_lock);
 
   palloc_free_page (kfile);
 
   return ok;
 }
 
-/* A file descriptor, for binding a file handle to a file. */
-struct file_descriptor
-  {
-    struct list_elem elem;      /* List element. */
-    struct file *file;          /* File. */
-    int handle;                 /* File handle. */
-  };
-
 /* Open system call. */
 static int
 sys_open (const char *ufile)
+{
+  return sys_open_flags (ufile, 0);
+}
+
+/* Open_flags system call.  Like open, but FLAGS, a combination
+   of O_* flags, select how the file is accessed. */
+static int
+sys_open_flags (const char *ufile, int flags)
 {
   char *kfile = copy_in_string (ufile);
   struct file_descriptor *fd;
   int handle = -1;
 
-  fd = malloc (sizeof *fd);
+  fd = (flags & ~O_FLAGS) == 0 ? slab_alloc (&fd_cache) : NULL;
   if (fd != NULL)
     {
-      lock_acquire (&fs_lock);
-      fd->file = filesys_open (kfile);
-      if (fd->file != NULL)
+      fd->dir = filesys_open_dir (kfile);
+      fd->file = fd->dir == NULL ? filesys_open (kfile) : NULL;
+      if (fd->file != NULL || fd->dir != NULL)
         {
           struct thread *cur = thread_current ();
+          if (fd->file != NULL)
+            file_set_direct (fd->file, (flags & O_DIRECT) != 0);
           handle = fd->handle = cur->next_handle++;
           list_push_front (&cur->fds, &fd->elem);
         }
       else
-        free (fd);
-      lock_release (&fs_lock);
+        slab_free (&fd_cache, fd);
     }
 
   palloc_free_page (kfile);
   return handle;
 }
 
-/* Returns the file descriptor associated with the given handle.
-   Terminates the process if HANDLE is not associated with an
-   open file. */
+/* Returns the file descriptor associated with the given handle,
+   or a null pointer if HANDLE is not associated with an open
+   file. */
 static struct file_descriptor *
-lookup_fd (int handle)
+find_fd (int handle)
 {
   struct thread *cur = thread_current ();
   struct list_elem *e;
@@ -312,8 +418,33 @@ lookup_fd (int handle)
       if (fd->handle == handle)
         return fd;
     }
+  return NULL;
+}
 
-  thread_exit ();
+/* Returns the file descriptor associated with the given handle.
+   Terminates the process if HANDLE is not associated with an
+   open file, including if it is associated with a directory. */
+static struct file_descriptor *
+lookup_fd (int handle)
+{
+  struct file_descriptor *fd = find_fd (handle);
+
+  if (fd == NULL || fd->file == NULL)
+    thread_exit ();
+  return fd;
+}
+
+/* Returns the file descriptor associated with the given handle,
+   which may be a file or a directory.  Terminates the process if
+   HANDLE is not associated with either. */
+static struct file_descriptor *
+lookup_any_fd (int handle)
+{
+  struct file_descriptor *fd = find_fd (handle);
+
+  if (fd == NULL)
+    thread_exit ();
+  return fd;
 }
 
 /* Filesize system call. */
@@ -323,9 +454,7 @@ sys_filesize (int handle)
   struct file_descriptor *fd = lookup_fd (handle);
   int size;
 
-  lock_acquire (&fs_lock);
   size = file_length (fd->file);
-  lock_release (&fs_lock);
 
   return size;
 }
@@ -458,10 +587,8 @@ sys_seek (int handle, unsigned position)
 {
   struct file_descriptor *fd = lookup_fd (handle);
 
-  lock_acquire (&fs_lock);
   if ((off_t) position >= 0)
     file_seek (fd->file, position);
-  lock_release (&fs_lock);
 
   return 0;
 }
@@ -473,9 +600,7 @@ sys_tell (int handle)
   struct file_descriptor *fd = lookup_fd (handle);
   unsigned position;
 
-  lock_acquire (&fs_lock);
   position = file_tell (fd->file);
-  lock_release (&fs_lock);
 
   return position;
 }
@@ -484,15 +609,411 @@ sys_tell (int handle)
 static int
 sys_close (int handle)
 {
-  struct file_descriptor *fd = lookup_fd (handle);
-  lock_acquire (&fs_lock);
+  struct file_descriptor *fd = lookup_any_fd (handle);
   file_close (fd->file);
-  lock_release (&fs_lock);
+  dir_close (fd->dir);
   list_remove (&fd->elem);
-  free (fd);
+  slab_free (&fd_cache, fd);
+  return 0;
+}
+
+/* Fallocate system call. */
+static int
+sys_fallocate (int handle, unsigned offset, unsigned length)
+{
+  struct file_descriptor *fd = lookup_fd (handle);
+
+  if ((off_t) offset < 0 || (off_t) length <= 0
+      || (off_t) (offset + length) < (off_t) offset)
+    return false;
+  return file_allocate (fd->file, offset, length);
+}
+
+/* Most user pages that readv and writev pin at once.  Pinned
+   pages cannot be evicted, so this bounds how much of physical
+   memory a single call ties up. */
+#define PIN_MAX 16
+
+/* Unpins the PAGE_CNT user pages in PAGES. */
+static void
+unpin_pages (const void **pages, size_t page_cnt)
+{
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    page_unlock (pages[i]);
+}
+
+/* Pins user page UPAGE, for writing if WILL_WRITE, and adds it to
+   the *PAGE_CNT pages in PAGES, unless it is already there.
+   Returns false if PAGES is already full.  Terminates the process
+   if UPAGE is not a valid user page. */
+static bool
+pin_page (const void **pages, size_t *page_cnt, const void *upage,
+          bool will_write)
+{
+  size_t i;
+
+  for (i = 0; i < *page_cnt; i++)
+    if (pages[i] == upage)
+      return true;
+  if (*page_cnt >= PIN_MAX)
+    return false;
+
+  if (!is_user_vaddr (upage) || !page_lock (upage, will_write))
+    {
+      unpin_pages (pages, *page_cnt);
+      thread_exit ();
+    }
+  pages[(*page_cnt)++] = upage;
+  return true;
+}
+
+/* Transfers the IOV_CNT buffers in IOV between the console and
+   memory: writes them to the console if WRITE is true, and
+   otherwise fills them with keyboard input.  Returns the number
+   of bytes transferred. */
+static off_t
+console_transfer (const struct iovec *iov, size_t iov_cnt, bool write)
+{
+  off_t size = 0;
+  size_t i, j;
+
+  for (i = 0; i < iov_cnt; i++)
+    {
+      uint8_t *buf = iov[i].iov_base;
+
+      if (write)
+        putbuf ((const char *) buf, iov[i].iov_len);
+      else
+        for (j = 0; j < iov[i].iov_len; j++)
+          buf[j] = input_getc ();
+      size += iov[i].iov_len;
+    }
+  return size;
+}
+
+/* Common code for readv and writev, which write the data if
+   WRITE is true and read it otherwise.
+
+   Pins the user pages behind as much of the vector as PIN_MAX
+   pages allow, in one pass, then transfers all of it with a
+   single file system operation, and repeats until the vector is
+   done or a transfer comes up short, so that a vector of small
+   records costs one trap and usually one trip through the file
+   system. */
+static int
+transfer_vector (int handle, const struct iovec *uiov, int iov_cnt,
+                 bool write)
+{
+  struct iovec iov[IOV_MAX];
+  struct file *file = NULL;
+  size_t idx = 0, ofs = 0;
+  int size = 0;
+  int total = 0;
+  int i;
+
+  if (iov_cnt < 0 || iov_cnt > IOV_MAX)
+    return -1;
+  copy_in (iov, uiov, iov_cnt * sizeof *iov);
+  for (i = 0; i < iov_cnt; i++)
+    {
+      if (iov[i].iov_len > (size_t) (INT_MAX - size))
+        return -1;
+      size += iov[i].iov_len;
+    }
+  if (handle != (write ? STDOUT_FILENO : STDIN_FILENO))
+    file = lookup_fd (handle)->file;
+
+  while (idx < (size_t) iov_cnt)
+    {
+      struct iovec batch[IOV_MAX];
+      const void *pages[PIN_MAX];
+      size_t batch_cnt = 0, page_cnt = 0;
+      off_t batch_size = 0;
+      off_t retval;
+
+      /* Pin pages for as much of the rest of the vector as fits,
+         gathering what they cover into BATCH. */
+      while (idx < (size_t) iov_cnt)
+        {
+          uint8_t *p = (uint8_t *) iov[idx].iov_base + ofs;
+          size_t left = iov[idx].iov_len - ofs;
+          size_t chunk = PGSIZE - pg_ofs (p);
+          struct iovec *last = batch_cnt > 0 ? &batch[batch_cnt - 1] : NULL;
+
+          if (left == 0)
+            {
+              idx++;
+              ofs = 0;
+              continue;
+            }
+          if (!pin_page (pages, &page_cnt, pg_round_down (p), !write))
+            break;
+          if (chunk > left)
+            chunk = left;
+
+          if (last != NULL
+              && (uint8_t *) last->iov_base + last->iov_len == p)
+            last->iov_len += chunk;
+          else
+            {
+              batch[batch_cnt].iov_base = p;
+              batch[batch_cnt].iov_len = chunk;
+              batch_cnt++;
+            }
+          ofs += chunk;
+          batch_size += chunk;
+        }
+      if (batch_size == 0)
+        break;
+
+      /* Transfer the batch. */
+      if (file == NULL)
+        retval = console_transfer (batch, batch_cnt, write);
+      else if (write)
+        retval = file_writev (file, batch, batch_cnt);
+      else
+        retval = file_readv (file, batch, batch_cnt);
+      unpin_pages (pages, page_cnt);
+
+      total += retval;
+      if (retval != batch_size)
+        break;
+    }
+
+  return total;
+}
+
+/* Readv system call. */
+static int
+sys_readv (int handle, const struct iovec *uiov, int iov_cnt)
+{
+  return transfer_vector (handle, uiov, iov_cnt, false);
+}
+
+/* Writev system call. */
+static int
+sys_writev (int handle, const struct iovec *uiov, int iov_cnt)
+{
+  return transfer_vector (handle, uiov, iov_cnt, true);
+}
+
+/* Copy_file_range system call.  Copies within the file system,
+   from the input file's position to the output file's, so the
+   data never passes through user memory. */
+static int
+sys_copy_file_range (int in_handle, int out_handle, unsigned length)
+{
+  struct file_descriptor *in = lookup_fd (in_handle);
+  struct file_descriptor *out = lookup_fd (out_handle);
+
+  if ((off_t) length < 0)
+    return -1;
+  return file_copy (out->file, in->file, length);
+}
+
+/* Aio_setup system call.  Registers URING as the process's
+   asynchronous I/O ring and empties its queues. */
+static int
+sys_aio_setup (struct aio_ring *uring)
+{
+  struct thread *cur = thread_current ();
+  unsigned indexes[4] = {0, 0, 0, 0};
+
+  if (cur->aio != NULL)
+    return false;
+  check_user (uring, sizeof *uring, true);
+  copy_out (uring, indexes, sizeof indexes);
+  cur->aio = aio_create (uring);
+  return cur->aio != NULL;
+}
+
+/* Starts the request described by SQE in CTX.  A request that is
+   invalid or cannot be started still completes, with result -1.
+   Buffers are checked before anything is allocated, so that a
+   bad pointer cannot leak the request. */
+static void
+submit_sqe (struct aio_context *ctx, const struct aio_sqe *sqe)
+{
+  struct file_descriptor *fd = find_fd (sqe->fd);
+  bool valid = ((sqe->op == AIO_READ || sqe->op == AIO_WRITE)
+                && sqe->size <= AIO_MAX && (off_t) sqe->offset >= 0
+                && fd != NULL && fd->file != NULL);
+  struct aio_request *r;
+
+  if (valid)
+    check_user (sqe->buf, sqe->size, sqe->op == AIO_READ);
+  r = valid ? aio_request_create (sqe->size) : NULL;
+  if (r == NULL)
+    {
+      valid = false;
+      r = aio_request_create (0);
+      if (r == NULL)
+        thread_exit ();
+    }
+  r->op = sqe->op;
+  r->offset = sqe->offset;
+  r->buf = sqe->buf;
+  r->user_data = sqe->user_data;
+  if (valid)
+    {
+      if (sqe->op == AIO_WRITE)
+        copy_in (r->data, sqe->buf, sqe->size);
+      r->file = file_reopen (fd->file);
+    }
+  aio_submit (ctx, r);
+}
+
+/* Wait_for_completions system call.  Starts the requests the
+   process has added to its submission queue since the last call,
+   then posts finished requests to its completion queue until at
+   least MIN_COMPLETE completions are waiting there, blocking if
+   necessary, or until none of its requests is in progress.
+   Returns the number of completions waiting. */
+static int
+sys_wait_for_completions (int min_complete)
+{
+  struct aio_context *ctx = thread_current ()->aio;
+  struct aio_ring *ring;
+  unsigned sq_tail, cq_head;
+
+  if (ctx == NULL)
+    return -1;
+  ring = ctx->ring;
+  copy_in (&sq_tail, &ring->sq_tail, sizeof sq_tail);
+  copy_in (&cq_head, &ring->cq_head, sizeof cq_head);
+  if (ctx->cq_tail - cq_head > AIO_RING_SIZE)
+    cq_head = ctx->cq_tail - AIO_RING_SIZE;
+  if (min_complete > AIO_RING_SIZE)
+    min_complete = AIO_RING_SIZE;
+
+  /* Start new requests, but never more than the completion
+     queue can hold at once. */
+  while (ctx->sq_head != sq_tail && ctx->outstanding < AIO_RING_SIZE)
+    {
+      struct aio_sqe sqe;
+
+      copy_in (&sqe, &ring->sq[ctx->sq_head % AIO_RING_SIZE], sizeof sqe);
+      submit_sqe (ctx, &sqe);
+      ctx->sq_head++;
+    }
+  copy_out (&ring->sq_head, &ctx->sq_head, sizeof ctx->sq_head);
+
+  /* Post completions while there is room for them. */
+  while (ctx->cq_tail - cq_head < AIO_RING_SIZE)
+    {
+      bool wait = (int) (ctx->cq_tail - cq_head) < min_complete;
+      struct aio_request *r = aio_reap (ctx, wait);
+      struct aio_cqe cqe;
+
+      if (r == NULL)
+        break;
+      if (r->op == AIO_READ && r->result > 0)
+        {
+          /* R is no longer in CTX, so free it before dying if the
+             buffer went away after the request was submitted. */
+          if (!user_range_ok (r->buf, r->result, true))
+            {
+              aio_request_free (r);
+              thread_exit ();
+            }
+          copy_out (r->buf, r->data, r->result);
+        }
+      cqe.user_data = r->user_data;
+      cqe.result = r->result;
+      aio_request_free (r);
+      copy_out (&ring->cq[ctx->cq_tail % AIO_RING_SIZE], &cqe, sizeof cqe);
+      ctx->cq_tail++;
+    }
+  copy_out (&ring->cq_tail, &ctx->cq_tail, sizeof ctx->cq_tail);
+
+  return ctx->cq_tail - cq_head;
+}
+
+/* Fsync system call.  Returns once the file's data and metadata
+   are on disk. */
+static int
+sys_fsync (int handle)
+{
+  struct file_descriptor *fd = lookup_fd (handle);
+
+  file_sync (fd->file);
+  return true;
+}
+
+/* Sync system call. */
+static int
+sys_sync (void)
+{
+  filesys_sync ();
   return 0;
 }
 
+/* Readdir system call. */
+static int
+sys_readdir (int handle, char *uname)
+{
+  struct file_descriptor *fd = lookup_any_fd (handle);
+  char name[NAME_MAX + 1];
+
+  if (fd->dir == NULL || !dir_readdir (fd->dir, name))
+    return false;
+  copy_out (uname, name, strlen (name) + 1);
+  return true;
+}
+
+/* Isdir system call. */
+static int
+sys_isdir (int handle)
+{
+  return lookup_any_fd (handle)->dir != NULL;
+}
+
+/* Inumber system call. */
+static int
+sys_inumber (int handle)
+{
+  struct file_descriptor *fd = lookup_any_fd (handle);
+  struct inode *inode = (fd->dir != NULL
+                         ? dir_get_inode (fd->dir)
+                         : file_get_inode (fd->file));
+
+  return inode_get_inumber (inode);
+}
+
+/* Number of directory entries that getdents gathers in the
+   kernel before copying them out. */
+#define GETDENTS_BATCH 16
+
+/* Getdents system call.  Reads up to CNT entries of the
+   directory open as HANDLE, with the inode number, type, and
+   size of each file, into UENTRIES, so that listing a directory
+   takes one call per buffer instead of one per entry plus an
+   open per file.  Returns the number of entries read, which is 0
+   at the end of the directory, or -1 if HANDLE is not a
+   directory. */
+static int
+sys_getdents (int handle, struct dirent *uentries, unsigned cnt)
+{
+  struct file_descriptor *fd = lookup_any_fd (handle);
+  struct dirent batch[GETDENTS_BATCH];
+  unsigned total = 0;
+
+  if (fd->dir == NULL || cnt > INT_MAX / sizeof *uentries)
+    return -1;
+  while (total < cnt)
+    {
+      size_t max = cnt - total < GETDENTS_BATCH ? cnt - total : GETDENTS_BATCH;
+      size_t n = dir_getdents (fd->dir, batch, max);
+
+      if (n == 0)
+        break;
+      copy_out (uentries + total, batch, n * sizeof *batch);
+      total += n;
+    }
+  return total;
+}
 
 static bool  verify_user (const void *uaddr)
 {
@@ -519,22 +1040,15 @@ static struct mapping *lookup_mapping (int handle)
 void clear_mapping (struct mapping *m)
 {
   list_remove(&m->elem);
-  for(int i = 0; i < m->page_cnt; i++)
-  {
-
-    if (pagedir_is_dirty(thread_current()->pagedir, ((const void *) ((m->base) + (PGSIZE * i)))))
-    {
-
-      file_write_at(m->file, (const void *) (m->base + (PGSIZE * i)), (PGSIZE*(m->page_cnt)), (PGSIZE * i));
-
-    }
-  }
 
+  /* Unmapping a page writes it back if it is dirty. */
   for(int i = 0; i < m->page_cnt; i++)
   {
       void *addr = (m->base) + (PGSIZE * i);
     clear_page(addr);
   }
+  file_close (m->file);
+  slab_free (&mapping_cache, m);
 }
 
 
@@ -547,14 +1061,19 @@ void  syscall_exit (void)
   struct thread *cur = thread_current ();
   struct list_elem *e, *next;
 
+  if (cur->aio != NULL)
+    {
+      aio_destroy (cur->aio);
+      cur->aio = NULL;
+    }
+
   for (e = list_begin (&cur->fds); e != list_end (&cur->fds); e = next)
     {
       struct file_descriptor *fd = list_entry (e, struct file_descriptor, elem);
       next = list_next (e);
-      lock_acquire (&fs_lock);
       file_close (fd->file);
-      lock_release (&fs_lock);
-      free (fd);
+      dir_close (fd->dir);
+      slab_free (&fd_cache, fd);
     }
 
   for (e = list_begin (&cur->list_mmap_files); e != list_end (&cur->list_mmap_files);
@@ -574,19 +1093,23 @@ void  syscall_exit (void)
 static int sys_mapping (int handle, void *addr)
 {
     struct file_descriptor *fd = lookup_fd (handle);
-    struct mapping *m = malloc (sizeof *m);
+    struct mapping *m = slab_alloc (&mapping_cache);
 
 
     off_t read_bytes;
 
-    if (m == NULL || addr == NULL || pg_ofs (addr) != 0) return -1;
+    if (m == NULL || addr == NULL || pg_ofs (addr) != 0)
+      {
+        slab_free (&mapping_cache, m);
+        return -1;
+      }
 
     m->file = file_reopen (fd->file);
     m->map_handle = thread_current ()->next_handle++;
 
     if (m->file == NULL)
     {
-        free (m);
+        slab_free (&mapping_cache, m);
         return -1;
     }
 
@@ -644,6 +1167,7 @@ int add_file_to_mapping(struct file* file,
         return -1;
     }
     pte->location = false;
+    pte->shared = true;
     pte->file_ptr = file;
     pte->file_offset = ofs;
     pte->file_bytes = page_read_bytes;
@@ -1,10 +1,12 @@
 #include "vm/frame.h"
 #include <stdio.h>
 #include "vm/page.h"
+#include "vm/pagecache.h"
 #include "devices/timer.h"
 #include "threads/init.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "list.h"
@@ -12,6 +14,15 @@
 static struct list frame_list;
 static size_t frame_cnt;
 static struct lock FT_lock;
+static struct slab_cache frame_cache;
+
+/* Constructs a frame table entry in FRAME_CACHE. */
+static void
+frame_ctor (void *f_)
+{
+  struct frame *f = f_;
+  lock_init (&f->lock);
+}
 
 
 
@@ -20,15 +31,21 @@ void frame_init (void)
   void*user_page_kaddr;
     lock_init (&FT_lock);
     list_init (&frame_list);
+    slab_cache_init (&frame_cache, "frame", sizeof (struct frame), frame_ctor);
 
 
   while ((user_page_kaddr = palloc_get_page (PAL_USER)) != NULL)
 
     {
-        struct frame* f=(struct frame *) malloc (sizeof(struct frame));
-        lock_init (&f->lock);
+        struct frame* f = slab_alloc (&frame_cache);
+        if (f == NULL)
+          {
+            palloc_free_page (user_page_kaddr);
+            break;
+          }
         f->base = user_page_kaddr;
         f->pte = NULL;
+        f->cpage = NULL;
         list_push_front(&frame_list, &f->elem);
     }
 
@@ -49,7 +66,7 @@ struct frame* find_free_frame(void){
         bool acquired = lock_try_acquire (&fp->lock);
         if (acquired==false) continue;
         // if you locate an frame which do not contain page
-        if (fp->pte == NULL) {
+        if (fp->pte == NULL && fp->cpage == NULL) {
             lock_release (&FT_lock);
             return fp;
         }
@@ -71,13 +88,16 @@ struct frame* evict(struct spt_entry *input_p) {
         e = list_next(e);
 
         bool acquired = lock_try_acquire(&fp->lock);
-        if (acquired ==false || !is_LRU(fp->pte)) {
+        if (acquired ==false
+            || !(fp->cpage ? pagecache_claim(fp) : is_LRU(fp->pte))) {
             if(acquired == true)lock_release(&fp->lock);
             continue;
         }
 
         lock_release(&FT_lock);
-        bool success = evict_target_page(fp->pte);
+        bool success = true;
+        if (fp->cpage) pagecache_evict(fp);
+        else success = evict_target_page(fp->pte);
 
         if (!success) {
             lock_release(&fp->lock);
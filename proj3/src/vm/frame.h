@@ -9,6 +9,7 @@ struct frame {
     struct lock lock;               /* one access at a time */
     void *base;                     /* Kernel virtual base address. */
     struct spt_entry *pte;  /* Mapped process page, if any. */
+    struct cached_page *cpage;      /* Page cache page, if any. */
     struct list_elem elem;
 };
 
@@ -2,15 +2,26 @@
 #include <stdio.h>
 #include <string.h>
 #include "vm/frame.h"
+#include "vm/pagecache.h"
 #include "vm/swap.h"
 #include "filesys/file.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #include "userprog/pagedir.h"
 #include "threads/vaddr.h"
 
 ////jajajajajaj
 
+/* Supplementary page table entries. */
+static struct slab_cache spt_cache;
+
+/* Initializes the supplementary page table module. */
+void
+page_init (void)
+{
+  slab_cache_init (&spt_cache, "spt_entry", sizeof (struct spt_entry), NULL);
+}
+
 void page_destructor (struct hash_elem *page_hash, void *aux UNUSED);
 void free_process_PT (void);
 struct spt_entry *search_page (const void *address);
@@ -39,7 +50,7 @@ struct spt_entry *search_page (const void *address)
 
       target_pte.addr = addr;
 
-        struct hash_elem *e = hash_find (thread_current()->SPT, &target_pte.hash_elem);
+        struct hash_elem *e = ihash_find (thread_current()->SPT, &target_pte.hash_elem);
         if (e != NULL)  return hash_entry (e, struct spt_entry, hash_elem);
     }
 
@@ -64,6 +75,7 @@ bool is_LRU (struct spt_entry *pte)
 
 bool put_pte_into_frame (struct spt_entry *pte)
 {
+  if (pte->shared) return pagecache_map (pte);
 
   pte->occupied_frame = frame_Alloc (pte);
   if (pte->occupied_frame == NULL) return false;
@@ -133,9 +145,11 @@ bool evict_target_page (struct spt_entry *pte)
 struct spt_entry *pte_allocate (void *vaddr, bool read_only)
 {
   struct thread *curr_thread = thread_current ();
-  struct spt_entry *pte = malloc (sizeof *pte);
+  struct spt_entry *pte = slab_alloc (&spt_cache);
 
-  if (pte) {
+  if (pte == NULL)
+    return NULL;
+  else {
       pte->thread = curr_thread;
       pte->addr = pg_round_down (vaddr);
       pte->read_only = read_only;
@@ -145,6 +159,7 @@ struct spt_entry *pte_allocate (void *vaddr, bool read_only)
       pte->file_ptr = NULL;
       pte->file_offset = 0;
       pte->file_bytes = 0;
+      pte->shared = false;
   }
 
 
@@ -189,30 +204,36 @@ void page_destructor (struct hash_elem *page_hash, void *aux UNUSED)
 {
     struct spt_entry *pte = hash_entry (page_hash, struct spt_entry, hash_elem);
     lock_page_frame (pte);
-    if (pte->occupied_frame) frame_free (pte->occupied_frame);
-    free (pte);
+    if (pte->occupied_frame) {
+        if (pte->shared) pagecache_unmap (pte);
+        else frame_free (pte->occupied_frame);
+    }
+    slab_free (&spt_cache, pte);
 }
 
 
 void free_process_PT (void)
 {
     struct thread *t = thread_current ();
-    struct hash *curr_PT = t->SPT;
-    if (curr_PT) hash_destroy (curr_PT, page_destructor);
+    struct ihash *curr_PT = t->SPT;
+    if (curr_PT) ihash_destroy (curr_PT, page_destructor);
 }
 void clear_page (void *addr)
 {
     struct spt_entry *pte = search_page (addr);
     lock_page_frame (pte);
-    if (pte->occupied_frame) {
+    if (pte->occupied_frame && pte->shared) {
+        pagecache_unmap (pte);
+    }
+    else if (pte->occupied_frame) {
         struct frame *f = pte->occupied_frame;
         if (pte->file_ptr && !pte->location) {
             bool a = evict_target_page (pte);
         }
         frame_free (f);
     }
-    hash_delete (thread_current()->SPT, &pte->hash_elem);
-    free (pte);
+    ihash_delete (thread_current()->SPT, &pte->hash_elem);
+    slab_free (&spt_cache, pte);
 }
 
 unsigned page_hash (const struct hash_elem *e, void *aux UNUSED)
@@ -231,12 +252,12 @@ bool addr_less (const struct hash_elem *a_, const struct hash_elem *b_, void *au
 }
 
 struct spt_entry * insert_PTE_into_currPT(struct spt_entry *pte) {
-    struct hash_elem *a = hash_insert(pte->thread->SPT, &pte->hash_elem);
+    struct hash_elem *a = ihash_insert(pte->thread->SPT, &pte->hash_elem);
 
     if (a == NULL) {
         return pte;
     } else {
-        free(pte);
+        slab_free (&spt_cache, pte);
         return NULL;
 
     }
@@ -258,6 +279,8 @@ bool add_file_to_SPT(struct file* file,
         PT_entry->file_ptr = file;
         PT_entry->file_offset = ofs;
         PT_entry->file_bytes = page_read_bytes;
+        // whole read-only pages can be mapped from the page cache
+        PT_entry->shared = !writable && page_read_bytes == PGSIZE;
     }
 
     return true;
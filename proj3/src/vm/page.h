@@ -1,7 +1,7 @@
 #ifndef VM_PAGE_H
 #define VM_PAGE_H
 
-#include <hash.h>
+#include <ihash.h>
 #include "devices/block.h"
 #include "filesys/off_t.h"
 #include "threads/synch.h"
@@ -24,8 +24,11 @@ struct spt_entry {
     off_t file_offset;          /* Offset in file. */
     off_t file_bytes;           /* Bytes to read/write, 1...PGSIZE. */
     struct hash_elem hash_elem; /* struct thread `pages' hash element. */
+    bool shared;                /* Mapped from the page cache? */
+    struct list_elem cache_elem; /* Cached page's list of mappers. */
 };
 
+void page_init (void);
 void free_process_PT (void);
 struct spt_entry *pte_allocate (void *, bool read_only);
 void clear_page (void *vaddr);
@@ -0,0 +1,483 @@
+#include "vm/pagecache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <string.h>
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+
+/* Page cache for file data.
+
+   Each page of file data in memory is held once, in a frame
+   from the frame table, found by inode and page offset.  Reads
+   through the file layer copy out of it, reading the page in
+   first if necessary, and pages of memory-mapped files and
+   read-only executable pages are mapped straight into the
+   processes that use them, so that a page read by one process,
+   or mapped by several, is read from disk once and stored
+   once.  Writes update the file through the buffer cache as
+   before, and inode_writev() copies the new bytes into any
+   cached page of the range as well, so the cached pages always
+   match the file, except for changes made through a mapping,
+   which go to the file when the page is unmapped or evicted,
+   with inode_write_page(), which leaves the page alone.
+
+   Cached pages are evicted by the frame table's clock algorithm
+   like any other frame, when neither the page cache nor any
+   process mapping it has used it recently, and are freed when
+   their inode is last closed, found on a list that each inode
+   keeps of its pages.
+
+   A page's presence in page_map and on its inode's list, its pin
+   count, and its valid and accessed bits are protected by
+   pcache_lock, which is never held while acquiring another
+   lock.  Its data and its list of mappers are protected by its
+   frame's lock.  A pinned page is never evicted, so it may be
+   read or written without its frame's lock once it is valid;
+   the thread reading a page in holds the frame's lock until it
+   is valid.  Since frame locks are acquired before inode locks,
+   inode_writev() updates cached pages by pinning them, not by
+   locking them. */
+
+/* A page of file data. */
+struct cached_page
+  {
+    struct hash_elem hash_elem;         /* page_map element. */
+    struct list_elem list_elem;         /* Element in its inode's pages. */
+    struct inode *inode;                /* File. */
+    off_t ofs;                          /* Page-aligned offset in file. */
+    struct frame *frame;                /* Frame that holds the data. */
+    struct list mappers;                /* spt_entries that map it. */
+    int pin_cnt;                        /* Users that may not see it evicted. */
+    bool valid;                         /* Has the data been read in? */
+    bool accessed;                      /* Read since the last clock pass? */
+    bool cached;                        /* In page_map and inode's pages? */
+  };
+
+static struct lock pcache_lock;         /* Protects the following. */
+static struct hash page_map;            /* Cached pages by inode and offset. */
+static struct slab_cache page_cache;    /* Allocates cached_pages. */
+
+static hash_hash_func cached_page_hash;
+static hash_less_func cached_page_less;
+
+/* Initializes the page cache. */
+void
+pagecache_init (void)
+{
+  lock_init (&pcache_lock);
+  if (!hash_init (&page_map, cached_page_hash, cached_page_less, NULL))
+    PANIC ("page cache initialization failed");
+  slab_cache_init (&page_cache, "cached_page", sizeof (struct cached_page),
+                   NULL);
+}
+
+/* Returns the cached page of INODE at OFS, or a null pointer if
+   there is none.  Must be called with pcache_lock held. */
+static struct cached_page *
+lookup (struct inode *inode, off_t ofs)
+{
+  struct cached_page key;
+  struct hash_elem *e;
+
+  key.inode = inode;
+  key.ofs = ofs;
+  e = hash_find (&page_map, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct cached_page, hash_elem) : NULL;
+}
+
+/* Removes CP from the page cache, so that nobody else can find
+   it.  Must be called with pcache_lock held. */
+static void
+uncache (struct cached_page *cp)
+{
+  hash_delete (&page_map, &cp->hash_elem);
+  list_remove (&cp->list_elem);
+  cp->cached = false;
+}
+
+/* Returns the page of INODE at OFS, pinned and valid, reading it
+   in if it is not cached.  Returns a null pointer if no frame
+   is available for it. */
+static struct cached_page *
+get_page (struct inode *inode, off_t ofs)
+{
+  struct cached_page *cp;
+  struct frame *f;
+  off_t n;
+
+  for (;;)
+    {
+      lock_acquire (&pcache_lock);
+      cp = lookup (inode, ofs);
+      if (cp != NULL)
+        {
+          bool valid = cp->valid;
+
+          cp->pin_cnt++;
+          cp->accessed = true;
+          lock_release (&pcache_lock);
+          if (!valid)
+            {
+              /* Wait for the thread reading it in. */
+              lock_acquire (&cp->frame->lock);
+              lock_release (&cp->frame->lock);
+            }
+          return cp;
+        }
+      lock_release (&pcache_lock);
+
+      /* Set up a new page in a locked frame. */
+      cp = slab_alloc (&page_cache);
+      if (cp == NULL)
+        return NULL;
+      f = frame_Alloc (NULL);
+      if (f == NULL)
+        {
+          slab_free (&page_cache, cp);
+          return NULL;
+        }
+      cp->inode = inode;
+      cp->ofs = ofs;
+      cp->frame = f;
+      list_init (&cp->mappers);
+      cp->pin_cnt = 1;
+      cp->valid = false;
+      cp->accessed = true;
+      cp->cached = true;
+      f->cpage = cp;
+
+      lock_acquire (&pcache_lock);
+      if (lookup (inode, ofs) == NULL)
+        {
+          hash_insert (&page_map, &cp->hash_elem);
+          list_push_back (inode_pages (inode), &cp->list_elem);
+          lock_release (&pcache_lock);
+          break;
+        }
+      lock_release (&pcache_lock);
+
+      /* Someone else read it in meanwhile.  Use theirs. */
+      f->cpage = NULL;
+      frame_free (f);
+      slab_free (&page_cache, cp);
+    }
+
+  /* Read in the data.  Bytes past end of file are zeros. */
+  n = inode_read_at (inode, f->base, PGSIZE, ofs);
+  memset ((uint8_t *) f->base + n, 0, PGSIZE - n);
+
+  lock_acquire (&pcache_lock);
+  cp->valid = true;
+  lock_release (&pcache_lock);
+  lock_release (&f->lock);
+  return cp;
+}
+
+/* Unpins CP. */
+static void
+put_page (struct cached_page *cp)
+{
+  lock_acquire (&pcache_lock);
+  cp->pin_cnt--;
+  lock_release (&pcache_lock);
+}
+
+/* Writes CP's data, up to end of file, back to its inode.
+   CP's frame must be locked. */
+static void
+write_back (struct cached_page *cp)
+{
+  off_t size = inode_length (cp->inode) - cp->ofs;
+
+  if (size > PGSIZE)
+    size = PGSIZE;
+  if (size > 0)
+    inode_write_page (cp->inode, cp->frame->base, size, cp->ofs);
+}
+
+/* Reads SIZE bytes of INODE, starting at OFFSET, into BUFFER
+   through the page cache.  Returns the number of bytes read. */
+static off_t
+read_at (struct inode *inode, uint8_t *buffer, off_t size, off_t offset)
+{
+  off_t length = inode_length (inode);
+  off_t bytes_read = 0;
+
+  if (offset >= length)
+    return 0;
+  if (size > length - offset)
+    size = length - offset;
+
+  while (bytes_read < size)
+    {
+      off_t pos = offset + bytes_read;
+      int page_ofs = pos % PGSIZE;
+      off_t chunk = PGSIZE - page_ofs;
+      struct cached_page *cp;
+
+      if (chunk > size - bytes_read)
+        chunk = size - bytes_read;
+      cp = get_page (inode, pos - page_ofs);
+      if (cp == NULL)
+        {
+          /* Out of frames.  Read the rest from the file. */
+          return bytes_read + inode_read_at (inode, buffer + bytes_read,
+                                             size - bytes_read, pos);
+        }
+      memcpy (buffer + bytes_read, (uint8_t *) cp->frame->base + page_ofs,
+              chunk);
+      put_page (cp);
+      bytes_read += chunk;
+    }
+  return bytes_read;
+}
+
+/* Reads from INODE, starting at position OFFSET, into the
+   IOV_CNT buffers in IOV in turn, through the page cache, as
+   inode_readv() would.  Returns the number of bytes read. */
+off_t
+pagecache_readv (struct inode *inode, const struct iovec *iov,
+                 size_t iov_cnt, off_t offset)
+{
+  off_t bytes_read = 0;
+  size_t i;
+
+  for (i = 0; i < iov_cnt; i++)
+    {
+      off_t n = read_at (inode, iov[i].iov_base, iov[i].iov_len,
+                         offset + bytes_read);
+      bytes_read += n;
+      if (n < (off_t) iov[i].iov_len)
+        break;
+    }
+  return bytes_read;
+}
+
+/* If the page of INODE at page-aligned OFFSET is cached,
+   pins it and returns its data, which may be written without
+   further locking but must be released with pagecache_unpin().
+   Otherwise returns a null pointer.  For inode_writev() and
+   other writers to INODE, which must hold its lock, so that a
+   page being read in reads the new data or has it copied in
+   afterward. */
+void *
+pagecache_pin (struct inode *inode, off_t offset)
+{
+  struct cached_page *cp;
+
+  ASSERT (offset % PGSIZE == 0);
+
+  lock_acquire (&pcache_lock);
+  cp = lookup (inode, offset);
+  if (cp != NULL)
+    cp->pin_cnt++;
+  lock_release (&pcache_lock);
+  return cp != NULL ? cp->frame->base : NULL;
+}
+
+/* Like pagecache_pin(), but only if the page has been read in,
+   for readers of INODE that bypass the page cache, so that they
+   see changes made to the page through a mapping that have not
+   reached the file yet. */
+void *
+pagecache_pin_valid (struct inode *inode, off_t offset)
+{
+  struct cached_page *cp;
+
+  ASSERT (offset % PGSIZE == 0);
+
+  lock_acquire (&pcache_lock);
+  cp = lookup (inode, offset);
+  if (cp != NULL && cp->valid)
+    cp->pin_cnt++;
+  else
+    cp = NULL;
+  lock_release (&pcache_lock);
+  return cp != NULL ? cp->frame->base : NULL;
+}
+
+/* Releases a page pinned with pagecache_pin() or
+   pagecache_pin_valid(). */
+void
+pagecache_unpin (struct inode *inode, off_t offset)
+{
+  struct cached_page *cp;
+
+  lock_acquire (&pcache_lock);
+  cp = lookup (inode, offset);
+  ASSERT (cp != NULL && cp->pin_cnt > 0);
+  cp->pin_cnt--;
+  lock_release (&pcache_lock);
+}
+
+/* Frees all of INODE's cached pages.  Called when INODE is
+   closed for the last time, so none of them is mapped. */
+void
+pagecache_drop (struct inode *inode)
+{
+  struct list *pages = inode_pages (inode);
+
+  for (;;)
+    {
+      struct cached_page *cp = NULL;
+      struct frame *f;
+
+      lock_acquire (&pcache_lock);
+      if (!list_empty (pages))
+        {
+          cp = list_entry (list_front (pages), struct cached_page, list_elem);
+          uncache (cp);
+        }
+      lock_release (&pcache_lock);
+      if (cp == NULL)
+        break;
+
+      /* Wait out any attempt to evict it. */
+      f = cp->frame;
+      lock_acquire (&f->lock);
+      ASSERT (cp->pin_cnt == 0 && list_empty (&cp->mappers));
+      f->cpage = NULL;
+      frame_free (f);
+      slab_free (&page_cache, cp);
+    }
+}
+
+/* Brings in the cached page for PTE, a page shared through the
+   page cache, and makes it PTE's frame, locked.  The caller
+   must map it.  Returns false if no frame is available. */
+bool
+pagecache_map (struct spt_entry *pte)
+{
+  struct cached_page *cp = get_page (file_get_inode (pte->file_ptr),
+                                     pte->file_offset);
+
+  if (cp == NULL)
+    return false;
+  lock_acquire (&cp->frame->lock);
+  list_push_back (&cp->mappers, &pte->cache_elem);
+  pte->occupied_frame = cp->frame;
+  put_page (cp);
+  return true;
+}
+
+/* Unmaps PTE's cached page from PTE, writing the page back to
+   its file if PTE dirtied it, and releases its frame, which
+   must be locked. */
+void
+pagecache_unmap (struct spt_entry *pte)
+{
+  struct frame *f = pte->occupied_frame;
+  uint32_t *pd = pte->thread->pagedir;
+  bool dirty = pagedir_is_dirty (pd, pte->addr);
+
+  pagedir_clear_page (pd, pte->addr);
+  list_remove (&pte->cache_elem);
+  pte->occupied_frame = NULL;
+  if (dirty)
+    write_back (f->cpage);
+  lock_release (&f->lock);
+}
+
+/* Decides whether to evict the cached page in F, whose lock
+   must be held, for the frame table's clock algorithm.  If
+   anybody has used it since the last pass, clears its accessed
+   bits and returns false.  Otherwise, unless it is pinned,
+   removes it from the page cache, so that pagecache_evict() may
+   free it, and returns true. */
+bool
+pagecache_claim (struct frame *f)
+{
+  struct cached_page *cp = f->cpage;
+  bool accessed;
+  struct list_elem *e;
+
+  lock_acquire (&pcache_lock);
+  accessed = cp->accessed;
+  cp->accessed = false;
+  for (e = list_begin (&cp->mappers); e != list_end (&cp->mappers);
+       e = list_next (e))
+    {
+      struct spt_entry *pte = list_entry (e, struct spt_entry, cache_elem);
+      uint32_t *pd = pte->thread->pagedir;
+
+      if (pagedir_is_accessed (pd, pte->addr))
+        {
+          pagedir_set_accessed (pd, pte->addr, false);
+          accessed = true;
+        }
+    }
+  if (accessed || cp->pin_cnt > 0 || !cp->cached)
+    {
+      lock_release (&pcache_lock);
+      return false;
+    }
+  uncache (cp);
+  lock_release (&pcache_lock);
+  return true;
+}
+
+/* Evicts the cached page in F, claimed with pagecache_claim(),
+   unmapping it from every process that maps it and writing it
+   back to its file if any of them dirtied it.  Leaves F locked
+   and empty. */
+void
+pagecache_evict (struct frame *f)
+{
+  struct cached_page *cp = f->cpage;
+  bool dirty = false;
+  struct list_elem *e;
+
+  /* Unmap it, so that nobody can dirty it further, but leave it
+     the mappers' frame until it is written back, so that a
+     process unmapping it waits and keeps the file open. */
+  for (e = list_begin (&cp->mappers); e != list_end (&cp->mappers);
+       e = list_next (e))
+    {
+      struct spt_entry *pte = list_entry (e, struct spt_entry, cache_elem);
+      uint32_t *pd = pte->thread->pagedir;
+
+      if (pagedir_is_dirty (pd, pte->addr))
+        dirty = true;
+      pagedir_clear_page (pd, pte->addr);
+    }
+  if (dirty)
+    write_back (cp);
+  for (e = list_begin (&cp->mappers); e != list_end (&cp->mappers);
+       e = list_next (e))
+    list_entry (e, struct spt_entry, cache_elem)->occupied_frame = NULL;
+
+  f->cpage = NULL;
+  slab_free (&page_cache, cp);
+}
+
+/* Returns a hash value for cached page E. */
+static unsigned
+cached_page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct cached_page *cp = hash_entry (e, struct cached_page,
+                                             hash_elem);
+  return hash_int ((int) cp->inode) ^ hash_int (cp->ofs);
+}
+
+/* Returns true if cached page A precedes cached page B. */
+static bool
+cached_page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+                  void *aux UNUSED)
+{
+  const struct cached_page *a = hash_entry (a_, struct cached_page,
+                                            hash_elem);
+  const struct cached_page *b = hash_entry (b_, struct cached_page,
+                                            hash_elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  return a->ofs < b->ofs;
+}
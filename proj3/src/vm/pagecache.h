@@ -0,0 +1,28 @@
+#ifndef VM_PAGECACHE_H
+#define VM_PAGECACHE_H
+
+#include <iovec.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+
+struct inode;
+struct frame;
+struct spt_entry;
+
+void pagecache_init (void);
+
+off_t pagecache_readv (struct inode *, const struct iovec *, size_t iov_cnt,
+                       off_t offset);
+void *pagecache_pin (struct inode *, off_t offset);
+void *pagecache_pin_valid (struct inode *, off_t offset);
+void pagecache_unpin (struct inode *, off_t offset);
+void pagecache_drop (struct inode *);
+
+bool pagecache_map (struct spt_entry *);
+void pagecache_unmap (struct spt_entry *);
+
+bool pagecache_claim (struct frame *);
+void pagecache_evict (struct frame *);
+
+#endif /* vm/pagecache.h */
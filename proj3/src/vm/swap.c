@@ -9,6 +9,9 @@
 
 #define SECTOR_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
 
+/* Swap slot where the next search for a free slot starts. */
+static size_t next_fit;
+
 void swap_init (void)
 {
   swapping_block = block_get_role (BLOCK_SWAP);
@@ -22,6 +25,7 @@ void swap_init (void)
       PANIC ("couldn't create swap bitmap");
 
    bitmap_set_all(swap_map, 0);
+   bitmap_enable_summary (swap_map);
   lock_init (&swap_lock);
 }
 
@@ -42,8 +46,8 @@ void swap_in (struct spt_entry *pte)
                 pte->occupied_frame->base + i * BLOCK_SECTOR_SIZE);
 
   }
-    lock_release(&swap_lock);
   bitmap_reset (swap_map, pte->sector / SECTOR_PER_PAGE);
+    lock_release(&swap_lock);
   pte->sector = -1;
 
 }
@@ -58,11 +62,13 @@ bool swap_out (struct spt_entry *pte)
     }
 
     lock_acquire (&swap_lock);
-    size_t free_index = bitmap_scan_and_flip (swap_map, 0, 1, false);
+    size_t free_index = bitmap_scan_and_flip_next_fit (swap_map, next_fit,
+                                                       1, false);
 
     if (free_index == BITMAP_ERROR){
         PANIC("Swap partition is full!");
     }
+    next_fit = free_index + 1;
 
      pte->sector = free_index * SECTOR_PER_PAGE;
       pte->location = false;